@@ -0,0 +1,190 @@
+#ifndef _Geometry_AccumulationBuffer_H
+#define _Geometry_AccumulationBuffer_H
+
+#include <Geometry/RGBColor.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace Geometry
+{
+	/// <summary>
+	/// Accumulates the radiance samples computed for each pixel of an image. The sum of the samples and
+	/// the number of samples are kept per pixel so that passes can be rendered progressively, merged from
+	/// several sources and averaged at any time. The sum of the squared grey values of the samples is also
+	/// kept to estimate the variance of each pixel.
+	/// </summary>
+	class AccumulationBuffer
+	{
+	protected:
+		/// <summary> The width of the image. </summary>
+		int m_width;
+		/// <summary> The height of the image. </summary>
+		int m_height;
+		/// <summary> The sum of the samples (row major). </summary>
+		::std::vector<RGBColor> m_sum;
+		/// <summary> The number of samples (row major). </summary>
+		::std::vector<int> m_count;
+		/// <summary> The sum of the squared grey values of the samples (row major). </summary>
+		::std::vector<double> m_sumSquares;
+
+	public:
+		/// <summary>
+		/// Initializes an empty buffer.
+		/// </summary>
+		/// <param name="width">The width of the image.</param>
+		/// <param name="height">The height of the image.</param>
+		AccumulationBuffer(int width = 0, int height = 0)
+			: m_width(width), m_height(height), m_sum(width*height), m_count(width*height, 0), m_sumSquares(width*height, 0.0)
+		{}
+
+		int width() const
+		{ return m_width; }
+
+		int height() const
+		{ return m_height; }
+
+		/// <summary>
+		/// Adds a sample to a pixel.
+		/// </summary>
+		void add(int x, int y, RGBColor const & color)
+		{
+			int index = y*m_width + x;
+			m_sum[index] = m_sum[index] + color;
+			m_count[index]++;
+			m_sumSquares[index] += color.grey()*color.grey();
+		}
+
+		/// <summary>
+		/// Adds a sum of samples to a pixel.
+		/// </summary>
+		/// <param name="sum">The sum of the samples.</param>
+		/// <param name="count">The number of samples.</param>
+		/// <param name="sumSquares">The sum of the squared grey values of the samples (0 if unknown).</param>
+		void add(int x, int y, RGBColor const & sum, int count, double sumSquares = 0.0)
+		{
+			int index = y*m_width + x;
+			m_sum[index] = m_sum[index] + sum;
+			m_count[index] += count;
+			m_sumSquares[index] += sumSquares;
+		}
+
+		/// <summary>
+		/// Returns the sum of the samples of a pixel.
+		/// </summary>
+		const RGBColor & sum(int x, int y) const
+		{ return m_sum[y*m_width + x]; }
+
+		/// <summary>
+		/// Returns the number of samples of a pixel.
+		/// </summary>
+		int count(int x, int y) const
+		{ return m_count[y*m_width + x]; }
+
+		/// <summary>
+		/// Returns the sum of the squared grey values of the samples of a pixel.
+		/// </summary>
+		double sumSquares(int x, int y) const
+		{ return m_sumSquares[y*m_width + x]; }
+
+		/// <summary>
+		/// Returns the mean of the samples of a pixel (black if no sample has been accumulated).
+		/// </summary>
+		RGBColor mean(int x, int y) const
+		{
+			int index = y*m_width + x;
+			if (m_count[index] == 0) { return RGBColor(); }
+			return m_sum[index] / (double)m_count[index];
+		}
+
+		/// <summary>
+		/// Returns the estimated variance of the grey value of the samples of a pixel (0 with less than two samples).
+		/// </summary>
+		double variance(int x, int y) const
+		{
+			int index = y*m_width + x;
+			int count = m_count[index];
+			if (count < 2) { return 0.0; }
+			double mean = m_sum[index].grey() / count;
+			return ::std::max(0.0, (m_sumSquares[index] / count - mean*mean) * count / (count - 1));
+		}
+
+		/// <summary>
+		/// Estimates the noise of the image: the root mean square of the standard errors of the pixel means,
+		/// relative to the mean grey value of the image. The per pixel variance ignores the stratification of
+		/// quasi Monte Carlo samples, so the estimate is conservative.
+		/// </summary>
+		/// <returns>The relative noise, 0 if the image is black, a negative value if a pixel has less than two samples.</returns>
+		double noise() const
+		{
+			double squaredErrors = 0.0;
+			double grey = 0.0;
+			for (int y = 0; y < m_height; ++y)
+			{
+				for (int x = 0; x < m_width; ++x)
+				{
+					int count = m_count[y*m_width + x];
+					if (count < 2) { return -1.0; }
+					squaredErrors += variance(x, y) / count;
+					grey += m_sum[y*m_width + x].grey() / count;
+				}
+			}
+			if (grey <= 0.0) { return 0.0; }
+			const double pixels = (double)m_count.size();
+			return sqrt(squaredErrors / pixels) / (grey / pixels);
+		}
+
+		/// <summary>
+		/// Returns the size of the pixel data in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_sum.size()*sizeof(RGBColor) + m_count.size()*sizeof(int) + m_sumSquares.size()*sizeof(double);
+		}
+
+		/// <summary>
+		/// Resets all the pixels.
+		/// </summary>
+		void clear()
+		{
+			::std::fill(m_sum.begin(), m_sum.end(), RGBColor());
+			::std::fill(m_count.begin(), m_count.end(), 0);
+			::std::fill(m_sumSquares.begin(), m_sumSquares.end(), 0.0);
+		}
+
+		/// <summary>
+		/// Saves the mean of each pixel as a Portable Float Map (binary RGB float image).
+		/// </summary>
+		/// <param name="filename">The name of the file.</param>
+		/// <returns>true if the file has been written.</returns>
+		bool savePFM(const ::std::string & filename) const
+		{
+			::std::ofstream out(filename.c_str(), ::std::ios::binary);
+			if (!out)
+			{
+				::std::cerr << "AccumulationBuffer: unable to write " << filename << ::std::endl;
+				return false;
+			}
+			// Negative scale means little endian, rows are stored from bottom to top
+			out << "PF\n" << m_width << " " << m_height << "\n-1.0\n";
+			::std::vector<float> row(m_width * 3);
+			for (int y = m_height - 1; y >= 0; --y)
+			{
+				for (int x = 0; x < m_width; ++x)
+				{
+					RGBColor color = mean(x, y);
+					row[x * 3] = (float)color[0];
+					row[x * 3 + 1] = (float)color[1];
+					row[x * 3 + 2] = (float)color[2];
+				}
+				out.write((const char*)row.data(), row.size()*sizeof(float));
+			}
+			return (bool)out;
+		}
+	};
+}
+
+#endif
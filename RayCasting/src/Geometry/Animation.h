@@ -0,0 +1,354 @@
+#ifndef _Geometry_Animation_H
+#define _Geometry_Animation_H
+
+#include <Geometry/Scene.h>
+#include <Geometry/Camera.h>
+#include <Geometry/MeshTransform.h>
+#include <Math/Vectorf.h>
+#include <Math/Constant.h>
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <cstdlib>
+
+namespace Geometry
+{
+	/// <summary>
+	/// A sequence of values keyed by time.
+	/// </summary>
+	template <class Value>
+	class KeyframeTrack
+	{
+	protected:
+		/// <summary> The keys sorted by time. </summary>
+		::std::vector<::std::pair<double, Value> > m_keys;
+
+		/// <summary>
+		/// Finds the segment [key index; key index+1] containing a time and the position u in [0;1] in this segment.
+		/// Times outside the track are clamped.
+		/// </summary>
+		void locate(double time, size_t & index, double & u) const
+		{
+			if (time <= m_keys.front().first || m_keys.size() == 1) { index = 0; u = 0.0; return; }
+			if (time >= m_keys.back().first) { index = m_keys.size() - 2; u = 1.0; return; }
+			index = 0;
+			while (m_keys[index + 1].first < time) { ++index; }
+			double duration = m_keys[index + 1].first - m_keys[index].first;
+			u = (duration > 0.0) ? (time - m_keys[index].first) / duration : 0.0;
+		}
+
+		/// <summary>
+		/// Returns the value of a key, the index is clamped to the track.
+		/// </summary>
+		const Value & key(long index) const
+		{
+			index = ::std::max(0L, ::std::min(index, (long)m_keys.size() - 1));
+			return m_keys[index].second;
+		}
+
+	public:
+		/// <summary>
+		/// Adds a key (keys can be added in any order).
+		/// </summary>
+		void add(double time, Value const & value)
+		{
+			auto position = ::std::upper_bound(m_keys.begin(), m_keys.end(), time, [](double t, const ::std::pair<double, Value> & k) { return t < k.first; });
+			m_keys.insert(position, ::std::make_pair(time, value));
+		}
+
+		bool empty() const
+		{ return m_keys.empty(); }
+
+		double startTime() const
+		{ return m_keys.front().first; }
+
+		double endTime() const
+		{ return m_keys.back().first; }
+	};
+
+	/// <summary>
+	/// A keyframed camera path. Positions and targets are interpolated with Catmull-Rom splines, so the camera
+	/// passes through every key with a continuous velocity.
+	/// </summary>
+	class CameraPath : public KeyframeTrack<::std::pair<Math::Vector3f, Math::Vector3f> >
+	{
+	protected:
+		static Math::Vector3f catmullRom(Math::Vector3f const & p0, Math::Vector3f const & p1, Math::Vector3f const & p2, Math::Vector3f const & p3, double u)
+		{
+			double u2 = u*u;
+			double u3 = u2*u;
+			return (p1*2.0 + (p2 - p0)*u + (p0*2.0 - p1*5.0 + p2*4.0 - p3)*u2 + (p1*3.0 - p0 - p2*3.0 + p3)*u3)*0.5;
+		}
+
+	public:
+		/// <summary>
+		/// Adds a key.
+		/// </summary>
+		/// <param name="time">The time of the key.</param>
+		/// <param name="position">The position of the camera.</param>
+		/// <param name="target">The point looked at.</param>
+		void add(double time, Math::Vector3f const & position, Math::Vector3f const & target)
+		{
+			KeyframeTrack<::std::pair<Math::Vector3f, Math::Vector3f> >::add(time, ::std::make_pair(position, target));
+		}
+
+		/// <summary>
+		/// Places a camera at a given time (the other camera parameters are kept).
+		/// </summary>
+		Camera evaluate(Camera camera, double time) const
+		{
+			if (empty()) { return camera; }
+			size_t index;
+			double u;
+			locate(time, index, u);
+			long i = (long)index;
+			camera.setPosition(catmullRom(key(i - 1).first, key(i).first, key(i + 1).first, key(i + 2).first, u));
+			camera.setTarget(catmullRom(key(i - 1).second, key(i).second, key(i + 1).second, key(i + 2).second, u));
+			return camera;
+		}
+	};
+
+	/// <summary>
+	/// The keyframed transform of a mesh (interpolated with MeshTransform::interpolate).
+	/// </summary>
+	class MeshTrack : public KeyframeTrack<MeshTransform>
+	{
+	public:
+		MeshTransform evaluate(double time) const
+		{
+			if (empty()) { return MeshTransform(); }
+			size_t index;
+			double u;
+			locate(time, index, u);
+			return MeshTransform::interpolate(key((long)index), key((long)index + 1), u);
+		}
+	};
+
+	/// <summary>
+	/// An animation: a camera path and optional mesh tracks (meshes are designated by their index in the scene,
+	/// see Scene::geometryCount). The frames are rendered with the same scene, so loaded meshes, materials and
+	/// textures stay in memory and the BVH is only rebuilt for frames where a mesh moves.
+	/// </summary>
+	class Animation
+	{
+	protected:
+		CameraPath m_camera;
+		::std::map<size_t, MeshTrack> m_meshes;
+
+	public:
+		CameraPath & camera()
+		{ return m_camera; }
+
+		/// <summary>
+		/// Returns the track of a mesh (created if needed).
+		/// </summary>
+		MeshTrack & mesh(size_t index)
+		{ return m_meshes[index]; }
+
+		/// <summary>
+		/// Returns the time of the first key.
+		/// </summary>
+		double startTime() const
+		{
+			double result = m_camera.empty() ? 0.0 : m_camera.startTime();
+			for (auto it = m_meshes.begin(); it != m_meshes.end(); ++it)
+			{
+				if (!it->second.empty()) { result = ::std::min(result, it->second.startTime()); }
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the time of the last key.
+		/// </summary>
+		double endTime() const
+		{
+			double result = m_camera.empty() ? 0.0 : m_camera.endTime();
+			for (auto it = m_meshes.begin(); it != m_meshes.end(); ++it)
+			{
+				if (!it->second.empty()) { result = ::std::max(result, it->second.endTime()); }
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Loads the keys from a text file. Each line is either empty, a comment (#), a camera key or a mesh key:
+		///   camera time px py pz tx ty tz
+		///   mesh index time tx ty tz axisx axisy axisz angle(degrees) scale
+		/// </summary>
+		/// <returns>false if the file cannot be read or contains an invalid line.</returns>
+		bool load(const ::std::string & filename)
+		{
+			::std::ifstream in(filename.c_str());
+			if (!in)
+			{
+				::std::cerr << "Animation: unable to read " << filename << ::std::endl;
+				return false;
+			}
+			::std::string line;
+			int lineNumber = 0;
+			while (::std::getline(in, line))
+			{
+				++lineNumber;
+				::std::istringstream stream(line);
+				::std::string type;
+				if (!(stream >> type) || type[0] == '#') { continue; }
+				bool valid = false;
+				if (type == "camera")
+				{
+					double time, p[3], t[3];
+					valid = (bool)(stream >> time >> p[0] >> p[1] >> p[2] >> t[0] >> t[1] >> t[2]);
+					if (valid) { m_camera.add(time, Math::makeVector(p[0], p[1], p[2]), Math::makeVector(t[0], t[1], t[2])); }
+				}
+				else if (type == "mesh")
+				{
+					size_t index;
+					double time, t[3], axis[3], angle, scale;
+					valid = (bool)(stream >> index >> time >> t[0] >> t[1] >> t[2] >> axis[0] >> axis[1] >> axis[2] >> angle >> scale);
+					if (valid)
+					{
+						Math::Vector3f rotationAxis = Math::makeVector(axis[0], axis[1], axis[2]);
+						valid = rotationAxis.norm() > 0.0;
+						if (valid)
+						{
+							Math::Quaternion<double> rotation(rotationAxis.normalized(), angle*Math::pi / 180.0);
+							m_meshes[index].add(time, MeshTransform(Math::makeVector(t[0], t[1], t[2]), rotation, scale));
+						}
+					}
+				}
+				if (!valid)
+				{
+					::std::cerr << "Animation: invalid line " << lineNumber << " in " << filename << ::std::endl;
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Places the camera and the meshes of a scene at a given time.
+		/// </summary>
+		void apply(Scene & scene, double time) const
+		{
+			if (!m_camera.empty())
+			{
+				scene.setCamera(m_camera.evaluate(scene.getCamera(), time));
+			}
+			for (auto it = m_meshes.begin(); it != m_meshes.end(); ++it)
+			{
+				if (!it->second.empty())
+				{
+					scene.setGeometryTransform(it->first, it->second.evaluate(time));
+				}
+			}
+		}
+
+		/// <summary>
+		/// Splits a frame file pattern around its frame number: the pattern must contain exactly one %d or %0Nd
+		/// conversion, %% stands for a % character and no other conversion is allowed.
+		/// </summary>
+		/// <param name="pattern">The pattern (e.g. frame_%04d.pfm).</param>
+		/// <param name="prefix">The text before the frame number.</param>
+		/// <param name="width">The minimal number of digits of the frame number (padded with zeros).</param>
+		/// <param name="suffix">The text after the frame number.</param>
+		/// <returns>false if the pattern is invalid.</returns>
+		static bool splitPattern(const ::std::string & pattern, ::std::string & prefix, int & width, ::std::string & suffix)
+		{
+			::std::string text;
+			bool found = false;
+			for (size_t cpt = 0; cpt < pattern.size(); ++cpt)
+			{
+				if (pattern[cpt] != '%') { text += pattern[cpt]; continue; }
+				if (cpt + 1 < pattern.size() && pattern[cpt + 1] == '%') { text += '%'; ++cpt; continue; }
+				// %d or %0Nd
+				size_t end = cpt + 1;
+				size_t digits = end;
+				if (end < pattern.size() && pattern[end] == '0')
+				{
+					digits = ++end;
+					while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9') { ++end; }
+					if (end == digits || end - digits > 2) { return false; }
+				}
+				if (found || end >= pattern.size() || pattern[end] != 'd') { return false; }
+				width = (end > digits) ? ::std::atoi(pattern.substr(digits, end - digits).c_str()) : 0;
+				prefix = text;
+				text.clear();
+				found = true;
+				cpt = end;
+			}
+			suffix = text;
+			return found;
+		}
+
+		/// <summary>
+		/// Returns true if a pattern can name the files of the frames (see Animation::frameFilename).
+		/// </summary>
+		static bool validPattern(const ::std::string & pattern)
+		{
+			::std::string prefix, suffix;
+			int width;
+			return pattern.find('%') == ::std::string::npos || splitPattern(pattern, prefix, width, suffix);
+		}
+
+		/// <summary>
+		/// Builds the name of the file of a frame: the frame number replaces the %d or %0Nd conversion of the pattern
+		/// (e.g. frame_%04d.pfm, see Animation::splitPattern). The frame number of a pattern without a valid conversion is
+		/// inserted as _NNNN before its extension.
+		/// </summary>
+		static ::std::string frameFilename(const ::std::string & pattern, int frame)
+		{
+			::std::string prefix, suffix;
+			int width;
+			if (!splitPattern(pattern, prefix, width, suffix))
+			{
+				size_t dot = pattern.rfind('.');
+				if (dot == ::std::string::npos || pattern.find_first_of("/\\", dot) != ::std::string::npos) { dot = pattern.size(); }
+				prefix = pattern.substr(0, dot) + "_";
+				width = 4;
+				suffix = pattern.substr(dot);
+			}
+			::std::ostringstream name;
+			name << prefix << ::std::setw(width) << ::std::setfill('0') << frame << suffix;
+			return name.str();
+		}
+
+		/// <summary>
+		/// Renders a sequence of frames evenly spaced between the first and the last key. Each frame has its own
+		/// checkpoint file, named after the checkpoint file of the scene like the output files.
+		/// </summary>
+		/// <param name="scene">The scene (initialized once).</param>
+		/// <param name="frames">The number of frames.</param>
+		/// <param name="maxDepth">The maximum recursive depth.</param>
+		/// <param name="subPixelDivision">The sub pixel subdivisions.</param>
+		/// <param name="passPerPixel">The number of passes per pixel.</param>
+		/// <param name="pattern">The output files (see Animation::frameFilename), no file is written if empty.</param>
+		void render(Scene & scene, int frames, int maxDepth, int subPixelDivision, int passPerPixel, const ::std::string & pattern) const
+		{
+			const double start = startTime();
+			const double end = endTime();
+			const ::std::string checkpoint = scene.getCheckpointFile();
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				double time = (frames > 1) ? start + (end - start)*frame / (frames - 1) : start;
+				::std::cout << "Frame: " << frame << "/" << frames << " (time " << time << ")" << ::std::endl;
+				apply(scene, time);
+				if (!checkpoint.empty()) { scene.setCheckpointFile(frameFilename(checkpoint, frame)); }
+				scene.compute(maxDepth, subPixelDivision, passPerPixel);
+				if (!pattern.empty())
+				{
+					const ::std::string filename = frameFilename(pattern, frame);
+					scene.getImage().savePFM(filename);
+					if (scene.auxiliaryBuffers()) { scene.saveAuxiliaryBuffers(filename); }
+				}
+			}
+			scene.setCheckpointFile(checkpoint);
+		}
+	};
+}
+
+#endif
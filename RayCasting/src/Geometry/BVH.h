@@ -3,7 +3,18 @@
 
 #include <Geometry/Geometry.h>
 #include <Geometry/Scene.h>
+#include <Spy/Spy.h>
 #include <iostream>
+#include <vector>
+
+// Define the macro Use_TraversalLog to record the tests of the traversals in BVH::threadLog (MicroBenchmark target),
+// the renderer does not pay for the capture otherwise.
+#ifdef Use_TraversalLog
+#define TraversalLogged(...) { TraversalLog * log = threadLog(); if (log != nullptr) { __VA_ARGS__; } }
+#else
+#define TraversalLogged(...)
+#endif
+
 namespace Geometry {
 
 	class BVH : public Geometry
@@ -51,6 +62,53 @@ namespace Geometry {
 	BVHNode *m_root;
 
 	public:
+		/// <summary>
+		/// The cost of the traversals of the BVH.
+		/// </summary>
+		struct TraversalCost
+		{
+			unsigned long long nodes;
+			unsigned long long boxTests;
+			unsigned long long triangleTests;
+
+			TraversalCost()
+				: nodes(0), boxTests(0), triangleTests(0)
+			{}
+		};
+
+		/// <summary>
+		/// The cost accumulator of the calling thread: if not null, the traversals of the thread add their cost to it.
+		/// </summary>
+		static TraversalCost *& threadCost()
+		{
+			static thread_local TraversalCost * result = nullptr;
+			return result;
+		}
+
+		/// <summary>
+		/// The tests of the traversals of the BVH: the boxes with their [t0;t1] interval and the triangles, in test order.
+		/// </summary>
+		struct TraversalLog
+		{
+			struct BoxTest
+			{
+				const BoundingBox * box;
+				double t0, t1;
+			};
+			::std::vector<BoxTest> boxes;
+			::std::vector<const Triangle*> triangles;
+		};
+
+		/// <summary>
+		/// The log of the calling thread: if not null, the traversals of the thread append their tests to it (only if
+		/// Use_TraversalLog is defined).
+		/// </summary>
+		static TraversalLog *& threadLog()
+		{
+			static thread_local TraversalLog * result = nullptr;
+			return result;
+		}
+
 		BVH(std::deque<std::pair < BoundingBox, Geometry>>&geometries, BoundingBox &sceneBoundingBox) {
 			//Initialisation de l'arbre depuis la scene
 			::std::deque <const Triangle*> geometrieslist;
@@ -71,61 +129,98 @@ namespace Geometry {
 			delete m_root;
 		}
 
+		/// <summary>
+		/// Measures the memory used by the tree (the triangle lists are kept in the inner nodes too).
+		/// </summary>
+		/// <param name="nodes">Receives the number of nodes.</param>
+		/// <param name="leaves">Receives the number of leaves.</param>
+		/// <param name="nodeBytes">Receives the size of the nodes.</param>
+		/// <param name="primitiveBytes">Receives the size of the triangle pointers stored in the nodes.</param>
+		void memoryUsage(size_t & nodes, size_t & leaves, size_t & nodeBytes, size_t & primitiveBytes) const
+		{
+			nodes = leaves = nodeBytes = primitiveBytes = 0;
+			::std::vector<const BVHNode*> stack(1, m_root);
+			while (!stack.empty())
+			{
+				const BVHNode * current = stack.back();
+				stack.pop_back();
+				++nodes;
+				nodeBytes += sizeof(BVHNode);
+				primitiveBytes += current->m_primitives.size() * sizeof(const Triangle*);
+				if (current->m_filsGauche == nullptr && current->m_filsDroit == nullptr) { ++leaves; }
+				if (current->m_filsGauche != nullptr) { stack.push_back(current->m_filsGauche); }
+				if (current->m_filsDroit != nullptr) { stack.push_back(current->m_filsDroit); }
+			}
+		}
+
 		void path(CastedRay &cray) {
 			double t0 = 0.0;
 			double t1 = 100000.0;
 			double entry, exit;
+			TraversalCost * cost = threadCost();
 			//box de la scene intersecte par le rayon
+			SpyCount(boxTests);
+			if (cost != nullptr) { ++cost->boxTests; }
+			TraversalLogged(log->boxes.push_back({ &m_root->m_boundingVolume, t0, t1 }));
 			if (m_root->m_boundingVolume.intersect(cray, t0, t1, entry, exit)) {
 				//on parcours recusirvement les box jusqu'a buff sur le triangle le plus proche
-					checkNode(m_root, cray, entry, exit);	
+					checkNode(m_root, cray, entry, exit, cost);	
 			}
 		}
 
 	protected:
-		void checkNode(BVHNode *current, CastedRay &cray, double t0, double t1) {
+		void checkNode(BVHNode *current, CastedRay &cray, double t0, double t1, TraversalCost * cost) {
 			double  l_entry, l_exit, r_entry, r_exit;
+			SpyCount(nodes);
+			if (cost != nullptr) { ++cost->nodes; }
 			if (current->isLeaf()) {
+				SpyCountN(triangleTests, current->m_primitives.size());
+				if (cost != nullptr) { cost->triangleTests += current->m_primitives.size(); }
+				TraversalLogged(log->triangles.insert(log->triangles.end(), current->m_primitives.begin(), current->m_primitives.end()));
 				for (const Triangle * t : current->m_primitives) {
 						cray.intersect(t);
 				}
 			}
 			else {
+				SpyCountN(boxTests, 2);
+				if (cost != nullptr) { cost->boxTests += 2; }
+				TraversalLogged(log->boxes.push_back({ &current->m_filsGauche->m_boundingVolume, t0, t1 }));
+				TraversalLogged(log->boxes.push_back({ &current->m_filsDroit->m_boundingVolume, t0, t1 }));
 				bool isIntersectFilsGauche = current->m_filsGauche->m_boundingVolume.intersect(cray, t0, t1, l_entry, l_exit);
 				bool isIntersectFilsDroit = current->m_filsDroit->m_boundingVolume.intersect(cray, t0, t1, r_entry, r_exit);
 
 				if (!isIntersectFilsGauche && !isIntersectFilsDroit) {}
 				else if (isIntersectFilsGauche && !isIntersectFilsDroit)
-					checkNode(current->m_filsGauche, cray, l_entry, l_exit);
+					checkNode(current->m_filsGauche, cray, l_entry, l_exit, cost);
 				else if (isIntersectFilsDroit && !isIntersectFilsGauche)
-					checkNode(current->m_filsDroit, cray, r_entry, r_exit);
+					checkNode(current->m_filsDroit, cray, r_entry, r_exit, cost);
 				else if (l_entry < r_entry)
 				{
-					checkNode(current->m_filsGauche, cray, l_entry, l_exit);
+					checkNode(current->m_filsGauche, cray, l_entry, l_exit, cost);
 
 					if (!cray.validIntersectionFound())
 					{
-						checkNode(current->m_filsDroit, cray, r_entry, r_exit);
+						checkNode(current->m_filsDroit, cray, r_entry, r_exit, cost);
 					}
 					else {
 						Math::Vector3f ti = cray.intersectionFound().intersection() - cray.source();
 						if (ti.norm() > r_entry) {
-							checkNode(current->m_filsDroit, cray, r_entry, ti.norm());
+							checkNode(current->m_filsDroit, cray, r_entry, ti.norm(), cost);
 						}
 					}
 				}
 				else
 				{
-					checkNode(current->m_filsDroit, cray, r_entry, r_exit);
+					checkNode(current->m_filsDroit, cray, r_entry, r_exit, cost);
 
 					if (!cray.validIntersectionFound())
 					{
-						checkNode(current->m_filsGauche, cray, l_entry, l_exit);
+						checkNode(current->m_filsGauche, cray, l_entry, l_exit, cost);
 					}
 					else {
 						Math::Vector3f ti = cray.intersectionFound().intersection() - cray.source();
 						if (ti.norm() > l_entry) {
-							checkNode(current->m_filsGauche, cray, l_entry, ti.norm());
+							checkNode(current->m_filsGauche, cray, l_entry, ti.norm(), cost);
 						}
 					}
 				}
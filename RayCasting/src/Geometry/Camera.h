@@ -136,6 +136,22 @@ namespace Geometry
 			computeParameters() ;
 		}
 
+		/// <summary>
+		/// Returns the position of the camera.
+		/// </summary>
+		const Math::Vector3f & getPosition() const
+		{
+			return m_position ;
+		}
+
+		/// <summary>
+		/// Returns the point looked at by the camera.
+		/// </summary>
+		const Math::Vector3f & getTarget() const
+		{
+			return m_target ;
+		}
+
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	Ray Camera::getRay(double coordX, double coordY) const
 		///
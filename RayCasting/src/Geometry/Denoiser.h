@@ -0,0 +1,161 @@
+#ifndef _Geometry_Denoiser_H
+#define _Geometry_Denoiser_H
+
+#include <Geometry/AccumulationBuffer.h>
+#include <Geometry/FeatureBuffer.h>
+#include <System/Trace.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace Geometry
+{
+	/// <summary>
+	/// Edge avoiding A-Trous wavelet filter (Dammertz et al. 2010, with the variance guided color weight of SVGF).
+	/// The image is divided by the albedo so that textures are not blurred, then filtered by a 5x5 B3 spline kernel
+	/// whose taps are spread by 1, 2, 4... pixels at each iteration. Each tap is weighted by the similarity of its
+	/// color (relative to the estimated noise of the pixel), normal, depth and albedo with the filtered pixel.
+	/// Each iteration is computed in parallel over tiles.
+	/// </summary>
+	class Denoiser
+	{
+	protected:
+		/// <summary> The number of iterations (the footprint of the filter is 4*2^iterations pixels wide). </summary>
+		int m_iterations;
+		/// <summary> The color tolerance, in standard deviations of the pixel mean. </summary>
+		double m_sigmaColor;
+		/// <summary> The exponent of the normal weight (cosine of the angle between normals). </summary>
+		double m_sigmaNormal;
+		/// <summary> The depth tolerance, relative to the depth of the pixel and per pixel of distance. </summary>
+		double m_sigmaDepth;
+		/// <summary> The albedo tolerance. </summary>
+		double m_sigmaAlbedo;
+		/// <summary> The size of the tiles processed in parallel. </summary>
+		int m_tileSize;
+
+		/// <summary>
+		/// Returns the factor dividing a color to remove the albedo (channels with a null albedo are kept).
+		/// </summary>
+		static RGBColor demodulation(RGBColor const & albedo)
+		{
+			RGBColor result;
+			for (int c = 0; c < 3; ++c)
+			{
+				result[c] = (albedo[c] > 1e-3) ? albedo[c] : 1.0;
+			}
+			return result;
+		}
+
+	public:
+		Denoiser(int iterations = 5, double sigmaColor = 1.0, double sigmaNormal = 128.0, double sigmaDepth = 0.05, double sigmaAlbedo = 0.1, int tileSize = 32)
+			: m_iterations(iterations), m_sigmaColor(sigmaColor), m_sigmaNormal(sigmaNormal), m_sigmaDepth(sigmaDepth), m_sigmaAlbedo(sigmaAlbedo), m_tileSize(tileSize)
+		{}
+
+		/// <summary>
+		/// Denoises an image.
+		/// </summary>
+		/// <param name="image">The accumulated samples.</param>
+		/// <param name="features">The features of the pixels of the image (same size).</param>
+		/// <returns>The denoised image, one sample per pixel (pixels without samples stay empty).</returns>
+		AccumulationBuffer denoise(AccumulationBuffer const & image, FeatureBuffer const & features) const
+		{
+			const int width = image.width();
+			const int height = image.height();
+			const int size = width*height;
+			// Demodulated colors and variances of their means
+			::std::vector<RGBColor> color(size), filtered(size);
+			::std::vector<RGBColor> albedo(size);
+			::std::vector<double> variance(size), filteredVariance(size);
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const int index = y*width + x;
+					albedo[index] = demodulation(features.albedo(x, y));
+					color[index] = image.mean(x, y);
+					for (int c = 0; c < 3; ++c) { color[index][c] /= albedo[index][c]; }
+					const double grey = albedo[index].grey();
+					variance[index] = (image.count(x, y) > 0) ? image.variance(x, y) / (image.count(x, y)*grey*grey) : 0.0;
+				}
+			}
+			static const double kernel[5] = { 1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+			const int tilesX = (width + m_tileSize - 1) / m_tileSize;
+			const int tilesY = (height + m_tileSize - 1) / m_tileSize;
+			for (int iteration = 0; iteration < m_iterations; ++iteration)
+			{
+				const int step = 1 << iteration;
+#pragma omp parallel for schedule(dynamic)
+				for (int tile = 0; tile < tilesX*tilesY; ++tile)
+				{
+					TraceScope("Denoise tile", "render");
+					const int x0 = (tile % tilesX)*m_tileSize;
+					const int y0 = (tile / tilesX)*m_tileSize;
+					for (int y = y0; y < ::std::min(y0 + m_tileSize, height); ++y)
+					{
+						for (int x = x0; x < ::std::min(x0 + m_tileSize, width); ++x)
+						{
+							const int p = y*width + x;
+							if (image.count(x, y) == 0)
+							{
+								filtered[p] = color[p];
+								filteredVariance[p] = variance[p];
+								continue;
+							}
+							const bool hit = features.hit(x, y);
+							const double depth = features.depth(x, y);
+							const double grey = color[p].grey();
+							const double colorScale = m_sigmaColor*sqrt(variance[p]) + 1e-6;
+							RGBColor sum;
+							double weights = 0.0;
+							double sumVariance = 0.0;
+							for (int dy = -2; dy <= 2; ++dy)
+							{
+								const int qy = y + dy*step;
+								if (qy < 0 || qy >= height) { continue; }
+								for (int dx = -2; dx <= 2; ++dx)
+								{
+									const int qx = x + dx*step;
+									if (qx < 0 || qx >= width || image.count(qx, qy) == 0 || features.hit(qx, qy) != hit) { continue; }
+									const int q = qy*width + qx;
+									double weight = kernel[dx + 2] * kernel[dy + 2] * exp(-fabs(color[q].grey() - grey) / colorScale);
+									if (hit)
+									{
+										const double cosine = ::std::max(0.0, features.normal(x, y)*features.normal(qx, qy));
+										const RGBColor albedoDifference = features.albedo(qx, qy) + features.albedo(x, y)*-1.0;
+										const double albedoDistance = albedoDifference[0] * albedoDifference[0] + albedoDifference[1] * albedoDifference[1] + albedoDifference[2] * albedoDifference[2];
+										weight *= pow(cosine, m_sigmaNormal)
+											* exp(-fabs(features.depth(qx, qy) - depth) / (m_sigmaDepth*depth*step*::std::max(::std::abs(dx), ::std::abs(dy)) + 1e-6))
+											* exp(-albedoDistance / (m_sigmaAlbedo*m_sigmaAlbedo));
+									}
+									sum = sum + color[q] * weight;
+									weights += weight;
+									sumVariance += weight*weight*variance[q];
+								}
+							}
+							// The center tap always has a positive weight
+							filtered[p] = sum / weights;
+							filteredVariance[p] = sumVariance / (weights*weights);
+						}
+					}
+				}
+				color.swap(filtered);
+				variance.swap(filteredVariance);
+			}
+			AccumulationBuffer result(width, height);
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					if (image.count(x, y) > 0)
+					{
+						result.add(x, y, color[y*width + x] * albedo[y*width + x]);
+					}
+				}
+			}
+			return result;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef _Geometry_DistributedRenderer_H
+#define _Geometry_DistributedRenderer_H
+
+#include <Geometry/Scene.h>
+#include <Geometry/AccumulationBuffer.h>
+#include <System/Socket.h>
+#include <Visualizer/Visualizer.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+namespace Geometry
+{
+	/// <summary>
+	/// Description of a distributed rendering, sent by the coordinator to each worker when it connects. The
+	/// settings of the render modes needing a pre-pass over the whole image (irradiance cache, photon maps,
+	/// radiosity, lightmap, path guiding) are not part of the job: these modes are not distributed.
+	/// </summary>
+	struct RenderJob
+	{
+		/// <summary> The name of the scene (resolved by the scene factory of the worker). </summary>
+		char scene[64];
+		::std::int32_t width;
+		::std::int32_t height;
+		::std::int32_t maxDepth;
+		::std::int32_t subPixelDivision;
+		::std::int32_t passPerPixel;
+		/// <summary> The size (in pixels) of the square tiles. </summary>
+		::std::int32_t tileSize;
+		/// <summary> The number of samples per pixel computed by one task. </summary>
+		::std::int32_t samplesPerTask;
+		/// <summary> The rendered region of the image (crop window): [cropX0;cropX1)x[cropY0;cropY1). </summary>
+		::std::int32_t cropX0, cropY0, cropX1, cropY1;
+		/// <summary> The path tracer (see Scene::setIterativePathTracing and Scene::setMultipleImportanceSampling). </summary>
+		::std::int32_t iterative;
+		::std::int32_t rouletteDepth;
+		::std::int32_t mis;
+
+		RenderJob(const ::std::string & sceneName = "", int width = 0, int height = 0, int maxDepth = 0, int subPixelDivision = 1, int passPerPixel = 1)
+			: width(width), height(height), maxDepth(maxDepth), subPixelDivision(subPixelDivision), passPerPixel(passPerPixel), tileSize(32), samplesPerTask(subPixelDivision*subPixelDivision),
+			  cropX0(0), cropY0(0), cropX1(width), cropY1(height), iterative(0), rouletteDepth(3), mis(0)
+		{
+			::std::memset(scene, 0, sizeof(scene));
+			::std::strncpy(scene, sceneName.c_str(), sizeof(scene) - 1);
+		}
+
+		/// <summary>
+		/// Restricts the rendering to a region of the image, clamped to the image (see Scene::setCropWindow).
+		/// </summary>
+		void setCropWindow(int x0, int y0, int x1, int y1)
+		{
+			cropX0 = ::std::max(0, ::std::min(x0, (int)width));
+			cropY0 = ::std::max(0, ::std::min(y0, (int)height));
+			cropX1 = ::std::max((int)cropX0, ::std::min(x1, (int)width));
+			cropY1 = ::std::max((int)cropY0, ::std::min(y1, (int)height));
+		}
+
+		/// <summary>
+		/// Sets the path tracer of the workers.
+		/// </summary>
+		void setPathTracing(bool iterative, int rouletteDepth, bool mis)
+		{
+			this->iterative = iterative ? 1 : 0;
+			this->rouletteDepth = rouletteDepth;
+			this->mis = mis ? 1 : 0;
+		}
+
+		/// <summary>
+		/// The total number of samples per pixel.
+		/// </summary>
+		int totalSamples() const
+		{ return passPerPixel * subPixelDivision * subPixelDivision; }
+	};
+
+	/// <summary>
+	/// A unit of work: the samples [sampleBegin;sampleEnd) of the pixels of the tile [x0;x1)x[y0;y1).
+	/// </summary>
+	struct RenderTask
+	{
+		::std::int32_t x0, y0, x1, y1;
+		::std::uint64_t sampleBegin, sampleEnd;
+
+		int pixels() const
+		{ return (x1 - x0)*(y1 - y0); }
+	};
+
+	/// <summary>
+	/// The messages exchanged between the coordinator and the workers. A worker says Hello and receives the
+	/// RenderJob, then sends Request (or Result followed by the float RGB sums of its task) and receives
+	/// either Task followed by a RenderTask, or Done.
+	/// </summary>
+	enum RenderMessage : ::std::uint32_t
+	{
+		RenderHello = 0x52435732u,
+		RenderRequest = 1,
+		RenderResult = 2,
+		RenderTaskMessage = 3,
+		RenderDone = 4
+	};
+
+	/// <summary>
+	/// A rendering worker: connects to a coordinator, loads the scene once and renders the tasks it receives
+	/// with Scene::renderTile until the coordinator has no more work.
+	/// </summary>
+	class RenderWorker
+	{
+	public:
+		/// <summary>
+		/// Initializes a scene given its name, returns false if the name is unknown.
+		/// </summary>
+		typedef ::std::function<bool(const ::std::string &, Scene &)> SceneFactory;
+
+		/// <summary>
+		/// Runs a worker until the coordinator has no more work.
+		/// </summary>
+		/// <param name="host">The host of the coordinator.</param>
+		/// <param name="port">The port of the coordinator.</param>
+		/// <param name="factory">The scene factory.</param>
+		/// <returns>false if the connection or the scene initialization failed.</returns>
+		static bool run(const ::std::string & host, unsigned short port, SceneFactory const & factory)
+		{
+			System::Socket socket = System::Socket::connect(host, port);
+			if (!socket.isValid())
+			{
+				::std::cerr << "RenderWorker: unable to connect to " << host << ":" << port << ::std::endl;
+				return false;
+			}
+			RenderJob job;
+			if (!socket.send((::std::uint32_t)RenderHello) || !socket.receive(job)) { return false; }
+			job.scene[sizeof(job.scene) - 1] = 0;
+			// The scene is loaded and its BVH built once for all the tasks
+			Scene scene(job.width, job.height);
+			if (!factory(job.scene, scene))
+			{
+				::std::cerr << "RenderWorker: unknown scene " << job.scene << ::std::endl;
+				return false;
+			}
+			scene.setIterativePathTracing(job.iterative != 0, job.rouletteDepth);
+			scene.setMultipleImportanceSampling(job.mis != 0);
+			scene.buildBVH();
+			::std::vector<float> data;
+			::std::uint32_t message = RenderRequest;
+			if (!socket.send(message)) { return false; }
+			while (socket.receive(message) && message == RenderTaskMessage)
+			{
+				RenderTask task;
+				if (!socket.receive(task)) { return false; }
+				AccumulationBuffer tile(task.x1 - task.x0, task.y1 - task.y0);
+				scene.renderTile(tile, task.x0, task.y0, task.x1, task.y1, task.sampleBegin, task.sampleEnd, job.maxDepth, job.subPixelDivision);
+				// Sums are sent (not means) so that the coordinator can merge tasks of the same pixels
+				data.resize(task.pixels() * 3);
+				for (int y = 0; y < tile.height(); ++y)
+				{
+					for (int x = 0; x < tile.width(); ++x)
+					{
+						const RGBColor & sum = tile.sum(x, y);
+						float * pixel = &data[(y*tile.width() + x) * 3];
+						pixel[0] = (float)sum[0];
+						pixel[1] = (float)sum[1];
+						pixel[2] = (float)sum[2];
+					}
+				}
+				if (!socket.send((::std::uint32_t)RenderResult) || !socket.send(data.data(), data.size()*sizeof(float))) { return false; }
+			}
+			return message == RenderDone;
+		}
+	};
+
+	/// <summary>
+	/// The coordinator of a distributed rendering. The image is split into tiles and the samples into
+	/// ranges, workers (local processes started by the coordinator or, if the coordinator listens on all the
+	/// interfaces, processes started by hand on other hosts) connect to the coordinator and pull tasks until
+	/// the image is complete. The workers are not authenticated: remote workers must only be allowed on a
+	/// trusted network. Tasks of lost workers
+	/// are given to the remaining ones. Results are merged into one accumulation buffer.
+	/// </summary>
+	class RenderCoordinator
+	{
+	protected:
+		/// <summary> A result waiting to be merged. </summary>
+		struct TaskResult
+		{
+			RenderTask task;
+			::std::vector<float> data;
+		};
+
+		/// <summary> The job sent to the workers. </summary>
+		RenderJob m_job;
+		/// <summary> The display (may be nullptr). </summary>
+		Visualizer::Visualizer * m_visu;
+		/// <summary> The merged samples of the crop window. </summary>
+		AccumulationBuffer m_buffer;
+		/// <summary> The socket waiting for workers. </summary>
+		System::Socket m_listener;
+		/// <summary> Protects all the members below. </summary>
+		::std::mutex m_mutex;
+		::std::condition_variable m_condition;
+		/// <summary> The tasks not yet assigned to a worker. </summary>
+		::std::deque<RenderTask> m_pending;
+		/// <summary> The number of tasks being rendered. </summary>
+		size_t m_inFlight;
+		/// <summary> The results not yet merged. </summary>
+		::std::deque<TaskResult> m_results;
+		/// <summary> The number of connected workers. </summary>
+		int m_connectedWorkers;
+		/// <summary> The number of local worker processes still running. </summary>
+		int m_runningProcesses;
+		/// <summary> Set when the rendering is over (stops the connection threads). </summary>
+		bool m_finished;
+
+		/// <summary>
+		/// Serves one worker until it disconnects or there is no more work.
+		/// </summary>
+		void serve(System::Socket & socket)
+		{
+			::std::uint32_t message;
+			if (!socket.receive(message) || message != RenderHello || !socket.send(m_job)) { return; }
+			{
+				::std::lock_guard<::std::mutex> lock(m_mutex);
+				++m_connectedWorkers;
+			}
+			RenderTask current;
+			bool assigned = false;
+			while (socket.receive(message))
+			{
+				if (message == RenderResult && assigned)
+				{
+					TaskResult result;
+					result.task = current;
+					result.data.resize(current.pixels() * 3);
+					if (!socket.receive(result.data.data(), result.data.size()*sizeof(float))) { break; }
+					::std::lock_guard<::std::mutex> lock(m_mutex);
+					m_results.push_back(::std::move(result));
+					--m_inFlight;
+					assigned = false;
+					m_condition.notify_all();
+				}
+				else if (message != RenderRequest) { break; }
+				// Waits for a task: the last tasks may come back if a worker is lost
+				::std::unique_lock<::std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return !m_pending.empty() || m_inFlight == 0 || m_finished; });
+				if (m_pending.empty() || m_finished)
+				{
+					lock.unlock();
+					socket.send((::std::uint32_t)RenderDone);
+					break;
+				}
+				current = m_pending.front();
+				m_pending.pop_front();
+				++m_inFlight;
+				assigned = true;
+				lock.unlock();
+				if (!socket.send((::std::uint32_t)RenderTaskMessage) || !socket.send(current)) { break; }
+			}
+			::std::lock_guard<::std::mutex> lock(m_mutex);
+			if (assigned)
+			{
+				// The worker has been lost, its task is given to another one
+				m_pending.push_front(current);
+				--m_inFlight;
+			}
+			--m_connectedWorkers;
+			m_condition.notify_all();
+		}
+
+		/// <summary>
+		/// Adds a result to the accumulation buffer and displays the tile.
+		/// </summary>
+		void merge(TaskResult const & result)
+		{
+			const RenderTask & task = result.task;
+			const int count = (int)(task.sampleEnd - task.sampleBegin);
+			const int width = task.x1 - task.x0;
+			for (int y = task.y0; y < task.y1; ++y)
+			{
+				for (int x = task.x0; x < task.x1; ++x)
+				{
+					const float * pixel = &result.data[((y - task.y0)*width + (x - task.x0)) * 3];
+					m_buffer.add(x - m_job.cropX0, y - m_job.cropY0, RGBColor(pixel[0], pixel[1], pixel[2]), count);
+					// Same tone scale as Scene::compute
+					if (m_visu != nullptr) { m_visu->plot(x, y, m_buffer.mean(x - m_job.cropX0, y - m_job.cropY0) * 10); }
+				}
+			}
+		}
+
+	public:
+		/// <summary>
+		/// Initializes the coordinator.
+		/// </summary>
+		/// <param name="job">The job (scene and rendering parameters).</param>
+		/// <param name="visu">The display of the progression (may be nullptr).</param>
+		RenderCoordinator(RenderJob const & job, Visualizer::Visualizer * visu = nullptr)
+			: m_job(job), m_visu(visu), m_buffer(job.cropX1 - job.cropX0, job.cropY1 - job.cropY0), m_inFlight(0), m_connectedWorkers(0), m_runningProcesses(0), m_finished(false)
+		{}
+
+		/// <summary>
+		/// Opens the socket waiting for the workers.
+		/// </summary>
+		/// <param name="port">The port, 0 lets the system choose a free port.</param>
+		/// <param name="remote">Accepts the workers of other hosts, otherwise only the local ones.</param>
+		/// <returns>The port, 0 on failure.</returns>
+		unsigned short listen(unsigned short port = 0, bool remote = false)
+		{
+			m_listener = System::Socket::listen(port, remote);
+			return m_listener.port();
+		}
+
+		/// <summary>
+		/// Renders the job: starts the local workers, serves every connected worker and merges the results.
+		/// </summary>
+		/// <param name="workerCommands">The command lines of the local workers (one process per command).</param>
+		/// <param name="timeout">The rendering fails if no worker is connected during this time (in seconds).</param>
+		/// <returns>false if all the local workers exited before the end of the rendering or if no worker was
+		/// connected during the timeout.</returns>
+		bool run(const ::std::vector<::std::string> & workerCommands, double timeout = 60.0)
+		{
+			if (!m_listener.isValid())
+			{
+				::std::cerr << "RenderCoordinator: no listening socket" << ::std::endl;
+				return false;
+			}
+			// Tasks are ordered by sample range first so that the whole image progresses at once
+			const int totalSamples = m_job.totalSamples();
+			const int samplesPerTask = ::std::max(1, (int)m_job.samplesPerTask);
+			for (int sample = 0; sample < totalSamples; sample += samplesPerTask)
+			{
+				for (int y = m_job.cropY0; y < m_job.cropY1; y += m_job.tileSize)
+				{
+					for (int x = m_job.cropX0; x < m_job.cropX1; x += m_job.tileSize)
+					{
+						RenderTask task;
+						task.x0 = x;
+						task.y0 = y;
+						task.x1 = ::std::min(x + (int)m_job.tileSize, (int)m_job.cropX1);
+						task.y1 = ::std::min(y + (int)m_job.tileSize, (int)m_job.cropY1);
+						task.sampleBegin = sample;
+						task.sampleEnd = ::std::min(sample + samplesPerTask, totalSamples);
+						m_pending.push_back(task);
+					}
+				}
+			}
+			const size_t totalTasks = m_pending.size();
+			// Local worker processes
+			::std::vector<::std::thread> processes;
+			m_runningProcesses = (int)workerCommands.size();
+			for (const ::std::string & command : workerCommands)
+			{
+				processes.push_back(::std::thread([this, command]()
+				{
+					int status = ::std::system(command.c_str());
+					if (status != 0) { ::std::cerr << "RenderCoordinator: worker exited with status " << status << ::std::endl; }
+					::std::lock_guard<::std::mutex> lock(m_mutex);
+					--m_runningProcesses;
+					m_condition.notify_all();
+				}));
+			}
+			// Connections (one thread per worker)
+			::std::vector<::std::thread> connections;
+			::std::thread acceptor([this, &connections]()
+			{
+				while (true)
+				{
+					{
+						::std::lock_guard<::std::mutex> lock(m_mutex);
+						if (m_finished) { break; }
+					}
+					if (!m_listener.wait(100)) { continue; }
+					System::Socket socket = m_listener.accept();
+					if (!socket.isValid()) { continue; }
+					connections.push_back(::std::thread([this](System::Socket socket) { serve(socket); }, ::std::move(socket)));
+				}
+			});
+			// Merges the results as they arrive
+			size_t merged = 0;
+			bool success = true;
+			::std::chrono::steady_clock::time_point connected = ::std::chrono::steady_clock::now();
+			while (merged < totalTasks)
+			{
+				::std::deque<TaskResult> results;
+				{
+					::std::unique_lock<::std::mutex> lock(m_mutex);
+					const bool ready = m_condition.wait_for(lock, ::std::chrono::milliseconds(100), [this, &workerCommands]()
+					{
+						return !m_results.empty() || (!workerCommands.empty() && m_runningProcesses == 0 && m_connectedWorkers == 0);
+					});
+					if (!ready)
+					{
+						// Waits for the workers as long as one is connected, then at most timeout seconds
+						const ::std::chrono::steady_clock::time_point now = ::std::chrono::steady_clock::now();
+						if (m_connectedWorkers > 0) { connected = now; }
+						else if (::std::chrono::duration<double>(now - connected).count() > timeout)
+						{
+							::std::cerr << "RenderCoordinator: no worker connected during " << timeout << " s" << ::std::endl;
+							success = false;
+							break;
+						}
+						continue;
+					}
+					if (m_results.empty())
+					{
+						::std::cerr << "RenderCoordinator: all the workers exited before the end of the rendering" << ::std::endl;
+						success = false;
+						break;
+					}
+					results.swap(m_results);
+				}
+				for (const TaskResult & result : results)
+				{
+					merge(result);
+				}
+				merged += results.size();
+				::std::cout << "Tasks: " << merged << "/" << totalTasks << ::std::endl;
+				if (m_visu != nullptr) { m_visu->update(); }
+			}
+			{
+				::std::lock_guard<::std::mutex> lock(m_mutex);
+				m_finished = true;
+				m_condition.notify_all();
+			}
+			acceptor.join();
+			for (::std::thread & connection : connections) { connection.join(); }
+			for (::std::thread & process : processes) { process.join(); }
+			return success;
+		}
+
+		/// <summary>
+		/// Returns the merged samples. The buffer covers the crop window of the job.
+		/// </summary>
+		const AccumulationBuffer & getAccumulationBuffer() const
+		{ return m_buffer; }
+	};
+}
+
+#endif
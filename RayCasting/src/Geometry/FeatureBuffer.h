@@ -0,0 +1,161 @@
+#ifndef _Geometry_FeatureBuffer_H
+#define _Geometry_FeatureBuffer_H
+
+#include <Geometry/RGBColor.h>
+#include <Math/Vectorf.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <functional>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The surface features seen through each pixel by the primary rays: albedo, shading normal, depth and the
+	/// identifiers of the triangle, mesh and material hit at the center of the pixel. These buffers are almost
+	/// noise free after a few samples, they guide the denoiser (see Geometry::Denoiser) and are exported as
+	/// auxiliary images for compositing.
+	/// </summary>
+	class FeatureBuffer
+	{
+	protected:
+		int m_width;
+		int m_height;
+		/// <summary> The albedo (diffuse color modulated by the texture) of the visible surface (row major). </summary>
+		::std::vector<RGBColor> m_albedo;
+		/// <summary> The unit shading normal of the visible surface (row major). </summary>
+		::std::vector<Math::Vector3f> m_normal;
+		/// <summary> The distance to the visible surface along the primary ray, negative if nothing is hit (row major). </summary>
+		::std::vector<double> m_depth;
+		/// <summary> The identifiers of the triangle, mesh and material at the center of the pixel, -1 if nothing is hit (row major). </summary>
+		::std::vector<int> m_triangle;
+		::std::vector<int> m_mesh;
+		::std::vector<int> m_material;
+
+		/// <summary>
+		/// Writes a Portable Float Map with one (Pf) or three (PF) channels per pixel.
+		/// </summary>
+		/// <param name="value">Writes the channels of a pixel.</param>
+		bool savePFM(const ::std::string & filename, int channels, ::std::function<void(int, int, float*)> const & value) const
+		{
+			::std::ofstream out(filename.c_str(), ::std::ios::binary);
+			if (!out)
+			{
+				::std::cerr << "FeatureBuffer: unable to write " << filename << ::std::endl;
+				return false;
+			}
+			// Negative scale means little endian, rows are stored from bottom to top
+			out << ((channels == 1) ? "Pf\n" : "PF\n") << m_width << " " << m_height << "\n-1.0\n";
+			::std::vector<float> row(m_width * channels);
+			for (int y = m_height - 1; y >= 0; --y)
+			{
+				for (int x = 0; x < m_width; ++x)
+				{
+					value(x, y, &row[x * channels]);
+				}
+				out.write((const char*)row.data(), row.size()*sizeof(float));
+			}
+			return (bool)out;
+		}
+
+	public:
+		FeatureBuffer(int width = 0, int height = 0)
+			: m_width(width), m_height(height), m_albedo(width*height), m_normal(width*height, Math::Vector3f(0.0)), m_depth(width*height, -1.0),
+			  m_triangle(width*height, -1), m_mesh(width*height, -1), m_material(width*height, -1)
+		{}
+
+		int width() const
+		{ return m_width; }
+
+		int height() const
+		{ return m_height; }
+
+		/// <summary>
+		/// Sets the features of a pixel.
+		/// </summary>
+		/// <param name="depth">The distance to the surface, negative if the primary rays miss the scene.</param>
+		void set(int x, int y, RGBColor const & albedo, Math::Vector3f const & normal, double depth)
+		{
+			int index = y*m_width + x;
+			m_albedo[index] = albedo;
+			m_normal[index] = normal;
+			m_depth[index] = depth;
+		}
+
+		/// <summary>
+		/// Sets the identifiers of the triangle, mesh and material seen at the center of a pixel.
+		/// </summary>
+		void setIds(int x, int y, int triangle, int mesh, int material)
+		{
+			int index = y*m_width + x;
+			m_triangle[index] = triangle;
+			m_mesh[index] = mesh;
+			m_material[index] = material;
+		}
+
+		const RGBColor & albedo(int x, int y) const
+		{ return m_albedo[y*m_width + x]; }
+
+		const Math::Vector3f & normal(int x, int y) const
+		{ return m_normal[y*m_width + x]; }
+
+		double depth(int x, int y) const
+		{ return m_depth[y*m_width + x]; }
+
+		int triangleId(int x, int y) const
+		{ return m_triangle[y*m_width + x]; }
+
+		int meshId(int x, int y) const
+		{ return m_mesh[y*m_width + x]; }
+
+		int materialId(int x, int y) const
+		{ return m_material[y*m_width + x]; }
+
+		/// <summary>
+		/// Returns true if the primary rays of the pixel hit the scene.
+		/// </summary>
+		bool hit(int x, int y) const
+		{ return m_depth[y*m_width + x] >= 0.0; }
+
+		/// <summary>
+		/// Returns the size of the pixel data in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_albedo.size()*sizeof(RGBColor) + m_normal.size()*sizeof(Math::Vector3f) + m_depth.size()*sizeof(double) + (m_triangle.size() + m_mesh.size() + m_material.size())*sizeof(int);
+		}
+
+		/// <summary>
+		/// Saves the features as Portable Float Maps named after an image: image.depth.pfm, image.normal.pfm,
+		/// image.albedo.pfm, image.triangle.pfm, image.mesh.pfm and image.material.pfm for image.pfm.
+		/// Depth and identifiers are single channel images, missed pixels have a depth and identifiers of -1.
+		/// </summary>
+		/// <returns>true if all the files have been written.</returns>
+		bool save(const ::std::string & imageFilename) const
+		{
+			bool result = true;
+			result &= savePFM(auxiliaryFilename(imageFilename, "depth"), 1, [this](int x, int y, float * v) { v[0] = (float)depth(x, y); });
+			result &= savePFM(auxiliaryFilename(imageFilename, "normal"), 3, [this](int x, int y, float * v) { for (int c = 0; c < 3; ++c) v[c] = (float)normal(x, y)[c]; });
+			result &= savePFM(auxiliaryFilename(imageFilename, "albedo"), 3, [this](int x, int y, float * v) { for (int c = 0; c < 3; ++c) v[c] = (float)albedo(x, y)[c]; });
+			result &= savePFM(auxiliaryFilename(imageFilename, "triangle"), 1, [this](int x, int y, float * v) { v[0] = (float)triangleId(x, y); });
+			result &= savePFM(auxiliaryFilename(imageFilename, "mesh"), 1, [this](int x, int y, float * v) { v[0] = (float)meshId(x, y); });
+			result &= savePFM(auxiliaryFilename(imageFilename, "material"), 1, [this](int x, int y, float * v) { v[0] = (float)materialId(x, y); });
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the name of an auxiliary image: the name of the image with the buffer name inserted before
+		/// its extension (image.pfm and depth give image.depth.pfm).
+		/// </summary>
+		static ::std::string auxiliaryFilename(::std::string filename, const ::std::string & buffer)
+		{
+			size_t dot = filename.rfind('.');
+			if (dot == ::std::string::npos || filename.find_first_of("/\\", dot) != ::std::string::npos) { dot = filename.size(); }
+			filename.insert(dot, "." + buffer);
+			return filename;
+		}
+	};
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <Geometry/Triangle.h>
 #include <Geometry/ComputeVertexNormals.h>
 #include <Geometry/Material.h>
+#include <System/Trace.h>
 #include <Math/Quaternion.h>
 #include <Math/Vectorf.h>
 #include <vector>
@@ -64,6 +65,12 @@ namespace Geometry
 		const std::deque<Math::Vector3f> & getVertices() const
 		{ return m_vertices ; }
 
+		/// <summary>
+		/// Gets the texture coordinates.
+		/// </summary>
+		const std::deque<Math::Vector2f> & getTextureCoordinates() const
+		{ return m_textureCoordinates; }
+
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	const std::vector<Triangle> & Geometry::getTriangles() const
 		///
@@ -392,12 +399,27 @@ namespace Geometry
 			updateTriangles() ;
 		}
 
+		/// <summary>
+		/// Moves the vertices of the geometry. The triangles keep referencing the same vertices and are updated
+		/// (their vertex normals are reset to the face normals).
+		/// </summary>
+		/// <param name="vertices">The new positions, one per vertex.</param>
+		void setVertices(const std::deque<Math::Vector3f> & vertices)
+		{
+			for(size_t cpt=0 ; cpt<m_vertices.size() && cpt<vertices.size() ; cpt++)
+			{
+				m_vertices[cpt] = vertices[cpt] ;
+			}
+			updateTriangles() ;
+		}
+
 		/// <summary>
 		/// Computes the per vertex normals.
 		/// </summary>
 		/// <param name="angle">The angle limit for smoothing surface.</param>
 		void computeVertexNormals(double angle)
 		{
+			TraceScope("computeVertexNormals", "load");
 			double cosAngleLimit = cos(angle);
 			::std::vector<Triangle *> triangles;
 			for (auto it = m_triangles.begin(), end = m_triangles.end(); it != end; ++it)
@@ -0,0 +1,256 @@
+#ifndef _Geometry_GuidingField_H
+#define _Geometry_GuidingField_H
+
+#include <Geometry/BoundingBox.h>
+#include <Geometry/RGBColor.h>
+#include <Math/DirectionalQuadtree.h>
+#include <Math/Vectorf.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The guiding distributions of path guiding (Muller et al. 17, the SD-tree): the bounding box of the scene is
+	/// adaptively subdivided by a binary tree (cells split in their middle, the axis cycling with the depth) and
+	/// each leaf owns two directional quadtrees of the incident radiance: the sampling one, learnt during the
+	/// previous iteration and read by the renderings, and the training one, receiving the radiance of the paths of
+	/// the current iteration. At the end of an iteration, the leaves that received enough samples are split, the
+	/// training trees become the sampling trees and the new training trees are refined where the energy is.
+	/// Recording is lock free, so the paths of an iteration can be traced concurrently.
+	/// </summary>
+	class GuidingField
+	{
+	public:
+		/// <summary>
+		/// A vertex of a training path, accumulating the light of the following vertices.
+		/// </summary>
+		struct Vertex
+		{
+			Math::Vector3f position;
+			/// <summary> The sampled direction and its density. </summary>
+			Math::Vector3f direction;
+			double density;
+			/// <summary> The throughput of the path after the vertex. </summary>
+			RGBColor throughput;
+			/// <summary> The light brought by the following vertices (weighted by the throughput). </summary>
+			RGBColor radiance;
+		};
+
+		/// <summary> The maximum number of recorded vertices of a path. </summary>
+		static const int maxVertices = 32;
+
+	protected:
+		struct Node
+		{
+			/// <summary> The children (0 for a leaf, the root is never a child). </summary>
+			unsigned int child[2];
+			/// <summary> The leaf of the node (leaves only). </summary>
+			unsigned int leaf;
+		};
+
+		struct Leaf
+		{
+			Math::DirectionalQuadtree sampling;
+			Math::DirectionalQuadtree training;
+			::std::atomic<unsigned int> samples;
+
+			Leaf()
+				: samples(0)
+			{}
+
+			Leaf(const Leaf & other)
+				: sampling(other.sampling), training(other.training), samples(other.samples.load())
+			{}
+		};
+
+		BoundingBox m_box;
+		::std::vector<Node> m_nodes;
+		::std::vector<Leaf> m_leaves;
+		/// <summary> The number of completed iterations. </summary>
+		int m_iteration;
+
+		/// <summary> A leaf splits once it received c*sqrt(2^iteration) samples (the iterations double their passes). </summary>
+		static double splitThreshold()
+		{
+			return 12000.0;
+		}
+
+		/// <summary> A quadrant of a training tree is subdivided if it holds more than this share of the energy. </summary>
+		static double energyThreshold()
+		{
+			return 0.01;
+		}
+
+		static const int maxDepth = 24;
+
+		/// <summary>
+		/// The leaf containing a position.
+		/// </summary>
+		unsigned int locate(Math::Vector3f const & position) const
+		{
+			Math::Vector3f lower = m_box.min();
+			Math::Vector3f upper = m_box.max();
+			unsigned int node = 0;
+			int level = 0;
+			while (m_nodes[node].child[0] != 0)
+			{
+				const int axis = level % 3;
+				const double middle = (lower[axis] + upper[axis])*0.5;
+				if (position[axis] < middle)
+				{
+					upper[axis] = middle;
+					node = m_nodes[node].child[0];
+				}
+				else
+				{
+					lower[axis] = middle;
+					node = m_nodes[node].child[1];
+				}
+				++level;
+			}
+			return m_nodes[node].leaf;
+		}
+
+		/// <summary>
+		/// Splits the leaves of the subtree of a node that received too many samples, the children inheriting
+		/// the trees of their parent.
+		/// </summary>
+		void split(unsigned int node, int depth, double threshold)
+		{
+			if (m_nodes[node].child[0] != 0)
+			{
+				split(m_nodes[node].child[0], depth + 1, threshold);
+				split(m_nodes[node].child[1], depth + 1, threshold);
+				return;
+			}
+			const unsigned int leaf = m_nodes[node].leaf;
+			const unsigned int samples = m_leaves[leaf].samples.load();
+			if (depth >= maxDepth || samples <= threshold) { return; }
+			// The samples are shared by the children, which may split again
+			m_leaves[leaf].samples = samples / 2;
+			const Leaf copy(m_leaves[leaf]);
+			m_leaves.push_back(copy);
+			Node first = { { 0, 0 }, leaf };
+			Node second = { { 0, 0 }, (unsigned int)m_leaves.size() - 1 };
+			const unsigned int index = (unsigned int)m_nodes.size();
+			m_nodes.push_back(first);
+			m_nodes.push_back(second);
+			m_nodes[node].child[0] = index;
+			m_nodes[node].child[1] = index + 1;
+			split(index, depth + 1, threshold);
+			split(index + 1, depth + 1, threshold);
+		}
+
+	public:
+		GuidingField()
+		{
+			clear();
+		}
+
+		/// <summary>
+		/// Resets the field to a single cell covering the box, with uniform distributions.
+		/// </summary>
+		void reset(BoundingBox const & box)
+		{
+			clear();
+			m_box = box;
+		}
+
+		void clear()
+		{
+			Node root = { { 0, 0 }, 0 };
+			m_nodes.assign(1, root);
+			m_leaves.clear();
+			m_leaves.push_back(Leaf());
+			m_iteration = 0;
+		}
+
+		/// <summary>
+		/// Returns the number of completed iterations (0: the sampling distributions are not learnt yet).
+		/// </summary>
+		int iteration() const
+		{
+			return m_iteration;
+		}
+
+		/// <summary>
+		/// Returns the number of cells.
+		/// </summary>
+		size_t size() const
+		{
+			return m_leaves.size();
+		}
+
+		/// <summary>
+		/// Returns the memory used by the field in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			size_t result = m_nodes.capacity()*sizeof(Node) + m_leaves.capacity()*sizeof(Leaf);
+			for (const Leaf & leaf : m_leaves) { result += leaf.sampling.memorySize() + leaf.training.memorySize(); }
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the sampling distribution of the incident radiance at a position, nullptr if nothing has been
+		/// learnt there.
+		/// </summary>
+		const Math::DirectionalQuadtree * distribution(Math::Vector3f const & position) const
+		{
+			if (m_iteration == 0) { return nullptr; }
+			const Math::DirectionalQuadtree & result = m_leaves[locate(position)].sampling;
+			return (result.energy() > 0.0) ? &result : nullptr;
+		}
+
+		/// <summary>
+		/// Records the incident radiance estimate of a path vertex: the radiance arriving in a direction divided by
+		/// the density of the direction. Can be called concurrently.
+		/// </summary>
+		void record(Math::Vector3f const & position, Math::Vector3f const & direction, double value)
+		{
+			Leaf & leaf = m_leaves[locate(position)];
+			++leaf.samples;
+			leaf.training.record(direction, (float)value);
+		}
+
+		/// <summary>
+		/// Records the vertices of a training path: the incident radiance of a vertex is the light of the following
+		/// vertices divided by the throughput after the vertex.
+		/// </summary>
+		void record(const Vertex * vertices, int count)
+		{
+			for (int cpt = 0; cpt < count; ++cpt)
+			{
+				const Vertex & vertex = vertices[cpt];
+				if (vertex.density <= 0.0) { continue; }
+				double radiance = 0.0;
+				for (int c = 0; c < 3; ++c)
+				{
+					if (vertex.throughput[c] > 0.0) { radiance += vertex.radiance[c] / vertex.throughput[c]; }
+				}
+				record(vertex.position, vertex.direction, radiance / (3.0*vertex.density));
+			}
+		}
+
+		/// <summary>
+		/// Ends a training iteration: splits the crowded cells, then the training distributions become the sampling
+		/// ones and new training distributions are refined from them. Must not be called during the renderings.
+		/// </summary>
+		void refine()
+		{
+			split(0, 0, splitThreshold()*sqrt(pow(2.0, m_iteration)));
+			for (Leaf & leaf : m_leaves)
+			{
+				leaf.sampling = leaf.training;
+				leaf.training.rebuild(leaf.sampling, energyThreshold());
+				leaf.samples = 0;
+			}
+			++m_iteration;
+		}
+	};
+}
+
+#endif
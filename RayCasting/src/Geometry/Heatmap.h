@@ -0,0 +1,65 @@
+#ifndef _Geometry_Heatmap_H
+#define _Geometry_Heatmap_H
+
+#include <Geometry/RGBColor.h>
+#include <Geometry/BVH.h>
+#include <algorithm>
+#include <string>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The settings of the traversal cost render mode: each pixel shows the average number of BVH nodes visited
+	/// or triangles tested per sample, for the primary rays only or for whole paths, as a false color.
+	/// </summary>
+	class Heatmap
+	{
+	public:
+		enum Metric { None, Nodes, Triangles };
+
+		/// <summary> The displayed cost (None disables the render mode). </summary>
+		Metric metric;
+		/// <summary> True to measure the whole paths, false for the primary rays only. </summary>
+		bool path;
+		/// <summary> The cost mapped to the hottest color, 0 to use the maximum cost of the image. </summary>
+		double scale;
+
+		Heatmap(Metric metric = None, bool path = false, double scale = 0.0)
+			: metric(metric), path(path), scale(scale)
+		{}
+
+		/// <summary>
+		/// Parses the name of a metric (nodes or triangles).
+		/// </summary>
+		static Metric metricFromName(const ::std::string & name)
+		{
+			if (name == "nodes") { return Nodes; }
+			if (name == "triangles") { return Triangles; }
+			return None;
+		}
+
+		/// <summary>
+		/// Returns the measured value of a traversal cost.
+		/// </summary>
+		double value(BVH::TraversalCost const & cost) const
+		{
+			return (double)((metric == Nodes) ? cost.nodes : cost.triangleTests);
+		}
+
+		/// <summary>
+		/// Maps a value in [0;1] to a false color: black, blue, cyan, green, yellow, red (clamped outside).
+		/// </summary>
+		static RGBColor falseColor(double t)
+		{
+			static const double colors[6][3] = { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } };
+			t = ::std::min(1.0, ::std::max(0.0, t)) * 5.0;
+			const int index = ::std::min((int)t, 4);
+			const double u = t - index;
+			return RGBColor(colors[index][0] * (1.0 - u) + colors[index + 1][0] * u,
+				colors[index][1] * (1.0 - u) + colors[index + 1][1] * u,
+				colors[index][2] * (1.0 - u) + colors[index + 1][2] * u);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef _Geometry_LightBVH_H
+#define _Geometry_LightBVH_H
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Triangle.h>
+#include <Geometry/BoundingBox.h>
+#include <Geometry/RGBColor.h>
+#include <Math/Vectorf.h>
+#include <Math/Quaternion.h>
+#include <Math/Constant.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// A hierarchy of the emissive triangles of a scene for the importance sampling of one light per shading point.
+	/// Each node bounds the positions, the emitted power and the orientations (a cone of normals) of its triangles.
+	/// Sampling descends from the root, choosing a child with a probability proportional to its importance seen
+	/// from the shading point (power / squared distance, bounded cosines at the light and at the receiver), so a
+	/// sample costs O(log n). The density of a triangle is recomputed by walking from its leaf to the root.
+	/// Triangles emit on both sides, textured emitters are weighted by their average emission.
+	/// </summary>
+	class LightBVH
+	{
+	public:
+		/// <summary>
+		/// The decrease of the importance with the distance: physical lights (InverseSquare) or the point lights of the
+		/// phong model (Inverse, see Scene::phongDiffuse).
+		/// </summary>
+		enum Falloff { InverseSquare, Inverse };
+
+		/// <summary>
+		/// A point sampled on a light.
+		/// </summary>
+		struct Sample
+		{
+			const Triangle * triangle;
+			Math::Vector3f point;
+			/// <summary> The geometric normal of the triangle. </summary>
+			Math::Vector3f normal;
+			/// <summary> The emission at the point (with the texture of the triangle). </summary>
+			RGBColor emission;
+			/// <summary> The area density of the point. </summary>
+			double pdfArea;
+			/// <summary> The choice value rescaled to the chosen triangle, a new uniform value in [0;1). </summary>
+			double choice;
+		};
+
+	protected:
+		struct Node
+		{
+			Math::Vector3f lower, upper;
+			/// <summary> The axis and the half angle of the cone containing the normals (up to their sign). </summary>
+			Math::Vector3f axis;
+			double angle;
+			double power;
+			int left, right, parent;
+			/// <summary> The triangle of a leaf (-1 for inner nodes). </summary>
+			int triangle;
+		};
+
+		::std::vector<Node> m_nodes;
+		::std::vector<const Triangle*> m_triangles;
+		/// <summary> The leaf of each triangle. </summary>
+		::std::unordered_map<const Triangle*, int> m_leafOf;
+
+		static double power(const Triangle & triangle)
+		{
+			return triangle.averageEmission().grey() * triangle.surface();
+		}
+
+		/// <summary>
+		/// Merges two cones of normals (normals are defined up to their sign).
+		/// </summary>
+		static void mergeCones(Math::Vector3f & axis, double & angle, Math::Vector3f other, double otherAngle)
+		{
+			if (angle >= Math::piDiv2) { return; }
+			if (otherAngle >= Math::piDiv2) { angle = Math::piDiv2; return; }
+			if (axis*other < 0.0) { other = -other; }
+			double between = acos(::std::min(1.0, ::std::max(-1.0, axis*other)));
+			if (between + otherAngle <= angle) { return; }
+			if (between + angle <= otherAngle) { axis = other; angle = otherAngle; return; }
+			double merged = (angle + between + otherAngle) / 2.0;
+			if (merged >= Math::piDiv2) { angle = Math::piDiv2; return; }
+			Math::Vector3f rotationAxis = axis ^ other;
+			if (rotationAxis.norm() > 1e-12)
+			{
+				Math::Quaternion<double> rotation(rotationAxis.normalized(), merged - angle);
+				axis = rotation.rotate(axis);
+				axis = axis.normalized();
+			}
+			angle = merged;
+		}
+
+		/// <summary>
+		/// Builds the node of the triangles [begin;end) and returns its index.
+		/// </summary>
+		int build(::std::vector<int> & triangles, size_t begin, size_t end, int parent)
+		{
+			int index = (int)m_nodes.size();
+			m_nodes.push_back(Node());
+			Node node;
+			node.parent = parent;
+			node.left = node.right = node.triangle = -1;
+			node.power = 0.0;
+			node.angle = 0.0;
+			Math::Vector3f centerLower, centerUpper;
+			for (size_t cpt = begin; cpt < end; ++cpt)
+			{
+				const Triangle & triangle = *m_triangles[triangles[cpt]];
+				for (int v = 0; v < 3; ++v)
+				{
+					node.lower = (cpt == begin && v == 0) ? triangle.vertex(v) : node.lower.simdMin(triangle.vertex(v));
+					node.upper = (cpt == begin && v == 0) ? triangle.vertex(v) : node.upper.simdMax(triangle.vertex(v));
+				}
+				centerLower = (cpt == begin) ? triangle.center() : centerLower.simdMin(triangle.center());
+				centerUpper = (cpt == begin) ? triangle.center() : centerUpper.simdMax(triangle.center());
+				node.power += power(triangle);
+				if (cpt == begin) { node.axis = triangle.normal().normalized(); }
+				else { mergeCones(node.axis, node.angle, triangle.normal().normalized(), 0.0); }
+			}
+			if (end - begin == 1)
+			{
+				node.triangle = triangles[begin];
+				m_leafOf[m_triangles[node.triangle]] = index;
+				m_nodes[index] = node;
+				return index;
+			}
+			// Median split along the largest extent of the centers
+			Math::Vector3f extent = centerUpper - centerLower;
+			int axis = (extent[1] > extent[0]) ? 1 : 0;
+			if (extent[2] > extent[axis]) { axis = 2; }
+			size_t middle = (begin + end) / 2;
+			::std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end, [this, axis](int a, int b) {
+				return m_triangles[a]->center()[axis] < m_triangles[b]->center()[axis];
+			});
+			m_nodes[index] = node;
+			int left = build(triangles, begin, middle, index);
+			int right = build(triangles, middle, end, index);
+			m_nodes[index].left = left;
+			m_nodes[index].right = right;
+			return index;
+		}
+
+		/// <summary>
+		/// The importance of a node seen from a shading point with a given normal (null normal: no receiver bound).
+		/// </summary>
+		double importance(const Node & node, Math::Vector3f const & point, Math::Vector3f const & normal, Falloff falloff) const
+		{
+			Math::Vector3f center = (node.lower + node.upper)*0.5;
+			Math::Vector3f toNode = center - point;
+			double distance2 = toNode.norm2();
+			double radius2 = (node.upper - center).norm2();
+			// Inside the bounds: no angular bound
+			if (distance2 <= radius2) { return node.power / ::std::max(falloff == Inverse ? sqrt(radius2) : radius2, 1e-12); }
+			double distance = sqrt(distance2);
+			Math::Vector3f direction = toNode / distance;
+			// The half angle of the cone containing the node seen from the point
+			double uncertainty = asin(::std::min(1.0, sqrt(radius2 / distance2)));
+			double result = node.power / (falloff == Inverse ? distance : distance2);
+			if (node.angle < Math::piDiv2)
+			{
+				double lightAngle = acos(::std::min(1.0, ::std::abs(node.axis*direction)));
+				double bound = lightAngle - node.angle - uncertainty;
+				if (bound >= Math::piDiv2) { return 0.0; }
+				if (bound > 0.0) { result *= cos(bound); }
+			}
+			if (normal.norm2() > 0.0)
+			{
+				double receiverAngle = acos(::std::min(1.0, ::std::max(-1.0, normal*direction)));
+				double bound = receiverAngle - uncertainty;
+				if (bound >= Math::piDiv2) { return 0.0; }
+				if (bound > 0.0) { result *= cos(bound); }
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// The probability of choosing the left child of a node.
+		/// </summary>
+		double leftProbability(const Node & node, Math::Vector3f const & point, Math::Vector3f const & normal, Falloff falloff) const
+		{
+			double left = importance(m_nodes[node.left], point, normal, falloff);
+			double right = importance(m_nodes[node.right], point, normal, falloff);
+			if (left + right <= 0.0)
+			{
+				// Nothing is visible from the point: falls back on the power
+				left = m_nodes[node.left].power;
+				right = m_nodes[node.right].power;
+			}
+			return left / (left + right);
+		}
+
+	public:
+		/// <summary>
+		/// Builds the hierarchy of the emissive triangles of the geometries (the triangles must outlive the hierarchy).
+		/// </summary>
+		void build(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries)
+		{
+			m_nodes.clear();
+			m_triangles.clear();
+			m_leafOf.clear();
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : geometries)
+			{
+				for (const Triangle & triangle : geometry.second.getTriangles())
+				{
+					if (!triangle.material()->getEmissive().isBlack() && triangle.surface() > 0.0) { m_triangles.push_back(&triangle); }
+				}
+			}
+			if (m_triangles.empty()) { return; }
+			::std::vector<int> triangles(m_triangles.size());
+			for (size_t cpt = 0; cpt < triangles.size(); ++cpt) { triangles[cpt] = (int)cpt; }
+			m_nodes.reserve(2 * triangles.size());
+			build(triangles, 0, triangles.size(), -1);
+		}
+
+		bool empty() const
+		{
+			return m_triangles.empty();
+		}
+
+		/// <summary>
+		/// Returns the number of emissive triangles.
+		/// </summary>
+		size_t size() const
+		{
+			return m_triangles.size();
+		}
+
+		/// <summary>
+		/// Returns the memory used by the hierarchy in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_nodes.capacity()*sizeof(Node) + m_triangles.capacity()*sizeof(const Triangle*) + m_leafOf.size()*(sizeof(const Triangle*) + sizeof(int) + 2 * sizeof(void*));
+		}
+
+		/// <summary>
+		/// Samples a point on the emissive triangles for a shading point.
+		/// </summary>
+		/// <param name="point">The shading point.</param>
+		/// <param name="normal">The normal at the shading point (a null vector disables the receiver bound).</param>
+		/// <param name="choice">A uniform value in [0;1) selecting the triangle.</param>
+		/// <param name="xi1">A uniform value in [0;1) for the position on the triangle.</param>
+		/// <param name="xi2">A uniform value in [0;1) for the position on the triangle.</param>
+		/// <param name="falloff">The decrease of the importance with the distance.</param>
+		/// <returns>false if the scene has no emissive triangle.</returns>
+		bool sample(Math::Vector3f const & point, Math::Vector3f const & normal, double choice, double xi1, double xi2, Sample & result, Falloff falloff = InverseSquare) const
+		{
+			if (m_nodes.empty()) { return false; }
+			double probability = 1.0;
+			int current = 0;
+			while (m_nodes[current].triangle < 0)
+			{
+				const Node & node = m_nodes[current];
+				double left = leftProbability(node, point, normal, falloff);
+				if (choice < left)
+				{
+					choice = choice / left;
+					probability *= left;
+					current = node.left;
+				}
+				else
+				{
+					choice = ::std::min((choice - left) / (1.0 - left), 1.0 - 1e-12);
+					probability *= 1.0 - left;
+					current = node.right;
+				}
+			}
+			result.triangle = m_triangles[m_nodes[current].triangle];
+			result.choice = choice;
+			Math::Vector3f barycentric = Triangle::sampleBarycentric(xi1, xi2);
+			result.point = result.triangle->pointFromBraycentric(barycentric);
+			result.normal = result.triangle->normal();
+			result.emission = result.triangle->material()->getEmissive()*result.triangle->sampleTexture(barycentric);
+			result.pdfArea = probability / result.triangle->surface();
+			return true;
+		}
+
+		/// <summary>
+		/// Returns the area density with which LightBVH::sample generates a point of a triangle for a shading point,
+		/// 0 if the triangle does not emit.
+		/// </summary>
+		double pdfArea(Math::Vector3f const & point, Math::Vector3f const & normal, const Triangle * triangle, Falloff falloff = InverseSquare) const
+		{
+			auto found = m_leafOf.find(triangle);
+			if (found == m_leafOf.end()) { return 0.0; }
+			double probability = 1.0;
+			for (int current = found->second; m_nodes[current].parent >= 0; current = m_nodes[current].parent)
+			{
+				const Node & parent = m_nodes[m_nodes[current].parent];
+				double left = leftProbability(parent, point, normal, falloff);
+				probability *= (parent.left == current) ? left : 1.0 - left;
+			}
+			return probability / triangle->surface();
+		}
+	};
+}
+
+#endif
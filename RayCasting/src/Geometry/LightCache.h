@@ -2,68 +2,203 @@
 #define _Geometry_LightCache_H
 
 #include <Geometry/RGBColor.h>
-#include <Geometry/Triangle.h>
-#include <map>
+#include <Math/Vectorf.h>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <math.h>
 
 namespace Geometry
 {
+	/// <summary>
+	/// An irradiance cache (Ward et al. 88): the indirect diffuse irradiance is stored at sparse surface points
+	/// and interpolated in between. Each record is valid in a neighbourhood given by the split sphere heuristic:
+	/// its radius is the harmonic mean distance of the surfaces seen from the record, and a point p of normal n
+	/// uses the record i if err_i(p) = |p-p_i|/R_i + sqrt(1 - n.n_i) is below the accuracy. The records are
+	/// weighted by 1/err_i - 1/accuracy, so that their influence vanishes continuously at the border.
+	/// The records are referenced by the cells of a hashed grid whose cells contain the largest validity
+	/// sphere, so a lookup only reads the list of one cell. Lookups are lock free: the lists of the cells are
+	/// only extended by publishing a new head (atomically), the records are never moved nor modified once
+	/// inserted. Insertions are serialized.
+	/// </summary>
 	class LightCache
 	{
 	public:
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		/// \typedef	::std::pair<int, int> Coordinates
-		///
-		/// \brief	Defines an alias representing the coordinates (x,y).
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		typedef ::std::pair<int, int> Coordinates ;
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		/// \typedef	::std::pair<RGBColor, int> TexelRecord
-		///
-		/// \brief	Defines an alias representing the texel record (color, depth of computation).
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		typedef ::std::pair<RGBColor, int> TexelRecord ;
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		/// \typedef	::std::map<Coordinates, TexelRecord> TriangleCache
-		///
-		/// \brief	Defines an alias representing the triangle cache i.e. the association between local 
-		/// 		triangle coordinates and the texel record.
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		typedef ::std::map<Coordinates, TexelRecord> TriangleCache ;
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		/// \typedef	::std::map<const Triangle *, TriangleCache> Cache
-		///
-		/// \brief	Defines an alias representing the light cache i.e. association between triangle and
-		/// 		triangle cache.
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		typedef ::std::map<const Triangle *, TriangleCache> Cache ;
+		/// <summary>
+		/// An irradiance record.
+		/// </summary>
+		struct Record
+		{
+			Math::Vector3f position;
+			Math::Vector3f normal;
+			/// <summary> The indirect irradiance at the position. </summary>
+			RGBColor irradiance;
+			/// <summary> The harmonic mean distance of the surfaces seen from the position. </summary>
+			double radius;
+		};
 
 	protected:
-		/// \brief	The cache.
-		Cache m_cache ;
+		/// <summary>
+		/// An element of the list of a cell.
+		/// </summary>
+		struct Entry
+		{
+			const Record * record;
+			const Entry * next;
+		};
 
-	public:
+		/// <summary> The maximum error of the records used by a lookup (the 'a' of Ward). </summary>
+		double m_accuracy;
+		/// <summary> The bounds of the radius of the records. </summary>
+		double m_minRadius;
+		double m_maxRadius;
+		double m_cellSize;
+		/// <summary> The heads of the lists of the cells (cells are hashed in a fixed number of buckets). </summary>
+		::std::vector<::std::atomic<const Entry*> > m_buckets;
+		/// <summary> The storage of the records and of the entries (deques never move their elements). </summary>
+		::std::deque<Record> m_records;
+		::std::deque<Entry> m_entries;
+		::std::mutex m_insertion;
+		::std::atomic<size_t> m_size;
+
+		static const size_t bucketCount = 1 << 16;
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////
-		/// \fn	LightCache::LightCache()
-		///
-		/// \brief	Default constructor.
-		///
-		/// \author	F. Lamarche, Universit de Rennes 1
-		/// \date	07/12/2013
-		////////////////////////////////////////////////////////////////////////////////////////////////////
+		size_t bucket(int x, int y, int z) const
+		{
+			return (size_t)(((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u)) & (bucketCount - 1);
+		}
+
+		int cell(double coordinate) const
+		{
+			return (int)floor(coordinate / m_cellSize);
+		}
+
+	public:
+		/// <summary>
+		/// Constructor
+		/// </summary>
 		LightCache()
-		{}
+			: m_accuracy(0.2), m_minRadius(0.0), m_maxRadius(1.0), m_cellSize(0.2), m_buckets(bucketCount), m_size(0)
+		{
+			clear();
+		}
 
-		TriangleCache & getTriangleCache(const Triangle * triangle)
+		/// <summary>
+		/// Removes all the records and sets the parameters of the cache. Must not be called during lookups.
+		/// </summary>
+		/// <param name="accuracy">The maximum error of the records used by a lookup.</param>
+		/// <param name="minRadius">The minimum radius of a record (limits the density of records in corners).</param>
+		/// <param name="maxRadius">The maximum radius of a record (limits the extrapolation in open areas).</param>
+		void reset(double accuracy, double minRadius, double maxRadius)
 		{
-			return m_cache[triangle] ;
+			m_accuracy = accuracy;
+			m_minRadius = minRadius;
+			m_maxRadius = ::std::max(maxRadius, minRadius);
+			m_cellSize = ::std::max(2.0*m_accuracy*m_maxRadius, 1e-12);
+			clear();
 		}
 
+		/// <summary>
+		/// Removes all the records. Must not be called during lookups.
+		/// </summary>
+		void clear()
+		{
+			for (::std::atomic<const Entry*> & head : m_buckets) { head.store(nullptr); }
+			m_records.clear();
+			m_entries.clear();
+			m_size = 0;
+		}
 
+		double accuracy() const
+		{
+			return m_accuracy;
+		}
+
+		/// <summary>
+		/// Returns the number of records.
+		/// </summary>
+		size_t size() const
+		{
+			return m_size;
+		}
+
+		/// <summary>
+		/// Returns the memory used by the cache in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_buckets.size()*sizeof(::std::atomic<const Entry*>) + m_records.size()*sizeof(Record) + m_entries.size()*sizeof(Entry);
+		}
+
+		/// <summary>
+		/// Interpolates the irradiance at a surface point from the valid records. Can be called concurrently
+		/// with other lookups and insertions.
+		/// </summary>
+		/// <param name="position">The surface point.</param>
+		/// <param name="normal">The normal at the point (normalized).</param>
+		/// <param name="irradiance">Receives the interpolated irradiance.</param>
+		/// <returns>false if no record is valid at the point.</returns>
+		bool lookup(Math::Vector3f const & position, Math::Vector3f const & normal, RGBColor & irradiance) const
+		{
+			const size_t index = bucket(cell(position[0]), cell(position[1]), cell(position[2]));
+			RGBColor sum;
+			double weights = 0.0;
+			for (const Entry * entry = m_buckets[index].load(::std::memory_order_acquire); entry != nullptr; entry = entry->next)
+			{
+				const Record & record = *entry->record;
+				Math::Vector3f offset = position - record.position;
+				double distance = offset.norm();
+				if (distance >= m_accuracy*record.radius) { continue; }
+				double error = distance / record.radius + sqrt(::std::max(0.0, 1.0 - normal*record.normal));
+				if (error >= m_accuracy) { continue; }
+				// The point must not be in front of the record (the record does not see the surfaces between them)
+				if (offset*(normal + record.normal)*0.5 < -0.05*record.radius) { continue; }
+				double weight = 1.0 / ::std::max(error, 1e-6) - 1.0 / m_accuracy;
+				sum = sum + record.irradiance*weight;
+				weights += weight;
+			}
+			if (weights <= 0.0) { return false; }
+			irradiance = sum / weights;
+			return true;
+		}
+
+		/// <summary>
+		/// Inserts a record, its radius is clamped to the bounds of the cache. Can be called concurrently
+		/// with lookups and other insertions.
+		/// </summary>
+		void insert(Record record)
+		{
+			record.radius = ::std::min(::std::max(record.radius, m_minRadius), m_maxRadius);
+			const double influence = m_accuracy*record.radius;
+			::std::lock_guard<::std::mutex> lock(m_insertion);
+			m_records.push_back(record);
+			const Record * stored = &m_records.back();
+			// The validity sphere fits in a cell: it overlaps 2x2x2 cells (3x3x3 with rounding errors)
+			size_t buckets[27];
+			size_t count = 0;
+			for (int x = cell(record.position[0] - influence); x <= cell(record.position[0] + influence); ++x)
+			{
+				for (int y = cell(record.position[1] - influence); y <= cell(record.position[1] + influence); ++y)
+				{
+					for (int z = cell(record.position[2] - influence); z <= cell(record.position[2] + influence); ++z)
+					{
+						size_t index = bucket(x, y, z);
+						// A record is referenced once per list
+						if (::std::find(buckets, buckets + count, index) == buckets + count) { buckets[count++] = index; }
+					}
+				}
+			}
+			for (size_t cpt = 0; cpt < count; ++cpt)
+			{
+				Entry entry = { stored, m_buckets[buckets[cpt]].load(::std::memory_order_relaxed) };
+				m_entries.push_back(entry);
+				m_buckets[buckets[cpt]].store(&m_entries.back(), ::std::memory_order_release);
+			}
+			++m_size;
+		}
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -40,17 +40,11 @@ namespace Geometry
 			add(triangles.begin(), triangles.end());
 		}
 		
+		using LightSource::generate;
+
 		// Hrit via SourceLight
-		PointLight generate()
+		PointLight generate(double, double xi1, double xi2)
 		{
-			double inf1 = m_computedIntervals[m_compteurStratif].first.first;
-			double sup1 = m_computedIntervals[m_compteurStratif].first.second;
-			double inf2 = m_computedIntervals[m_compteurStratif].second.first;
-			double sup2 = m_computedIntervals[m_compteurStratif].second.second;
-
-			double xi1 = Math::RandomDirection::random(inf1, sup1);
-			double xi2 = Math::RandomDirection::random(inf2, sup2);
-
 			//xi1 = (inf1 + sup1) / 2.0;
 			//xi2 = (inf2 + sup2) / 2.0;
 
@@ -64,7 +58,6 @@ namespace Geometry
 			
 			PointLight light(pos, m_color);
 			
-			m_compteurStratif = (m_compteurStratif + 1) % m_lightSamples;
 			return light;
 
 		}
@@ -32,17 +32,11 @@ namespace Geometry
 			add(triangles.begin(), triangles.end());
 		}
 
+		using LightSource::generate;
+
 		// Hrit via SourceLight
-		PointLight generate()
+		PointLight generate(double, double xi1, double xi2)
 		{
-			double inf1 = m_computedIntervals[m_compteurStratif].first.first;
-			double sup1 = m_computedIntervals[m_compteurStratif].first.second;
-			double inf2 = m_computedIntervals[m_compteurStratif].second.first;
-			double sup2 = m_computedIntervals[m_compteurStratif].second.second;
-
-			double xi1 = Math::RandomDirection::random(inf1, sup1);
-			double xi2 = Math::RandomDirection::random(inf2, sup2);
-
 			//double xi1 = (inf1 + sup1) / 2.0;
 			//double xi2 = (inf2 + sup2) / 2.0;
 
@@ -56,7 +50,6 @@ namespace Geometry
 			Math::Vector3f pos = A + AB * xi1 + AD * xi2;
 			PointLight light(pos, m_color);
 
-			m_compteurStratif = (m_compteurStratif + 1) % m_lightSamples;
 			return light;
 		}
 	};
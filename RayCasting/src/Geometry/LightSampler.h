@@ -1,33 +1,84 @@
 #ifndef _Geometry_LightSampler_H
 #define _Geometry_LightSampler_H
 
-#include <random>
 #include <Geometry/Triangle.h>
 #include <Geometry/Geometry.h>
+#include <Geometry/BoundingBox.h>
 #include <Geometry/PointLight.h>
+#include <Math/AliasTable.h>
+#include <Math/PixelSampler.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
 
 namespace Geometry
 {
 	/// <summary>
 	/// A light sampler. To initialize this sampler, just add triangles or geometries. The sampler
-	/// will keep triangles with a material that emits light.
+	/// will keep triangles with a material that emits light (the triangles must outlive the sampler).
+	/// A triangle is chosen with an alias table (by area or by emitted power, textures included) in constant time, then a point
+	/// is uniformly sampled on it. Sampling has no internal state, so a sampler can be shared between threads
+	/// once its triangles are added.
 	/// </summary>
 	class LightSampler
 	{
+	public:
+		/// <summary> The probability of choosing a triangle is proportional to its area or to its emitted power. </summary>
+		enum Weighting { Area, Power };
+
+		/// <summary>
+		/// A point sampled on a light.
+		/// </summary>
+		struct Sample
+		{
+			const Triangle * triangle;
+			Math::Vector3f point;
+			/// <summary> The geometric normal of the triangle. </summary>
+			Math::Vector3f normal;
+			/// <summary> The emission at the point (with the texture of the triangle). </summary>
+			RGBColor emission;
+			/// <summary> The area density of the point. </summary>
+			double pdfArea;
+
+			PointLight pointLight() const
+			{
+				return PointLight(point, emission);
+			}
+		};
+
 	protected:
-		/// <summary> A random number generator. </summary>
-		mutable std::mt19937_64 randomGenerator;
-		::std::vector<double> surfaceSum;
-		//::std::vector<Triangle> allTriangles; //Faire vector de const Triangle * 
-		::std::vector<const Triangle * > allTriangles;
-		double currentSum ;
+		Weighting m_weighting;
+		::std::vector<const Triangle*> m_triangles;
+		Math::AliasTable m_table;
+		/// <summary> The index of each triangle in m_triangles. </summary>
+		::std::unordered_map<const Triangle*, size_t> m_index;
+
+		void append(const Triangle & triangle)
+		{
+			if (!triangle.material()->getEmissive().isBlack() && triangle.surface() > 0.0 && m_index.find(&triangle) == m_index.end())
+			{
+				m_index[&triangle] = m_triangles.size();
+				m_triangles.push_back(&triangle);
+			}
+		}
+
+		void build()
+		{
+			::std::vector<double> weights(m_triangles.size());
+			for (size_t cpt = 0; cpt < m_triangles.size(); ++cpt)
+			{
+				weights[cpt] = m_triangles[cpt]->surface();
+				if (m_weighting == Power) { weights[cpt] *= m_triangles[cpt]->averageEmission().grey(); }
+			}
+			m_table.build(weights);
+		}
 
 	public:
 		/// <summary>
 		/// Constructor
 		/// </summary>
-		LightSampler()
-			: currentSum(0.0)
+		LightSampler(Weighting weighting = Area)
+			: m_weighting(weighting)
 		{}
 
 		/// <summary>
@@ -36,12 +87,8 @@ namespace Geometry
 		/// <param name="triangle"></param>
 		void add(const Triangle & triangle)
 		{
-			if (!triangle.material()->getEmissive().isBlack())
-			{
-				currentSum += triangle.surface()/**it->material()->getEmissive().grey()*/;
-				surfaceSum.push_back(currentSum);
-				allTriangles.push_back(&triangle);
-			}
+			append(triangle);
+			build();
 		}
 
 		/// <summary>
@@ -55,64 +102,127 @@ namespace Geometry
 		}
 
 		/// <summary>
-		/// Adds a range of triangles or geometries to the light sampler.
+		/// Adds a range of triangles to the light sampler (the table is built once).
 		/// </summary>
 		template <class iterator>
 		void add(iterator begin, iterator end)
 		{
 			for (iterator it = begin; it != end; ++it)
 			{
-				add(*it);
+				append(*it);
 			}
+			build();
 		}
 
 		/// <summary>
-		/// Genates a point light by sampling the kept triangles.
+		/// Replaces the triangles of the sampler by the emissive triangles of the geometries (the table is built once).
 		/// </summary>
-		/// <returns></returns>
-		std::pair<PointLight, const Triangle * > generate() const
+		void build(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries)
 		{
-			double random = double(randomGenerator()) / double(randomGenerator.max());
-			random = random * currentSum;
-			auto found = std::lower_bound(surfaceSum.begin(), surfaceSum.end(), random);
-			size_t index = found - surfaceSum.begin();
-			Math::Vector3f barycentric = allTriangles[index]->randomBarycentric();
-			Math::Vector3f point = allTriangles[index]->pointFromBraycentric(barycentric);
-			RGBColor color = allTriangles[index]->sampleTexture(barycentric);
-
-			const Triangle * toIgnore = allTriangles[index];
-			PointLight light(point, allTriangles[index]->material()->getEmissive()*color);
-
-			std::pair<PointLight, const Triangle * > res(light, toIgnore);
-			return res;
+			build(geometries, [](size_t) { return true; });
 		}
 
 		/// <summary>
-		/// Generates nb point lights by sampling the kept triangles.
+		/// Replaces the triangles of the sampler by the emissive triangles of the geometries accepted by a filter,
+		/// called with the index of the geometry (the table is built once).
 		/// </summary>
-		template <class iterator>
-		iterator generate(iterator output, size_t nb)
+		template <class Filter>
+		void build(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries, Filter accept)
 		{
-			for (size_t cpt = 0; cpt < nb; ++cpt)
+			m_triangles.clear();
+			m_index.clear();
+			size_t index = 0;
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : geometries)
 			{
-				(*output) = generate();
-				++output;
+				if (accept(index++))
+				{
+					for (const Triangle & triangle : geometry.second.getTriangles())
+					{
+						append(triangle);
+					}
+				}
 			}
-			return output;
+			build();
 		}
 
 		/// <summary>
-		/// Generates end-begin point lights by sampling the kept triangles.
+		/// Removes all the triangles.
 		/// </summary>
-		template <class iterator>
-		iterator generate(iterator begin, iterator end)
+		void clear()
 		{
-			for (; begin != end; ++begin)
-			{
-				(*begin) = generate();
-				++begin;
-			}
-			return begin;
+			m_triangles.clear();
+			m_index.clear();
+			m_table.build(::std::vector<double>());
+		}
+
+		/// <summary>
+		/// Changes the weighting of the triangles.
+		/// </summary>
+		void setWeighting(Weighting weighting)
+		{
+			m_weighting = weighting;
+			build();
+		}
+
+		Weighting weighting() const
+		{
+			return m_weighting;
+		}
+
+		/// <summary>
+		/// Samples a point on the kept triangles from three uniform values in [0;1). The sampler must have lights.
+		/// </summary>
+		/// <param name="choice">Selects the triangle.</param>
+		/// <param name="xi1">First coordinate of the position on the triangle.</param>
+		/// <param name="xi2">Second coordinate of the position on the triangle.</param>
+		Sample sample(double choice, double xi1, double xi2) const
+		{
+			size_t index = m_table.sample(choice);
+			const Triangle * triangle = m_triangles[index];
+			Math::Vector3f barycentric = Triangle::sampleBarycentric(xi1, xi2);
+			Sample result;
+			result.triangle = triangle;
+			result.point = triangle->pointFromBraycentric(barycentric);
+			result.normal = triangle->normal();
+			result.emission = triangle->material()->getEmissive()*triangle->sampleTexture(barycentric);
+			result.pdfArea = m_table.probability(index) / triangle->surface();
+			return result;
+		}
+
+		/// <summary>
+		/// Samples a point using the light dimensions of a pixel sampler at the given bounce.
+		/// </summary>
+		Sample sample(Math::PixelSampler const & sampler, unsigned int bounce) const
+		{
+			::std::pair<double, double> xi = sampler.get2D(bounce, Math::PixelSampler::LightPosition);
+			return sample(sampler.get(bounce, Math::PixelSampler::LightChoice), xi.first, xi.second);
+		}
+
+		/// <summary>
+		/// Returns the area density with which LightSampler::sample generates a point of a triangle, 0 if the
+		/// triangle is not kept by the sampler.
+		/// </summary>
+		double pdfArea(const Triangle * triangle) const
+		{
+			auto found = m_index.find(triangle);
+			if (found == m_index.end()) { return 0.0; }
+			return m_table.probability(found->second) / triangle->surface();
+		}
+
+		/// <summary>
+		/// Returns the number of kept triangles.
+		/// </summary>
+		size_t size() const
+		{
+			return m_triangles.size();
+		}
+
+		/// <summary>
+		/// Returns the memory used by the sampler in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_triangles.capacity()*sizeof(const Triangle*) + m_table.memorySize() + m_index.size()*(sizeof(const Triangle*) + sizeof(size_t) + 2 * sizeof(void*));
 		}
 
 		/// <summary>
@@ -121,9 +231,9 @@ namespace Geometry
 		/// <returns></returns>
 		bool hasLights() const
 		{
-			return allTriangles.size() > 0;
+			return m_triangles.size() > 0;
 		}
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
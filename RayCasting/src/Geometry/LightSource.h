@@ -1,11 +1,13 @@
 #ifndef _Geometry_LightSource_H
 #define _Geometry_LightSource_H
 
-#include <random>
+#include <atomic>
 #include <Geometry/Triangle.h>
 #include <Geometry/Geometry.h>
 #include <Geometry/PointLight.h>
+#include <Geometry/LightSampler.h>
 #include <Math/RandomDirection.h>
+#include <Math/PixelSampler.h>
 
 namespace Geometry
 {
@@ -15,16 +17,13 @@ namespace Geometry
 	class LightSource : public Geometry
 	{
 	protected:
-		/// <summary> A random number generator. </summary>
-		mutable std::mt19937_64 randomGenerator;
-		::std::vector<double> surfaceSum;
-		//::std::vector<Triangle> allTriangles; //Faire vector de const Triangle * 
-		::std::vector<const Triangle * > allTriangles;
-		double currentSum;
+		/// <summary> The emitting triangles of the light. </summary>
+		LightSampler m_emitters;
 		Math::Vector3f m_position;
 		RGBColor m_color;
 		::std::vector< std::pair< std::pair<double, double>, std::pair<double, double> > > m_computedIntervals; //Intervalles pour la stratification
-		int m_compteurStratif;
+		/// <summary> The next stratum of LightSource::generate (shared by the threads). </summary>
+		::std::atomic<unsigned int> m_compteurStratif;
 		int m_lightSamples;
 
 	public:
@@ -32,7 +31,7 @@ namespace Geometry
 		/// Constructor
 		/// </summary>
 		LightSource(Math::Vector3f position, int lightSamples, Material * ematerial)
-			: m_position(position),currentSum(0.0), m_compteurStratif(0), m_lightSamples(lightSamples), Geometry()
+			: m_position(position), m_compteurStratif(0), m_lightSamples(lightSamples), Geometry()
 		{
 			m_color = ematerial->getEmissive();
 			//Creation des intervalles pour la stratification, de la forme paire( paire(a,b) , paire(c,d) ) 
@@ -54,10 +53,41 @@ namespace Geometry
 		
 
 		/// <summary>
-		/// Genates a point light by sampling the kept triangles.
+		/// Generates a point light on the light source from three uniform values in [0;1). This is the
+		/// entry point for (quasi) Monte Carlo samplers.
 		/// </summary>
+		/// <param name="lightChoice">Selects the emitting triangle when the light is made of several ones.</param>
+		/// <param name="xi1">First coordinate of the position on the light.</param>
+		/// <param name="xi2">Second coordinate of the position on the light.</param>
 		/// <returns></returns>
-		virtual PointLight generate() = 0 {}
+		virtual PointLight generate(double lightChoice, double xi1, double xi2) = 0;
+
+		/// <summary>
+		/// Genates a point light using stratified random sampling (one stratum per call, m_lightSamples strata).
+		/// The strata are distributed atomically, so concurrent calls use distinct strata.
+		/// </summary>
+		/// <returns></returns>
+		PointLight generate()
+		{
+			const ::std::pair< std::pair<double, double>, std::pair<double, double> > & stratum = m_computedIntervals[m_compteurStratif++ % m_computedIntervals.size()];
+
+			double xi1 = Math::RandomDirection::random(stratum.first.first, stratum.first.second);
+			double xi2 = Math::RandomDirection::random(stratum.second.first, stratum.second.second);
+
+			return generate(Math::RandomDirection::random(), xi1, xi2);
+		}
+
+		/// <summary>
+		/// Generates a point light using the light dimensions of a pixel sampler at the given bounce.
+		/// </summary>
+		/// <param name="sampler">The pixel sampler.</param>
+		/// <param name="bounce">The bounce index.</param>
+		/// <returns></returns>
+		PointLight generate(Math::PixelSampler const & sampler, unsigned int bounce)
+		{
+			::std::pair<double, double> xi = sampler.get2D(bounce, Math::PixelSampler::LightPosition);
+			return generate(sampler.get(bounce, Math::PixelSampler::LightChoice), xi.first, xi.second);
+		}
 
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	const Math::Vector3 & PointLight::position() const
@@ -80,12 +110,7 @@ namespace Geometry
 		/// <param name="triangle"></param>
 		void add(const Triangle & triangle)
 		{
-			if (!triangle.material()->getEmissive().isBlack())
-			{
-				currentSum += triangle.surface()/**it->material()->getEmissive().grey()*/;
-				surfaceSum.push_back(currentSum);
-				allTriangles.push_back(&triangle);
-			}
+			m_emitters.add(triangle);
 		}
 
 		/// <summary>
@@ -94,8 +119,7 @@ namespace Geometry
 		/// <param name="geometry"></param>
 		void add(const Geometry & geometry)
 		{
-			auto & triangles = geometry.getTriangles();
-			add(triangles.begin(), triangles.end());
+			m_emitters.add(geometry);
 		}
 
 		/// <summary>
@@ -104,10 +128,7 @@ namespace Geometry
 		template <class iterator>
 		void add(iterator begin, iterator end)
 		{
-			for (iterator it = begin; it != end; ++it)
-			{
-				add(*it);
-			}
+			m_emitters.add(begin, end);
 		}
 
 		/// <summary>
@@ -144,7 +165,7 @@ namespace Geometry
 		/// <returns></returns>
 		bool hasLights() const
 		{
-			return allTriangles.size() > 0;
+			return m_emitters.hasLights();
 		}
 	};
 }
@@ -38,17 +38,11 @@ namespace Geometry
 			add(triangles.begin(), triangles.end());
 		}
 
+		using LightSource::generate;
+
 		// Hrit via SourceLight
-		PointLight generate()
+		PointLight generate(double, double xi1, double xi2)
 		{
-			double inf1 = m_computedIntervals[m_compteurStratif].first.first;
-			double sup1 = m_computedIntervals[m_compteurStratif].first.second;
-			double inf2 = m_computedIntervals[m_compteurStratif].second.first;
-			double sup2 = m_computedIntervals[m_compteurStratif].second.second;
-
-			double xi1 = Math::RandomDirection::random(inf1, sup1);
-			double xi2 = Math::RandomDirection::random(inf2, sup2);
-
 			double theta = acos(sqrt(xi1));
 			double phi = 2 * M_PI * xi2;
 
@@ -60,7 +54,6 @@ namespace Geometry
 
 			PointLight light(pos, m_color);
 
-			m_compteurStratif = (m_compteurStratif + 1) % m_lightSamples;
 			return light;
 
 		}
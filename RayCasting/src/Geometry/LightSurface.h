@@ -28,21 +28,12 @@ namespace Geometry
 			add(triangles.begin(), triangles.end());
 		}
 
+		using LightSource::generate;
+
 		// Hérité via SourceLight
-		PointLight generate()
+		PointLight generate(double lightChoice, double xi1, double xi2)
 		{
-			double random = double(randomGenerator()) / double(randomGenerator.max());
-			random = random * currentSum;
-			auto found = std::lower_bound(surfaceSum.begin(), surfaceSum.end(), random);
-			size_t index = found - surfaceSum.begin();
-			Math::Vector3f barycentric = allTriangles[index]->randomBarycentric();
-			Math::Vector3f point = allTriangles[index]->pointFromBraycentric(barycentric);
-			RGBColor color = allTriangles[index]->sampleTexture(barycentric);
-
-			PointLight light(point, allTriangles[index]->material()->getEmissive()*color);
-
-			m_compteurStratif = (m_compteurStratif + 1) % m_lightSamples;
-			return light;
+			return m_emitters.sample(lightChoice, xi1, xi2).pointLight();
 		}
 	};
 }
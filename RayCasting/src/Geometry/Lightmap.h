@@ -0,0 +1,351 @@
+#ifndef _Geometry_Lightmap_H
+#define _Geometry_Lightmap_H
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Triangle.h>
+#include <Geometry/BoundingBox.h>
+#include <Geometry/RGBColor.h>
+#include <System/Fingerprint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The diffuse irradiance (direct and indirect) of the static triangles of a scene, baked once and looked up by
+	/// the renderings from any viewpoint (see Scene::bakeLightmap). Each triangle owns a lattice of resolution r in
+	/// its (u,v) coordinates: the points (i/r, j/r) for i+j from 0 to r, with one irradiance per side of the triangle.
+	/// A lookup interpolates the three lattice points of the sub triangle containing (u,v). The resolution of a
+	/// triangle follows the length of its longest edge, triangles without diffuse reflectance have no lattice.
+	/// Triangles are identified by their order in the scene, so a saved lightmap can be loaded with the same scene
+	/// (the file stores a fingerprint of the vertices and of the material of each triangle to check it).
+	/// </summary>
+	class Lightmap
+	{
+	public:
+		/// <summary> The side of a triangle: the side of its geometric normal or the opposite one. </summary>
+		enum Side { Front = 0, Back = 1 };
+
+	protected:
+		/// <summary> The header of the file ("LMAP") and the version of the format. </summary>
+		enum : ::std::uint32_t { Magic = 0x50414D4Cu, Version = 2 };
+
+		/// <summary>
+		/// The lattice of a triangle.
+		/// </summary>
+		struct Chart
+		{
+			::std::int32_t resolution;
+			/// <summary> The index of the first RGB value of the front side (the back side follows). </summary>
+			size_t offset;
+		};
+
+		double m_texelSize;
+		::std::vector<const Triangle*> m_triangles;
+		::std::vector<Chart> m_charts;
+		::std::unordered_map<const Triangle*, size_t> m_index;
+		/// <summary> The RGB irradiances of the lattice points. </summary>
+		::std::vector<float> m_values;
+
+		static const int maxResolution = 64;
+
+		template <class T>
+		static void write(::std::ostream & out, const T & value)
+		{
+			out.write((const char*)&value, sizeof(T));
+		}
+
+		template <class T>
+		static bool read(::std::istream & in, T & value)
+		{
+			return (bool)in.read((char*)&value, sizeof(T));
+		}
+
+		/// <summary>
+		/// The number of points of a lattice of resolution r.
+		/// </summary>
+		static size_t pointCount(int resolution)
+		{
+			return (resolution > 0) ? (size_t)(resolution + 1)*(resolution + 2) / 2 : 0;
+		}
+
+		/// <summary>
+		/// The index of the point (i,j) in a lattice of resolution r (row i has r+1-i points).
+		/// </summary>
+		static size_t pointIndex(int resolution, int i, int j)
+		{
+			return (size_t)i*(resolution + 1) - (size_t)i*(i - 1) / 2 + j;
+		}
+
+		/// <summary>
+		/// Lists the triangles of the geometries and indexes them.
+		/// </summary>
+		void collect(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries)
+		{
+			m_triangles.clear();
+			m_index.clear();
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : geometries)
+			{
+				for (const Triangle & triangle : geometry.second.getTriangles())
+				{
+					m_index[&triangle] = m_triangles.size();
+					m_triangles.push_back(&triangle);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Computes the offsets of the charts from their resolutions and allocates the values.
+		/// </summary>
+		void allocate()
+		{
+			size_t offset = 0;
+			for (Chart & chart : m_charts)
+			{
+				chart.offset = offset;
+				offset += 2 * 3 * pointCount(chart.resolution);
+			}
+			m_values.assign(offset, 0.0f);
+		}
+
+		/// <summary>
+		/// The fingerprint of a triangle: its vertices and the reflectances of its material.
+		/// </summary>
+		static ::std::uint64_t fingerprint(const Triangle & triangle)
+		{
+			System::Fingerprint fingerprint;
+			for (int v = 0; v < 3; ++v)
+			{
+				fingerprint.add(triangle.vertex(v)[0]).add(triangle.vertex(v)[1]).add(triangle.vertex(v)[2]);
+			}
+			const Material & material = *triangle.material();
+			for (int c = 0; c < 3; ++c)
+			{
+				fingerprint.add(material.getDiffuse()[c]).add(material.getSpecular()[c]).add(material.getEmissive()[c]);
+			}
+			return fingerprint.add(material.getShininess()).value();
+		}
+
+		RGBColor value(const Chart & chart, Side side, int i, int j) const
+		{
+			const float * rgb = &m_values[chart.offset + 3 * (side*pointCount(chart.resolution) + pointIndex(chart.resolution, i, j))];
+			return RGBColor(rgb[0], rgb[1], rgb[2]);
+		}
+
+	public:
+		Lightmap()
+			: m_texelSize(1.0)
+		{}
+
+		/// <summary>
+		/// Allocates the lattices of the triangles of the geometries (the triangles must outlive the lightmap).
+		/// The irradiances are null until they are set.
+		/// </summary>
+		/// <param name="texelSize">The distance between two lattice points along the longest edge of the triangles.</param>
+		void build(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries, double texelSize)
+		{
+			m_texelSize = texelSize;
+			collect(geometries);
+			m_charts.resize(m_triangles.size());
+			for (size_t cpt = 0; cpt < m_triangles.size(); ++cpt)
+			{
+				const Triangle & triangle = *m_triangles[cpt];
+				double edge = ::std::max((triangle.vertex(1) - triangle.vertex(0)).norm(), ::std::max((triangle.vertex(2) - triangle.vertex(1)).norm(), (triangle.vertex(0) - triangle.vertex(2)).norm()));
+				int resolution = ::std::min(maxResolution, ::std::max(1, (int)ceil(edge / texelSize)));
+				m_charts[cpt].resolution = triangle.material()->getDiffuse().isBlack() ? 0 : resolution;
+			}
+			allocate();
+		}
+
+		void clear()
+		{
+			m_triangles.clear();
+			m_charts.clear();
+			m_index.clear();
+			m_values.clear();
+		}
+
+		bool empty() const
+		{
+			return m_triangles.empty();
+		}
+
+		double texelSize() const
+		{
+			return m_texelSize;
+		}
+
+		/// <summary>
+		/// Returns the number of triangles.
+		/// </summary>
+		size_t size() const
+		{
+			return m_triangles.size();
+		}
+
+		const Triangle * triangle(size_t index) const
+		{
+			return m_triangles[index];
+		}
+
+		/// <summary>
+		/// Returns the resolution of the lattice of a triangle (0 if it has no lattice).
+		/// </summary>
+		int resolution(size_t index) const
+		{
+			return m_charts[index].resolution;
+		}
+
+		/// <summary>
+		/// Returns the number of lattice points of the lightmap (per side).
+		/// </summary>
+		size_t texelCount() const
+		{
+			return m_values.size() / 6;
+		}
+
+		/// <summary>
+		/// Returns the memory used by the lightmap in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_values.capacity()*sizeof(float) + m_charts.capacity()*sizeof(Chart) + m_triangles.capacity()*sizeof(const Triangle*)
+				+ m_index.size()*(sizeof(const Triangle*) + sizeof(size_t) + 2 * sizeof(void*));
+		}
+
+		/// <summary>
+		/// Sets the irradiance of the point (i,j) of the lattice of a triangle. Distinct points can be set concurrently.
+		/// </summary>
+		void set(size_t index, Side side, int i, int j, RGBColor const & irradiance)
+		{
+			const Chart & chart = m_charts[index];
+			float * rgb = &m_values[chart.offset + 3 * (side*pointCount(chart.resolution) + pointIndex(chart.resolution, i, j))];
+			for (int c = 0; c < 3; ++c) { rgb[c] = (float)irradiance[c]; }
+		}
+
+		/// <summary>
+		/// Interpolates the irradiance of a side of a triangle at the coordinates (u,v) of an intersection.
+		/// </summary>
+		/// <returns>false if the triangle has no lattice.</returns>
+		bool lookup(const Triangle * triangle, double u, double v, Side side, RGBColor & irradiance) const
+		{
+			auto found = m_index.find(triangle);
+			if (found == m_index.end()) { return false; }
+			const Chart & chart = m_charts[found->second];
+			const int r = chart.resolution;
+			if (r == 0) { return false; }
+			double s = ::std::min(::std::max(u, 0.0), 1.0)*r;
+			double t = ::std::min(::std::max(v, 0.0), 1.0)*r;
+			int i = ::std::min((int)s, r - 1);
+			int j = ::std::min((int)t, r - 1 - i);
+			double fs = s - i;
+			double ft = t - j;
+			// The sub triangles along the hypotenuse have no upper half (u+v may exceed 1 by rounding errors)
+			if (fs + ft <= 1.0 || i + j == r - 1)
+			{
+				irradiance = value(chart, side, i, j)*(1.0 - fs - ft) + value(chart, side, i + 1, j)*fs + value(chart, side, i, j + 1)*ft;
+			}
+			else
+			{
+				irradiance = value(chart, side, i + 1, j + 1)*(fs + ft - 1.0) + value(chart, side, i, j + 1)*(1.0 - fs) + value(chart, side, i + 1, j)*(1.0 - ft);
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Saves the lightmap.
+		/// </summary>
+		/// <returns>true if the file has been written.</returns>
+		bool save(const ::std::string & filename) const
+		{
+			::std::ofstream out(filename.c_str(), ::std::ios::binary);
+			if (!out)
+			{
+				::std::cerr << "Lightmap: unable to write " << filename << ::std::endl;
+				return false;
+			}
+			write(out, (::std::uint32_t)Magic);
+			write(out, (::std::uint32_t)Version);
+			write(out, m_texelSize);
+			write(out, (::std::uint64_t)m_charts.size());
+			for (size_t cpt = 0; cpt < m_charts.size(); ++cpt)
+			{
+				write(out, m_charts[cpt].resolution);
+				write(out, fingerprint(*m_triangles[cpt]));
+			}
+			out.write((const char*)m_values.data(), m_values.size()*sizeof(float));
+			if (!out)
+			{
+				::std::cerr << "Lightmap: error while writing " << filename << ::std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Loads a lightmap saved with the same geometries (the triangles must outlive the lightmap).
+		/// </summary>
+		/// <returns>false if the file is missing, invalid or does not match the geometries.</returns>
+		bool load(const ::std::string & filename, const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries)
+		{
+			::std::ifstream in(filename.c_str(), ::std::ios::binary);
+			if (!in)
+			{
+				::std::cerr << "Lightmap: unable to read " << filename << ::std::endl;
+				return false;
+			}
+			::std::uint32_t magic, version;
+			::std::uint64_t count;
+			double texelSize;
+			if (!read(in, magic) || !read(in, version) || magic != Magic || version != Version || !read(in, texelSize) || !read(in, count))
+			{
+				::std::cerr << "Lightmap: " << filename << " is not a lightmap" << ::std::endl;
+				return false;
+			}
+			collect(geometries);
+			if (count != m_triangles.size())
+			{
+				::std::cerr << "Lightmap: " << filename << " has " << count << " triangles, the scene has " << m_triangles.size() << ::std::endl;
+				clear();
+				return false;
+			}
+			m_texelSize = texelSize;
+			m_charts.resize(m_triangles.size());
+			for (size_t cpt = 0; cpt < m_charts.size(); ++cpt)
+			{
+				Chart & chart = m_charts[cpt];
+				::std::uint64_t triangle;
+				if (!read(in, chart.resolution) || !read(in, triangle) || chart.resolution < 0 || chart.resolution > maxResolution)
+				{
+					::std::cerr << "Lightmap: " << filename << " is corrupted" << ::std::endl;
+					clear();
+					return false;
+				}
+				if (triangle != fingerprint(*m_triangles[cpt]))
+				{
+					::std::cerr << "Lightmap: " << filename << " has been baked for another scene (triangle " << cpt << " differs)" << ::std::endl;
+					clear();
+					return false;
+				}
+			}
+			allocate();
+			if (!in.read((char*)m_values.data(), m_values.size()*sizeof(float)))
+			{
+				::std::cerr << "Lightmap: " << filename << " is truncated" << ::std::endl;
+				clear();
+				return false;
+			}
+			return true;
+		}
+	};
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <Geometry/RGBColor.h>
 #include <Geometry/Texture.h>
+#include <System/Trace.h>
 
 namespace Geometry
 {
@@ -126,6 +127,7 @@ namespace Geometry
 		/// <param name="textureFile">The texture file.</param>
 		void setTextureFile(const ::std::string & textureFile)
 		{
+			TraceScope("setTextureFile", "load", textureFile.c_str());
 			m_textureFile = textureFile;
 			::std::cout << "Loading texture: "<< m_textureFile << "..." << ::std::flush;
 			m_texture = new Texture(m_textureFile);
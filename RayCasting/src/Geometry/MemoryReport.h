@@ -0,0 +1,104 @@
+#ifndef _Geometry_MemoryReport_H
+#define _Geometry_MemoryReport_H
+
+#include <Geometry/Triangle.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The memory used by a scene, in bytes (see Scene::memoryReport). Containers are measured by the size of
+	/// their elements, the allocator overhead (e.g. the blocks of the deques) is not included.
+	/// </summary>
+	class MemoryReport
+	{
+	public:
+		/// <summary> The vertices, texture coordinates and triangles of the meshes. </summary>
+		size_t vertices = 0;
+		size_t textureCoordinates = 0;
+		size_t triangles = 0;
+		/// <summary> The rest pose of the animated meshes. </summary>
+		size_t restVertices = 0;
+		/// <summary> The BVH nodes and the triangle pointers of their lists. </summary>
+		size_t bvhNodes = 0;
+		size_t bvhPrimitives = 0;
+		/// <summary> The hierarchy of the emissive triangles. </summary>
+		size_t lights = 0;
+		/// <summary> The records of the irradiance cache and its grid. </summary>
+		size_t irradianceCache = 0;
+		/// <summary> The lattices of the baked lightmap. </summary>
+		size_t lightmap = 0;
+		/// <summary> The kd-trees of the photon maps. </summary>
+		size_t photonMaps = 0;
+		/// <summary> The spatial and directional trees of the path guiding. </summary>
+		size_t pathGuiding = 0;
+		/// <summary> The patches and the links of the radiosity solution. </summary>
+		size_t radiosity = 0;
+		/// <summary> The materials and the pixel data of their textures. </summary>
+		size_t materials = 0;
+		size_t textures = 0;
+		/// <summary> The accumulation, auxiliary and denoised buffers. </summary>
+		size_t framebuffers = 0;
+
+		size_t triangleCount = 0;
+		size_t bvhNodeCount = 0;
+		size_t bvhLeafCount = 0;
+		size_t materialCount = 0;
+		size_t textureCount = 0;
+		size_t emissiveTriangleCount = 0;
+		size_t irradianceRecordCount = 0;
+		size_t lightmapTexelCount = 0;
+		size_t photonCount = 0;
+		size_t guidingCells = 0;
+		size_t radiosityPatches = 0;
+		size_t radiosityLinks = 0;
+
+		size_t geometry() const
+		{ return vertices + textureCoordinates + triangles + restVertices; }
+
+		size_t bvh() const
+		{ return bvhNodes + bvhPrimitives; }
+
+		size_t total() const
+		{ return geometry() + bvh() + lights + irradianceCache + lightmap + photonMaps + pathGuiding + radiosity + materials + textures + framebuffers; }
+
+		void print(::std::ostream & out) const
+		{
+			const double perTriangle = (triangleCount > 0) ? 1.0 / triangleCount : 0.0;
+			out << "Memory: vertices " << format(vertices) << ", texture coordinates " << format(textureCoordinates) << ", triangles " << format(triangles);
+			if (restVertices > 0) { out << ", rest poses " << format(restVertices); }
+			out << ::std::endl;
+			out << "Memory: Triangle " << sizeof(Triangle) << " bytes (vertex normals " << 3 * sizeof(Math::Vector3f) << ", cached vertex, axes and normal " << 4 * sizeof(Math::Vector3f)
+				<< ", vertex and texture coordinate pointers " << 6 * sizeof(void*) << ", material " << sizeof(Material*) << ")" << ::std::endl;
+			out << "Memory: BVH " << format(bvh()) << " (" << bvhNodeCount << " nodes, " << bvhLeafCount << " leaves, nodes " << format(bvhNodes) << ", triangle lists " << format(bvhPrimitives) << ")" << ::std::endl;
+			if (emissiveTriangleCount > 0) { out << "Memory: light BVH " << format(lights) << " (" << emissiveTriangleCount << " emissive triangles)" << ::std::endl; }
+			if (irradianceRecordCount > 0) { out << "Memory: irradiance cache " << format(irradianceCache) << " (" << irradianceRecordCount << " records)" << ::std::endl; }
+			if (lightmapTexelCount > 0) { out << "Memory: lightmap " << format(lightmap) << " (" << lightmapTexelCount << " texels)" << ::std::endl; }
+			if (photonCount > 0) { out << "Memory: photon maps " << format(photonMaps) << " (" << photonCount << " photons)" << ::std::endl; }
+			if (radiosityPatches > 0) { out << "Memory: radiosity " << format(radiosity) << " (" << radiosityPatches << " patches, " << radiosityLinks << " links)" << ::std::endl; }
+			if (guidingCells > 0) { out << "Memory: path guiding " << format(pathGuiding) << " (" << guidingCells << " cells)" << ::std::endl; }
+			out << "Memory: " << materialCount << " materials " << format(materials) << ", " << textureCount << " textures " << format(textures) << ", framebuffers " << format(framebuffers) << ::std::endl;
+			out << "Memory: total " << format(total()) << ", " << (size_t)(total()*perTriangle) << " bytes/triangle (geometry " << (size_t)(geometry()*perTriangle) << ", BVH " << (size_t)(bvh()*perTriangle) << ")" << ::std::endl;
+		}
+
+	protected:
+		/// <summary>
+		/// Formats a size with a readable unit.
+		/// </summary>
+		static ::std::string format(size_t bytes)
+		{
+			static const char * units[] = { "B", "KB", "MB", "GB" };
+			double value = (double)bytes;
+			int unit = 0;
+			while (value >= 1024.0 && unit < 3) { value /= 1024.0; ++unit; }
+			::std::ostringstream result;
+			result << ::std::fixed << ::std::setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+			return result.str();
+		}
+	};
+}
+
+#endif
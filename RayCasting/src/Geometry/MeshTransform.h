@@ -0,0 +1,66 @@
+#ifndef _Geometry_MeshTransform_H
+#define _Geometry_MeshTransform_H
+
+#include <Math/Vectorf.h>
+#include <Math/Quaternion.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// A rigid transform with a uniform scale applied to the rest pose of a mesh: p' = rotation(scale*p) + translation.
+	/// </summary>
+	class MeshTransform
+	{
+	public:
+		Math::Vector3f translation;
+		/// <summary> A unit rotation quaternion. </summary>
+		Math::Quaternion<double> rotation;
+		double scale;
+
+		/// <summary>
+		/// Initializes the identity.
+		/// </summary>
+		MeshTransform()
+			: translation(Math::makeVector(0.0, 0.0, 0.0)), rotation(1.0, Math::makeVector(0.0, 0.0, 0.0)), scale(1.0)
+		{}
+
+		MeshTransform(Math::Vector3f const & translation, Math::Quaternion<double> const & rotation, double scale = 1.0)
+			: translation(translation), rotation(rotation), scale(scale)
+		{}
+
+		/// <summary>
+		/// Transforms a point.
+		/// </summary>
+		Math::Vector3f apply(Math::Vector3f const & point) const
+		{
+			Math::Quaternion<double> q = rotation;
+			return q.rotate(point*scale) + translation;
+		}
+
+		bool operator== (MeshTransform const & other) const
+		{
+			return translation == other.translation && rotation.s() == other.rotation.s() && rotation.v() == other.rotation.v() && scale == other.scale;
+		}
+
+		bool operator!= (MeshTransform const & other) const
+		{
+			return !((*this) == other);
+		}
+
+		/// <summary>
+		/// Interpolates two transforms: linear interpolation of the translation and the scale, normalized
+		/// linear interpolation (along the shortest arc) of the rotation.
+		/// </summary>
+		/// <param name="t">The interpolation parameter in [0;1].</param>
+		static MeshTransform interpolate(MeshTransform const & a, MeshTransform const & b, double t)
+		{
+			Math::Quaternion<double> qb = b.rotation;
+			if (a.rotation.s()*qb.s() + a.rotation.v()*qb.v() < 0.0) { qb = -qb; }
+			Math::Quaternion<double> rotation = a.rotation*(1.0 - t) + qb*t;
+			rotation.normalize();
+			return MeshTransform(a.translation*(1.0 - t) + b.translation*t, rotation, a.scale*(1.0 - t) + b.scale*t);
+		}
+	};
+}
+
+#endif
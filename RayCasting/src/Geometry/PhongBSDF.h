@@ -0,0 +1,171 @@
+#ifndef _Geometry_PhongBSDF_H
+#define _Geometry_PhongBSDF_H
+
+#include <Geometry/RGBColor.h>
+#include <Geometry/Material.h>
+#include <Geometry/Triangle.h>
+#include <Math/Vectorf.h>
+#include <Math/RandomDirection.h>
+#include <Math/Constant.h>
+#include <algorithm>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The modified Phong BSDF of a surface point: a lambertian lobe kd/pi plus a normalized glossy lobe
+	/// ks*(n+2)/(2pi)*cos^n around the mirror direction. The reflectances are scaled down so that kd+ks
+	/// does not exceed 1 (energy conservation). Directions are sampled by choosing a lobe with a
+	/// probability proportional to its reflectance, then a cosine (diffuse) or cos^n (glossy) direction.
+	/// </summary>
+	class PhongBSDF
+	{
+	protected:
+		Math::Vector3f m_normal;
+		/// <summary> The mirror direction of the incident ray. </summary>
+		Math::Vector3f m_mirror;
+		RGBColor m_diffuse;
+		RGBColor m_specular;
+		double m_shininess;
+		/// <summary> The probability of sampling the diffuse lobe. </summary>
+		double m_diffuseProbability;
+
+	public:
+		/// <summary>
+		/// Initializes the BSDF of a surface point.
+		/// </summary>
+		/// <param name="material">The material of the surface.</param>
+		/// <param name="texture">The texture color at the point (multiplies the diffuse reflectance).</param>
+		/// <param name="normal">The shading normal, on the side of the incident ray.</param>
+		/// <param name="incident">The direction of the incident ray.</param>
+		PhongBSDF(const Material & material, RGBColor const & texture, Math::Vector3f const & normal, Math::Vector3f const & incident)
+			: m_normal(normal.normalized()), m_diffuse(material.getDiffuse()*texture), m_specular(material.getSpecular()), m_shininess(material.getShininess())
+		{
+			m_mirror = Triangle::reflectionDirection(m_normal, incident.normalized()).normalized();
+			double total = 0.0;
+			for (int c = 0; c < 3; ++c) { total = ::std::max(total, m_diffuse[c] + m_specular[c]); }
+			if (total > 1.0)
+			{
+				m_diffuse = m_diffuse / total;
+				m_specular = m_specular / total;
+			}
+			double diffuse = m_diffuse.grey();
+			double specular = m_specular.grey();
+			m_diffuseProbability = (diffuse + specular > 0.0) ? diffuse / (diffuse + specular) : 0.0;
+		}
+
+		const Math::Vector3f & normal() const
+		{
+			return m_normal;
+		}
+
+		/// <summary>
+		/// The reflectance of the lambertian lobe (with texture, after energy conservation).
+		/// </summary>
+		const RGBColor & diffuse() const
+		{
+			return m_diffuse;
+		}
+
+		/// <summary>
+		/// The reflectance of the glossy lobe (after energy conservation).
+		/// </summary>
+		const RGBColor & specular() const
+		{
+			return m_specular;
+		}
+
+		/// <summary>
+		/// Returns true if the surface does not reflect any light.
+		/// </summary>
+		bool isBlack() const
+		{
+			return m_diffuse.isBlack() && m_specular.isBlack();
+		}
+
+		/// <summary>
+		/// Evaluates the BSDF for an outgoing direction (normalized).
+		/// </summary>
+		RGBColor eval(Math::Vector3f const & direction) const
+		{
+			if (m_normal*direction <= 0.0) { return RGBColor(); }
+			RGBColor result = m_diffuse * (1.0 / Math::pi);
+			double cosine = m_mirror*direction;
+			if (cosine > 0.0 && !m_specular.isBlack())
+			{
+				result = result + m_specular * ((m_shininess + 2.0) / (2.0*Math::pi) * pow(cosine, m_shininess));
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the solid angle density of PhongBSDF::sample for an outgoing direction (normalized).
+		/// </summary>
+		double pdf(Math::Vector3f const & direction) const
+		{
+			double cosine = m_normal*direction;
+			if (cosine <= 0.0) { return 0.0; }
+			double result = m_diffuseProbability * cosine / Math::pi;
+			double mirrorCosine = m_mirror*direction;
+			if (mirrorCosine > 0.0 && m_diffuseProbability < 1.0)
+			{
+				result += (1.0 - m_diffuseProbability) * (m_shininess + 1.0) / (2.0*Math::pi) * pow(mirrorCosine, m_shininess);
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Samples an outgoing direction from two uniform values (the first one also selects the lobe).
+		/// </summary>
+		/// <param name="direction">Receives the direction.</param>
+		/// <param name="weight">Receives BSDF*cos/pdf.</param>
+		/// <param name="density">Receives the solid angle density of the direction.</param>
+		/// <returns>false if the sampled direction is below the surface.</returns>
+		bool sample(double xi1, double xi2, Math::Vector3f & direction, RGBColor & weight, double & density) const
+		{
+			if (isBlack()) { return false; }
+			if (xi1 < m_diffuseProbability)
+			{
+				direction = Math::RandomDirection(m_normal).generate(xi1 / m_diffuseProbability, xi2);
+			}
+			else
+			{
+				direction = Math::RandomDirection(m_mirror, m_shininess).generate((xi1 - m_diffuseProbability) / (1.0 - m_diffuseProbability), xi2);
+			}
+			direction = direction.normalized();
+			double cosine = m_normal*direction;
+			density = pdf(direction);
+			if (cosine <= 0.0 || density <= 0.0) { return false; }
+			weight = eval(direction) * (cosine / density);
+			return true;
+		}
+
+		/// <summary>
+		/// Samples an outgoing direction in the glossy lobe only (cos^n around the mirror direction).
+		/// </summary>
+		/// <param name="direction">Receives the direction.</param>
+		/// <param name="weight">Receives the glossy BSDF*cos/pdf.</param>
+		/// <returns>false if the surface is not glossy or if the sampled direction is below the surface.</returns>
+		bool sampleSpecular(double xi1, double xi2, Math::Vector3f & direction, RGBColor & weight) const
+		{
+			if (m_specular.isBlack()) { return false; }
+			direction = Math::RandomDirection(m_mirror, m_shininess).generate(xi1, xi2).normalized();
+			double cosine = m_normal*direction;
+			if (cosine <= 0.0) { return false; }
+			weight = m_specular * ((m_shininess + 2.0) / (m_shininess + 1.0) * cosine);
+			return true;
+		}
+
+		/// <summary>
+		/// The power heuristic (beta = 2) weight of a strategy of density pdf combined with a strategy of density other.
+		/// </summary>
+		static double powerHeuristic(double pdf, double other)
+		{
+			double a = pdf*pdf;
+			double b = other*other;
+			return (a + b > 0.0) ? a / (a + b) : 0.0;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef _Geometry_PhotonMap_H
+#define _Geometry_PhotonMap_H
+
+#include <Geometry/RGBColor.h>
+#include <Math/Vectorf.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// A photon stored on a surface: its position, its power (flux) and its direction of travel.
+	/// </summary>
+	class Photon
+	{
+	public:
+		enum Flags : ::std::uint8_t
+		{
+			/// <summary> The splitting axis of the node in the kd-tree (two bits). </summary>
+			AxisMask = 3,
+			/// <summary> The path of the photon has been diffusely reflected at least once. </summary>
+			Diffuse = 4
+		};
+
+		float position[3];
+		float power[3];
+		/// <summary> The direction of travel, quantized on 8 bits per coordinate. </summary>
+		::std::int8_t direction[3];
+		::std::uint8_t flags;
+
+		Photon()
+		{}
+
+		Photon(Math::Vector3f const & position, RGBColor const & power, Math::Vector3f const & direction, bool diffuse)
+			: flags(diffuse ? Diffuse : 0)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				this->position[c] = (float)position[c];
+				this->power[c] = (float)power[c];
+				this->direction[c] = (::std::int8_t)floor(::std::min(1.0, ::std::max(-1.0, direction[c]))*127.0 + 0.5);
+			}
+		}
+
+		Math::Vector3f getPosition() const
+		{
+			return Math::makeVector((double)position[0], (double)position[1], (double)position[2]);
+		}
+
+		RGBColor getPower() const
+		{
+			return RGBColor(power[0], power[1], power[2]);
+		}
+
+		/// <summary>
+		/// Returns the direction of travel (normalized).
+		/// </summary>
+		Math::Vector3f getDirection() const
+		{
+			return Math::makeVector((double)direction[0], (double)direction[1], (double)direction[2]).normalized();
+		}
+
+		bool diffuse() const
+		{
+			return (flags & Diffuse) != 0;
+		}
+
+		int axis() const
+		{
+			return flags & AxisMask;
+		}
+	};
+
+	/// <summary>
+	/// A photon map (Jensen 96): the photons are stored in a balanced kd-tree laid out as a left balanced implicit
+	/// binary tree (the children of node i are the nodes 2i+1 and 2i+2), so the tree needs no pointer and its top
+	/// levels are contiguous in memory. The k nearest photons of a point are found by a depth first search keeping
+	/// the candidates in a max heap, the search radius shrinks to the distance of the farthest candidate once k
+	/// photons are found. The distances are measured in a sphere flattened along the normal of the point (a disc),
+	/// so the photons of nearby surfaces (corners) are ignored. The map is immutable once built, so it can be
+	/// queried concurrently.
+	/// </summary>
+	class PhotonMap
+	{
+	public:
+		/// <summary> The maximum number of photons of a query. </summary>
+		static const size_t maxGather = 256;
+
+		/// <summary> A photon found by PhotonMap::nearest and its squared distance. </summary>
+		typedef ::std::pair<double, const Photon*> Neighbour;
+
+	protected:
+		::std::vector<Photon> m_photons;
+
+		/// <summary> The flattening of the search sphere: the distance along the normal counts that many times more. </summary>
+		static double flattening()
+		{
+			return 16.0;
+		}
+
+		/// <summary>
+		/// The number of nodes of the left subtree of a left balanced tree of n nodes.
+		/// </summary>
+		static size_t leftSize(size_t n)
+		{
+			// The complete levels hold 2^h-1 nodes, the last one the remaining ones from the left
+			size_t full = 1;
+			while (2 * full + 1 <= n) { full = 2 * full + 1; }
+			const size_t half = (full + 1) / 2;
+			return (half - 1) + ::std::min(n - full, half);
+		}
+
+		/// <summary>
+		/// Places the photons [begin;end) in the subtree of node index.
+		/// </summary>
+		void balance(::std::vector<Photon> & photons, size_t begin, size_t end, size_t index)
+		{
+			if (begin >= end) { return; }
+			// Splits along the largest extent of the photons
+			float lower[3], upper[3];
+			for (int c = 0; c < 3; ++c) { lower[c] = upper[c] = photons[begin].position[c]; }
+			for (size_t cpt = begin + 1; cpt < end; ++cpt)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					lower[c] = ::std::min(lower[c], photons[cpt].position[c]);
+					upper[c] = ::std::max(upper[c], photons[cpt].position[c]);
+				}
+			}
+			int axis = (upper[1] - lower[1] > upper[0] - lower[0]) ? 1 : 0;
+			if (upper[2] - lower[2] > upper[axis] - lower[axis]) { axis = 2; }
+			const size_t median = begin + leftSize(end - begin);
+			::std::nth_element(photons.begin() + begin, photons.begin() + median, photons.begin() + end, [axis](const Photon & a, const Photon & b) {
+				return a.position[axis] < b.position[axis];
+			});
+			m_photons[index] = photons[median];
+			m_photons[index].flags = (::std::uint8_t)((m_photons[index].flags & ~Photon::AxisMask) | axis);
+			balance(photons, begin, median, 2 * index + 1);
+			balance(photons, median + 1, end, 2 * index + 2);
+		}
+
+		/// <summary>
+		/// The state of a k nearest search.
+		/// </summary>
+		struct Search
+		{
+			double position[3];
+			Math::Vector3f normal;
+			double radius2;
+			size_t count;
+			size_t found;
+			Neighbour * heap;
+		};
+
+		void locate(Search & search, size_t index) const
+		{
+			const Photon & photon = m_photons[index];
+			const size_t left = 2 * index + 1;
+			if (left < m_photons.size())
+			{
+				const int axis = photon.axis();
+				const double delta = search.position[axis] - photon.position[axis];
+				// The side of the point first, the other side if the splitting plane is closer than the radius
+				const size_t first = (delta < 0.0) ? left : left + 1;
+				const size_t second = (delta < 0.0) ? left + 1 : left;
+				if (first < m_photons.size()) { locate(search, first); }
+				if (second < m_photons.size() && delta*delta < search.radius2) { locate(search, second); }
+			}
+			Math::Vector3f offset = Math::makeVector(photon.position[0] - search.position[0], photon.position[1] - search.position[1], photon.position[2] - search.position[2]);
+			const double along = offset*search.normal;
+			const double distance2 = offset.norm2() + (flattening() - 1.0)*along*along;
+			if (distance2 >= search.radius2) { return; }
+			if (search.found < search.count)
+			{
+				search.heap[search.found++] = Neighbour(distance2, &photon);
+				::std::push_heap(search.heap, search.heap + search.found);
+				if (search.found == search.count) { search.radius2 = search.heap[0].first; }
+			}
+			else
+			{
+				::std::pop_heap(search.heap, search.heap + search.found);
+				search.heap[search.found - 1] = Neighbour(distance2, &photon);
+				::std::push_heap(search.heap, search.heap + search.found);
+				search.radius2 = search.heap[0].first;
+			}
+		}
+
+	public:
+		/// <summary>
+		/// Builds the kd-tree of the photons (the photons are reordered).
+		/// </summary>
+		void build(::std::vector<Photon> & photons)
+		{
+			m_photons.assign(photons.size(), Photon());
+			m_photons.shrink_to_fit();
+			balance(photons, 0, photons.size(), 0);
+		}
+
+		void clear()
+		{
+			m_photons.clear();
+			m_photons.shrink_to_fit();
+		}
+
+		bool empty() const
+		{
+			return m_photons.empty();
+		}
+
+		/// <summary>
+		/// Returns the number of photons.
+		/// </summary>
+		size_t size() const
+		{
+			return m_photons.size();
+		}
+
+		/// <summary>
+		/// Returns the memory used by the map in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_photons.capacity()*sizeof(Photon);
+		}
+
+		/// <summary>
+		/// Finds the nearest photons of a surface point.
+		/// </summary>
+		/// <param name="position">The surface point.</param>
+		/// <param name="normal">The normal at the point (normalized), flattening the search sphere.</param>
+		/// <param name="maxRadius">The maximum distance of the photons.</param>
+		/// <param name="count">The maximum number of photons (at most maxGather).</param>
+		/// <param name="nearest">Receives the photons and their squared distances (in no particular order).</param>
+		/// <param name="radius2">Receives the squared radius of the disc containing the photons: the distance of
+		/// the farthest photon if count photons are found, maxRadius otherwise.</param>
+		/// <returns>The number of photons found.</returns>
+		size_t nearest(Math::Vector3f const & position, Math::Vector3f const & normal, double maxRadius, size_t count, Neighbour * nearest, double & radius2) const
+		{
+			Search search;
+			for (int c = 0; c < 3; ++c) { search.position[c] = position[c]; }
+			search.normal = normal;
+			search.radius2 = maxRadius*maxRadius;
+			search.count = ::std::min(count, maxGather);
+			search.found = 0;
+			search.heap = nearest;
+			if (!m_photons.empty() && search.count > 0) { locate(search, 0); }
+			radius2 = search.radius2;
+			return search.found;
+		}
+	};
+}
+
+#endif
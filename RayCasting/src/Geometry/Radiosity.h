@@ -0,0 +1,556 @@
+#ifndef _Geometry_Radiosity_H
+#define _Geometry_Radiosity_H
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Triangle.h>
+#include <Geometry/BoundingBox.h>
+#include <Geometry/RGBColor.h>
+#include <Geometry/PhongBSDF.h>
+#include <Math/Vectorf.h>
+#include <Math/Constant.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <math.h>
+
+namespace Geometry
+{
+	/// <summary>
+	/// A hierarchical radiosity solution of the diffuse interreflections between the triangles of a scene
+	/// (Hanrahan et al. 91). Each triangle is the root of a patch hierarchy, a patch is split in four by the middles
+	/// of its edges. Patches exchange light through links carrying a form factor (mean of point to disc
+	/// approximations between a few pairs of points of the patches, each tested by a visibility ray). A link whose
+	/// transported light (radiosity x largest form factor of the pairs x area) exceeds the threshold is replaced by
+	/// the links of the children of its largest patch. Each iteration refines the links from the current radiosities, gathers the light of the
+	/// links (one bounce, in parallel), then pushes the irradiance gathered by the patches to their leaves and
+	/// pulls the radiosities of the leaves up. The renderings interpolate the irradiance of the leaves at their
+	/// corners (averaged between the coplanar leaves sharing a corner) and multiply it by the reflectance of the
+	/// surface. Both sides of a triangle are lit and emit, the glossy lobes of the materials are ignored.
+	/// Triangles are identified by their address, the solution is valid while the geometries are unchanged.
+	/// </summary>
+	class Radiosity
+	{
+	public:
+		/// <summary> The side of a triangle: the side of its geometric normal or the opposite one. </summary>
+		enum Side { Front = 0, Back = 1 };
+		/// <summary> The maximum number of triangles of a solution: the initial links connect all the pairs of triangles. </summary>
+		static const size_t maxTriangles = 4096;
+
+	protected:
+		/// <summary>
+		/// A link bringing the radiosity of a side of a source patch to a side of the receiving patch.
+		/// </summary>
+		struct Link
+		{
+			::std::uint32_t source;
+			::std::uint8_t receiverSide;
+			::std::uint8_t sourceSide;
+			/// <summary> The form factor from the receiver to the source (visibility included) and its upper bound. </summary>
+			float formFactor;
+			float bound;
+		};
+
+		struct Patch
+		{
+			/// <summary> The corners and their (u,v) coordinates in the triangle. </summary>
+			Math::Vector3f corner[3];
+			double uv[3][2];
+			const Triangle * triangle;
+			double area;
+			/// <summary> The diffuse reflectance and the emitted radiosity (pi x radiance) at the center. </summary>
+			RGBColor reflectance;
+			RGBColor emission;
+			/// <summary> The radiosity and the irradiance (the one gathered by the links and the total one) of the sides. </summary>
+			RGBColor radiosity[2];
+			RGBColor gathered[2];
+			RGBColor irradiance[2];
+			/// <summary> The irradiance at the corners (leaves only). </summary>
+			RGBColor cornerIrradiance[2][3];
+			/// <summary> The children (0 for a leaf, a root is never a child). </summary>
+			::std::uint32_t child[4];
+			::std::vector<Link> links;
+
+			Math::Vector3f center() const
+			{
+				return (corner[0] + corner[1] + corner[2]) / 3.0;
+			}
+
+			Math::Vector3f point(const double * barycentric) const
+			{
+				return corner[0] * barycentric[0] + corner[1] * barycentric[1] + corner[2] * barycentric[2];
+			}
+		};
+
+		/// <summary> A link to create from a receiver. </summary>
+		struct Candidate
+		{
+			::std::uint32_t receiver;
+			::std::uint32_t source;
+			Link link;
+		};
+
+		::std::vector<Patch> m_patches;
+		::std::unordered_map<const Triangle*, ::std::uint32_t> m_roots;
+		/// <summary> The transported light above which a link is refined, the minimum area of a split patch. </summary>
+		double m_threshold;
+		double m_minArea;
+		size_t m_linkCount;
+
+		/// <summary> The number of visibility rays of a form factor. </summary>
+		static const int visibilitySamples = 4;
+
+		/// <summary>
+		/// The barycentric coordinates of the points of a patch casting the visibility rays.
+		/// </summary>
+		static const double * visibilityPoint(int index)
+		{
+			static const double points[visibilitySamples][3] = {
+				{ 1.0 / 3.0, 1.0 / 3.0, 1.0 / 3.0 },
+				{ 2.0 / 3.0, 1.0 / 6.0, 1.0 / 6.0 },
+				{ 1.0 / 6.0, 2.0 / 3.0, 1.0 / 6.0 },
+				{ 1.0 / 6.0, 1.0 / 6.0, 2.0 / 3.0 }
+			};
+			return points[index];
+		}
+
+		/// <summary>
+		/// Creates a patch of a triangle from the (u,v) coordinates of its corners.
+		/// </summary>
+		::std::uint32_t createPatch(const Triangle * triangle, const double uv[3][2])
+		{
+			Patch patch;
+			patch.triangle = triangle;
+			for (int c = 0; c < 3; ++c)
+			{
+				patch.uv[c][0] = uv[c][0];
+				patch.uv[c][1] = uv[c][1];
+				patch.corner[c] = triangle->samplePoint(uv[c][0], uv[c][1]);
+			}
+			patch.area = ((patch.corner[1] - patch.corner[0]) ^ (patch.corner[2] - patch.corner[0])).norm()*0.5;
+			const double u = (uv[0][0] + uv[1][0] + uv[2][0]) / 3.0;
+			const double v = (uv[0][1] + uv[1][1] + uv[2][1]) / 3.0;
+			const RGBColor texture = triangle->sampleTexture(u, v);
+			const Math::Vector3f normal = triangle->normal().normalized();
+			patch.reflectance = PhongBSDF(*triangle->material(), texture, normal, -normal).diffuse();
+			patch.emission = triangle->material()->getEmissive()*texture*Math::pi;
+			for (int side = 0; side < 2; ++side) { patch.radiosity[side] = patch.emission; }
+			for (int c = 0; c < 4; ++c) { patch.child[c] = 0; }
+			m_patches.push_back(patch);
+			return (::std::uint32_t)m_patches.size() - 1;
+		}
+
+		/// <summary>
+		/// Splits a patch in four (the corner patches then the middle one), if not already split.
+		/// </summary>
+		void subdivide(::std::uint32_t index)
+		{
+			if (m_patches[index].child[0] != 0) { return; }
+			double uv[3][2], middle[3][2];
+			for (int c = 0; c < 3; ++c)
+			{
+				for (int k = 0; k < 2; ++k)
+				{
+					uv[c][k] = m_patches[index].uv[c][k];
+					middle[c][k] = (m_patches[index].uv[c][k] + m_patches[index].uv[(c + 1) % 3][k])*0.5;
+				}
+			}
+			const Triangle * triangle = m_patches[index].triangle;
+			// middle[0]: ab, middle[1]: bc, middle[2]: ca
+			const double children[4][3][2] = {
+				{ { uv[0][0], uv[0][1] }, { middle[0][0], middle[0][1] }, { middle[2][0], middle[2][1] } },
+				{ { middle[0][0], middle[0][1] }, { uv[1][0], uv[1][1] }, { middle[1][0], middle[1][1] } },
+				{ { middle[2][0], middle[2][1] }, { middle[1][0], middle[1][1] }, { uv[2][0], uv[2][1] } },
+				{ { middle[1][0], middle[1][1] }, { middle[2][0], middle[2][1] }, { middle[0][0], middle[0][1] } }
+			};
+			::std::uint32_t created[4];
+			for (int c = 0; c < 4; ++c) { created[c] = createPatch(triangle, children[c]); }
+			for (int c = 0; c < 4; ++c)
+			{
+				m_patches[index].child[c] = created[c];
+				// The children start from the radiosity of their parent (the refinement oracle reads it)
+				for (int side = 0; side < 2; ++side) { m_patches[created[c]].radiosity[side] = m_patches[index].radiosity[side]; }
+			}
+		}
+
+		/// <summary>
+		/// The child of a patch containing a point given by its barycentric coordinates in the patch, which become
+		/// its coordinates in the child (see Radiosity::subdivide).
+		/// </summary>
+		static int descend(double * barycentric)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				if (barycentric[c] >= 0.5)
+				{
+					// The child c keeps the corner c, its other corners are the middles of the edges of the corner c
+					for (int k = 0; k < 3; ++k) { barycentric[k] *= 2.0; }
+					barycentric[c] -= 1.0;
+					return c;
+				}
+			}
+			// The middle child has the corners (bc, ca, ab)
+			const double local[3] = { 1.0 - 2.0*barycentric[0], 1.0 - 2.0*barycentric[1], 1.0 - 2.0*barycentric[2] };
+			for (int k = 0; k < 3; ++k) { barycentric[k] = local[k]; }
+			return 3;
+		}
+
+		/// <summary>
+		/// Computes the link from a receiver to a source: the sides facing each other (seen from their centers) and the
+		/// form factor, the mean of the point to disc form factors between pairs of points of the patches (visibility
+		/// included). The largest unoccluded one bounds the form factor for the refinement.
+		/// </summary>
+		/// <returns>false if the patches do not see each other.</returns>
+		template <class Visibility>
+		bool formFactor(::std::uint32_t receiver, ::std::uint32_t source, Visibility & visible, Link & link) const
+		{
+			const Patch & r = m_patches[receiver];
+			const Patch & s = m_patches[source];
+			link.source = source;
+			link.formFactor = 0.0f;
+			link.bound = 0.0f;
+			if (r.triangle == s.triangle) { return false; }
+			const Math::Vector3f axis = s.center() - r.center();
+			Math::Vector3f receiverNormal = r.triangle->normal().normalized();
+			Math::Vector3f sourceNormal = s.triangle->normal().normalized();
+			link.receiverSide = (::std::uint8_t)((receiverNormal*axis >= 0.0) ? Front : Back);
+			link.sourceSide = (::std::uint8_t)((sourceNormal*axis <= 0.0) ? Front : Back);
+			if (link.receiverSide == Back) { receiverNormal = -receiverNormal; }
+			if (link.sourceSide == Back) { sourceNormal = -sourceNormal; }
+			double sum = 0.0;
+			double bound = 0.0;
+			for (int cpt = 0; cpt < visibilitySamples; ++cpt)
+			{
+				const Math::Vector3f from = r.point(visibilityPoint(cpt));
+				const Math::Vector3f to = s.point(visibilityPoint((cpt + 1) % visibilitySamples));
+				Math::Vector3f direction = to - from;
+				const double distance2 = direction.norm2();
+				if (distance2 <= 0.0) { continue; }
+				direction = direction / sqrt(distance2);
+				const double cosines = ::std::max(0.0, receiverNormal*direction)*::std::max(0.0, -(sourceNormal*direction));
+				if (cosines <= 0.0) { continue; }
+				const double factor = s.area*cosines / (Math::pi*distance2 + s.area);
+				bound = ::std::max(bound, factor);
+				if (visible(from, to, s.triangle)) { sum += factor; }
+			}
+			if (sum <= 0.0) { return false; }
+			link.formFactor = (float)(sum / visibilitySamples);
+			link.bound = (float)bound;
+			return true;
+		}
+
+		/// <summary>
+		/// The light transported by a link if it is refinable, 0 otherwise.
+		/// </summary>
+		double transported(::std::uint32_t receiver, Link const & link) const
+		{
+			const Patch & r = m_patches[receiver];
+			const Patch & s = m_patches[link.source];
+			if (::std::max(r.area, s.area) < 2.0*m_minArea || r.reflectance.isBlack()) { return 0.0; }
+			return s.radiosity[link.sourceSide].grey()*link.bound*r.area;
+		}
+
+		/// <summary>
+		/// Replaces a link by the candidate links of the children of its largest patch.
+		/// </summary>
+		void split(::std::uint32_t receiver, Link const & link, ::std::vector<Candidate> & candidates)
+		{
+			if (m_patches[receiver].area >= m_patches[link.source].area)
+			{
+				subdivide(receiver);
+				for (int c = 0; c < 4; ++c)
+				{
+					Candidate candidate = { m_patches[receiver].child[c], link.source, Link() };
+					candidates.push_back(candidate);
+				}
+			}
+			else
+			{
+				subdivide(link.source);
+				for (int c = 0; c < 4; ++c)
+				{
+					Candidate candidate = { receiver, m_patches[link.source].child[c], Link() };
+					candidates.push_back(candidate);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Computes the form factors of the candidates in parallel, then keeps the accurate links and splits the other ones
+		/// until all the links are accurate.
+		/// </summary>
+		template <class Visibility>
+		void connect(::std::vector<Candidate> & candidates, Visibility & visible)
+		{
+			::std::vector<char> valid;
+			while (!candidates.empty())
+			{
+				valid.assign(candidates.size(), 0);
+#pragma omp parallel for schedule(dynamic, 64)
+				for (int cpt = 0; cpt < (int)candidates.size(); ++cpt)
+				{
+					valid[cpt] = formFactor(candidates[cpt].receiver, candidates[cpt].source, visible, candidates[cpt].link) ? 1 : 0;
+				}
+				::std::vector<Candidate> next;
+				for (size_t cpt = 0; cpt < candidates.size(); ++cpt)
+				{
+					if (!valid[cpt]) { continue; }
+					const Candidate & candidate = candidates[cpt];
+					if (transported(candidate.receiver, candidate.link) > m_threshold) { split(candidate.receiver, candidate.link, next); }
+					else
+					{
+						m_patches[candidate.receiver].links.push_back(candidate.link);
+						++m_linkCount;
+					}
+				}
+				candidates.swap(next);
+			}
+		}
+
+		/// <summary>
+		/// Splits the links that became inaccurate with the current radiosities.
+		/// </summary>
+		/// <returns>The number of split links.</returns>
+		template <class Visibility>
+		size_t refine(Visibility & visible)
+		{
+			::std::vector<Candidate> candidates;
+			size_t result = 0;
+			const size_t count = m_patches.size();
+			for (::std::uint32_t index = 0; index < count; ++index)
+			{
+				// The splits add patches: the links are accessed through the index of their patch
+				size_t kept = 0;
+				for (size_t cpt = 0; cpt < m_patches[index].links.size(); ++cpt)
+				{
+					const Link link = m_patches[index].links[cpt];
+					if (transported(index, link) > m_threshold)
+					{
+						split(index, link, candidates);
+						++result;
+						--m_linkCount;
+					}
+					else { m_patches[index].links[kept++] = link; }
+				}
+				m_patches[index].links.resize(kept);
+			}
+			connect(candidates, visible);
+			return result;
+		}
+
+		/// <summary>
+		/// Pushes the irradiance of a patch (plus the one of its ancestors) to its leaves and returns its radiosity, the
+		/// area weighted mean of the radiosities of its children.
+		/// </summary>
+		void pushPull(::std::uint32_t index, const RGBColor * inherited)
+		{
+			Patch & patch = m_patches[index];
+			for (int side = 0; side < 2; ++side) { patch.irradiance[side] = inherited[side] + patch.gathered[side]; }
+			if (patch.child[0] == 0)
+			{
+				for (int side = 0; side < 2; ++side) { patch.radiosity[side] = patch.emission + patch.reflectance*patch.irradiance[side]; }
+				return;
+			}
+			RGBColor radiosity[2];
+			for (int c = 0; c < 4; ++c)
+			{
+				const Patch & child = m_patches[patch.child[c]];
+				pushPull(patch.child[c], patch.irradiance);
+				for (int side = 0; side < 2; ++side) { radiosity[side] = radiosity[side] + child.radiosity[side] * child.area; }
+			}
+			for (int side = 0; side < 2; ++side) { patch.radiosity[side] = radiosity[side] / patch.area; }
+		}
+
+		/// <summary>
+		/// Computes the irradiance at the corners of the leaves: the area weighted mean of the irradiance of the leaves
+		/// sharing the corner (same position, same oriented normal).
+		/// </summary>
+		void smooth(double tolerance)
+		{
+			struct Accumulator
+			{
+				Math::Vector3f normal;
+				RGBColor irradiance;
+				double weight;
+			};
+			::std::unordered_map<::std::uint64_t, ::std::vector<Accumulator> > corners;
+			auto key = [tolerance](Math::Vector3f const & position) {
+				::std::uint64_t result = 1469598103934665603ull;
+				for (int c = 0; c < 3; ++c)
+				{
+					result = (result ^ (::std::uint64_t)(::std::int64_t)floor(position[c] / tolerance + 0.5))*1099511628211ull;
+				}
+				return result;
+			};
+			auto find = [&corners, &key](Math::Vector3f const & position, Math::Vector3f const & normal) -> Accumulator & {
+				::std::vector<Accumulator> & list = corners[key(position)];
+				for (Accumulator & accumulator : list)
+				{
+					if (accumulator.normal*normal > 0.999) { return accumulator; }
+				}
+				Accumulator created = { normal, RGBColor(), 0.0 };
+				list.push_back(created);
+				return list.back();
+			};
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				for (Patch & patch : m_patches)
+				{
+					if (patch.child[0] != 0) { continue; }
+					for (int side = 0; side < 2; ++side)
+					{
+						const Math::Vector3f normal = patch.triangle->normal().normalized()*((side == Front) ? 1.0 : -1.0);
+						for (int c = 0; c < 3; ++c)
+						{
+							Accumulator & accumulator = find(patch.corner[c], normal);
+							if (pass == 0)
+							{
+								accumulator.irradiance = accumulator.irradiance + patch.irradiance[side] * patch.area;
+								accumulator.weight += patch.area;
+							}
+							else { patch.cornerIrradiance[side][c] = accumulator.irradiance / accumulator.weight; }
+						}
+					}
+				}
+			}
+		}
+
+	public:
+		Radiosity()
+			: m_threshold(0.0), m_minArea(0.0), m_linkCount(0)
+		{}
+
+		void clear()
+		{
+			m_patches.clear();
+			m_patches.shrink_to_fit();
+			m_roots.clear();
+			m_linkCount = 0;
+		}
+
+		bool empty() const
+		{
+			return m_patches.empty();
+		}
+
+		/// <summary>
+		/// Returns the number of patches (leaves and inner patches).
+		/// </summary>
+		size_t patchCount() const
+		{
+			return m_patches.size();
+		}
+
+		size_t linkCount() const
+		{
+			return m_linkCount;
+		}
+
+		/// <summary>
+		/// Returns the memory used by the solution in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_patches.capacity()*sizeof(Patch) + m_linkCount*sizeof(Link)
+				+ m_roots.size()*(sizeof(const Triangle*) + sizeof(::std::uint32_t) + 2 * sizeof(void*));
+		}
+
+		/// <summary>
+		/// Solves the radiosity of the triangles of the geometries (the triangles must outlive the solution).
+		/// </summary>
+		/// <param name="geometries">The geometries of the scene.</param>
+		/// <param name="visible">The visibility between two points: visible(from, to, triangle of to), concurrent calls.</param>
+		/// <param name="iterations">The maximum number of iterations (the number of bounces of the light).</param>
+		/// <param name="threshold">The transported light (radiosity x form factor x area) above which a link is refined.</param>
+		/// <param name="minArea">The area below which the patches are not split.</param>
+		/// <param name="tolerance">The iterations stop once the mean radiosity changes less than this ratio.</param>
+		/// <returns>false if the geometries have more than maxTriangles triangles (nothing is solved).</returns>
+		template <class Visibility>
+		bool solve(const ::std::deque<::std::pair<BoundingBox, Geometry> > & geometries, Visibility visible, int iterations, double threshold, double minArea, double tolerance = 1e-3)
+		{
+			clear();
+			size_t triangles = 0;
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : geometries) { triangles += geometry.second.getTriangles().size(); }
+			if (triangles > maxTriangles)
+			{
+				::std::cerr << "Radiosity: " << triangles << " triangles, the solution is limited to " << maxTriangles << " triangles" << ::std::endl;
+				return false;
+			}
+			m_threshold = threshold;
+			m_minArea = minArea;
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : geometries)
+			{
+				for (const Triangle & triangle : geometry.second.getTriangles())
+				{
+					static const double uv[3][2] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 0.0, 1.0 } };
+					m_roots[&triangle] = createPatch(&triangle, uv);
+				}
+			}
+			const ::std::uint32_t roots = (::std::uint32_t)m_patches.size();
+			// Links all the pairs of triangles seeing each other
+			::std::vector<Candidate> candidates;
+			candidates.reserve((size_t)roots*(roots - 1));
+			for (::std::uint32_t receiver = 0; receiver < roots; ++receiver)
+			{
+				for (::std::uint32_t source = 0; source < roots; ++source)
+				{
+					Candidate candidate = { receiver, source, Link() };
+					if (source != receiver) { candidates.push_back(candidate); }
+				}
+			}
+			connect(candidates, visible);
+			double previous = 0.0;
+			for (int iteration = 0; iteration < iterations; ++iteration)
+			{
+				const size_t refined = (iteration > 0) ? refine(visible) : 0;
+				// Gathers one bounce from the radiosities of the previous iteration (Jacobi)
+#pragma omp parallel for schedule(dynamic, 64)
+				for (int index = 0; index < (int)m_patches.size(); ++index)
+				{
+					Patch & patch = m_patches[index];
+					for (int side = 0; side < 2; ++side) { patch.gathered[side] = RGBColor(); }
+					for (const Link & link : patch.links)
+					{
+						patch.gathered[link.receiverSide] = patch.gathered[link.receiverSide] + m_patches[link.source].radiosity[link.sourceSide] * link.formFactor;
+					}
+				}
+				double power = 0.0;
+#pragma omp parallel for schedule(dynamic) reduction(+:power)
+				for (int index = 0; index < (int)roots; ++index)
+				{
+					const RGBColor none[2];
+					pushPull(index, none);
+					power += (m_patches[index].radiosity[Front].grey() + m_patches[index].radiosity[Back].grey())*m_patches[index].area;
+				}
+				::std::cout << "Radiosity: iteration " << iteration + 1 << ", " << m_patches.size() << " patches, " << m_linkCount << " links (" << refined << " refined)" << ::std::endl;
+				if (iteration > 0 && refined == 0 && ::std::abs(power - previous) <= tolerance*power) { break; }
+				previous = power;
+			}
+			smooth(::std::max(sqrt(m_minArea)*1e-3, 1e-9));
+			return true;
+		}
+
+		/// <summary>
+		/// Interpolates the irradiance of a side of a triangle at the coordinates (u,v) of an intersection.
+		/// </summary>
+		/// <returns>false if the triangle is not in the solution.</returns>
+		bool lookup(const Triangle * triangle, double u, double v, Side side, RGBColor & irradiance) const
+		{
+			auto found = m_roots.find(triangle);
+			if (found == m_roots.end()) { return false; }
+			double barycentric[3] = { 1.0 - u - v, u, v };
+			for (int c = 0; c < 3; ++c) { barycentric[c] = ::std::min(::std::max(barycentric[c], 0.0), 1.0); }
+			const Patch * patch = &m_patches[found->second];
+			while (patch->child[0] != 0)
+			{
+				patch = &m_patches[patch->child[descend(barycentric)]];
+			}
+			irradiance = patch->cornerIrradiance[side][0] * barycentric[0] + patch->cornerIrradiance[side][1] * barycentric[1] + patch->cornerIrradiance[side][2] * barycentric[2];
+			return true;
+		}
+	};
+}
+
+#endif
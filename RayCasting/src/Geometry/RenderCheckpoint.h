@@ -0,0 +1,201 @@
+#ifndef _Geometry_RenderCheckpoint_H
+#define _Geometry_RenderCheckpoint_H
+
+#include <Geometry/AccumulationBuffer.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+
+namespace Geometry
+{
+	/// <summary>
+	/// The state of a progressive rendering saved on disk so that it can be resumed after a crash or a
+	/// preemption. The samplers are deterministic functions of the sampler seed and of the pass index
+	/// (see Scene::samplePixel), so these two values are the whole random number generator state.
+	/// </summary>
+	class RenderCheckpoint
+	{
+	public:
+		/// <summary> The rendering parameters, a checkpoint can only resume an identical rendering. </summary>
+		::std::int32_t frameWidth;
+		::std::int32_t frameHeight;
+		/// <summary> The position of the crop window in the image (the buffer covers the crop window). </summary>
+		::std::int32_t cropX;
+		::std::int32_t cropY;
+		::std::int32_t maxDepth;
+		::std::int32_t subPixelDivision;
+		::std::int32_t passPerPixel;
+		/// <summary> The index of the next pass to render. </summary>
+		::std::int64_t pass;
+		/// <summary> The global seed of the pixel samplers. </summary>
+		::std::uint32_t samplerSeed;
+		/// <summary> 1 if the quasi Monte Carlo sampler is used. </summary>
+		::std::uint32_t qmc;
+		/// <summary> The fingerprint of the scene, of the camera and of the integrator settings (see Scene::renderFingerprint). </summary>
+		::std::uint64_t fingerprint;
+		/// <summary> The accumulated samples of the crop window. </summary>
+		AccumulationBuffer buffer;
+		/// <summary> The accumulated direct lighting of the crop window, empty if the auxiliary buffers are not exported. </summary>
+		AccumulationBuffer direct;
+
+	protected:
+		/// <summary> The header of the file ("RCCK") and the version of the format. </summary>
+		enum : ::std::uint32_t { Magic = 0x4B434352u, Version = 5 };
+
+		template <class T>
+		static void write(::std::ostream & out, const T & value)
+		{
+			out.write((const char*)&value, sizeof(T));
+		}
+
+		template <class T>
+		static bool read(::std::istream & in, T & value)
+		{
+			return (bool)in.read((char*)&value, sizeof(T));
+		}
+
+		/// <summary>
+		/// Writes the samples of a buffer, per row: the RGB sums, the sums of squared grey values (double) and the sample counts.
+		/// </summary>
+		static void writeSamples(::std::ostream & out, const AccumulationBuffer & buffer)
+		{
+			::std::vector<double> sums(buffer.width() * 3);
+			::std::vector<double> squares(buffer.width());
+			::std::vector<::std::int32_t> counts(buffer.width());
+			for (int y = 0; y < buffer.height(); ++y)
+			{
+				for (int x = 0; x < buffer.width(); ++x)
+				{
+					const RGBColor & sum = buffer.sum(x, y);
+					sums[x * 3] = sum[0];
+					sums[x * 3 + 1] = sum[1];
+					sums[x * 3 + 2] = sum[2];
+					squares[x] = buffer.sumSquares(x, y);
+					counts[x] = buffer.count(x, y);
+				}
+				out.write((const char*)sums.data(), sums.size()*sizeof(double));
+				out.write((const char*)squares.data(), squares.size()*sizeof(double));
+				out.write((const char*)counts.data(), counts.size()*sizeof(::std::int32_t));
+			}
+		}
+
+		/// <summary>
+		/// Reads the samples written by RenderCheckpoint::writeSamples in a buffer of the given size.
+		/// </summary>
+		/// <returns>false if the file is truncated.</returns>
+		static bool readSamples(::std::istream & in, int width, int height, AccumulationBuffer & buffer)
+		{
+			buffer = AccumulationBuffer(width, height);
+			::std::vector<double> sums(width * 3);
+			::std::vector<double> squares(width);
+			::std::vector<::std::int32_t> counts(width);
+			for (int y = 0; y < height; ++y)
+			{
+				if (!in.read((char*)sums.data(), sums.size()*sizeof(double)) || !in.read((char*)squares.data(), squares.size()*sizeof(double)) || !in.read((char*)counts.data(), counts.size()*sizeof(::std::int32_t)))
+				{
+					return false;
+				}
+				for (int x = 0; x < width; ++x)
+				{
+					buffer.add(x, y, RGBColor(sums[x * 3], sums[x * 3 + 1], sums[x * 3 + 2]), counts[x], squares[x]);
+				}
+			}
+			return true;
+		}
+
+	public:
+		RenderCheckpoint()
+			: frameWidth(0), frameHeight(0), cropX(0), cropY(0), maxDepth(0), subPixelDivision(1), passPerPixel(1), pass(0), samplerSeed(0), qmc(1), fingerprint(0)
+		{}
+
+		/// <summary>
+		/// Returns true if the checkpoint has been produced by a rendering with the same parameters of the same scene.
+		/// </summary>
+		bool matches(int frameWidth, int frameHeight, int cropX, int cropY, int cropWidth, int cropHeight, int maxDepth, int subPixelDivision, int passPerPixel, ::std::uint64_t fingerprint) const
+		{
+			return this->frameWidth == frameWidth && this->frameHeight == frameHeight && this->cropX == cropX && this->cropY == cropY
+				&& buffer.width() == cropWidth && buffer.height() == cropHeight && this->maxDepth == maxDepth
+				&& this->subPixelDivision == subPixelDivision && this->passPerPixel == passPerPixel
+				&& this->fingerprint == fingerprint;
+		}
+
+		/// <summary>
+		/// Saves the checkpoint. The file is written under a temporary name and then renamed so that a
+		/// crash while writing never destroys the previous checkpoint.
+		/// </summary>
+		/// <param name="filename">The name of the file.</param>
+		/// <returns>true if the checkpoint has been written.</returns>
+		bool save(const ::std::string & filename) const
+		{
+			const ::std::string temporary = filename + ".tmp";
+			{
+				::std::ofstream out(temporary.c_str(), ::std::ios::binary);
+				if (!out)
+				{
+					::std::cerr << "RenderCheckpoint: unable to write " << temporary << ::std::endl;
+					return false;
+				}
+				write(out, (::std::uint32_t)Magic);
+				write(out, (::std::uint32_t)Version);
+				write(out, frameWidth);
+				write(out, frameHeight);
+				write(out, cropX);
+				write(out, cropY);
+				write(out, (::std::int32_t)buffer.width());
+				write(out, (::std::int32_t)buffer.height());
+				write(out, (::std::int32_t)direct.width());
+				write(out, (::std::int32_t)direct.height());
+				write(out, maxDepth);
+				write(out, subPixelDivision);
+				write(out, passPerPixel);
+				write(out, pass);
+				write(out, samplerSeed);
+				write(out, qmc);
+				write(out, fingerprint);
+				writeSamples(out, buffer);
+				writeSamples(out, direct);
+				if (!out)
+				{
+					::std::cerr << "RenderCheckpoint: error while writing " << temporary << ::std::endl;
+					return false;
+				}
+			}
+			::std::remove(filename.c_str());
+			return ::std::rename(temporary.c_str(), filename.c_str()) == 0;
+		}
+
+		/// <summary>
+		/// Loads a checkpoint.
+		/// </summary>
+		/// <param name="filename">The name of the file.</param>
+		/// <returns>false if the file is missing or invalid.</returns>
+		bool load(const ::std::string & filename)
+		{
+			::std::ifstream in(filename.c_str(), ::std::ios::binary);
+			if (!in) { return false; }
+			::std::uint32_t magic, version;
+			::std::int32_t width, height, directWidth, directHeight;
+			if (!read(in, magic) || !read(in, version) || magic != Magic || version != Version)
+			{
+				::std::cerr << "RenderCheckpoint: " << filename << " is not a checkpoint" << ::std::endl;
+				return false;
+			}
+			if (!read(in, frameWidth) || !read(in, frameHeight) || !read(in, cropX) || !read(in, cropY) || !read(in, width) || !read(in, height) || !read(in, directWidth) || !read(in, directHeight) || !read(in, maxDepth) || !read(in, subPixelDivision) || !read(in, passPerPixel)
+				|| !read(in, pass) || !read(in, samplerSeed) || !read(in, qmc) || !read(in, fingerprint) || width < 0 || height < 0 || directWidth < 0 || directHeight < 0)
+			{
+				return false;
+			}
+			if (!readSamples(in, width, height, buffer) || !readSamples(in, directWidth, directHeight, direct))
+			{
+				::std::cerr << "RenderCheckpoint: " << filename << " is truncated" << ::std::endl;
+				return false;
+			}
+			return true;
+		}
+	};
+}
+
+#endif
@@ -1,15 +1,16 @@
 #ifndef _Geometry_Scene_H
 #define _Geometry_Scene_H
 
-#include <windows.h>
 #include <Geometry/Geometry.h>
 #include <Geometry/PointLight.h>
 #include <Visualizer/Visualizer.h>
 #include <Geometry/Camera.h>
 #include <Geometry/BoundingBox.h>
 #include <Math/RandomDirection.h>
-#include <windows.h>
 #include <System/aligned_allocator.h>
+#include <System/Clock.h>
+#include <System/Fingerprint.h>
+#include <System/Trace.h>
 #include <Math/Constant.h>
 #include <queue>
 #include <functional>
@@ -19,6 +20,26 @@
 #include <Geometry/LightSource.h>
 #include <ctime>
 #include <Math/RandomDirection.h>
+#include <Math/PixelSampler.h>
+#include <Math/SobolSampler.h>
+#include <Geometry/AccumulationBuffer.h>
+#include <Geometry/RenderCheckpoint.h>
+#include <Geometry/MeshTransform.h>
+#include <Geometry/FeatureBuffer.h>
+#include <Geometry/Denoiser.h>
+#include <Spy/Spy.h>
+#include <Geometry/Heatmap.h>
+#include <Geometry/MemoryReport.h>
+#include <Geometry/PhongBSDF.h>
+#include <Geometry/LightBVH.h>
+#include <Geometry/LightCache.h>
+#include <Geometry/Lightmap.h>
+#include <Geometry/PhotonMap.h>
+#include <Geometry/GuidingField.h>
+#include <Geometry/Radiosity.h>
+#include <set>
+#include <map>
+#include <unordered_map>
 
 namespace Geometry
 {
@@ -35,8 +56,16 @@ namespace Geometry
 	class Scene
 	{
 	protected:
-		/// \brief	The visualizer (rendering target).
+		/// \brief	The visualizer (rendering target), nullptr for headless rendering.
 		Visualizer::Visualizer * m_visu ;
+		/// \brief	The width of the rendered image.
+		int m_width ;
+		/// \brief	The height of the rendered image.
+		int m_height ;
+		/// \brief	The rendered region of the image (crop window): [m_cropX0;m_cropX1)x[m_cropY0;m_cropY1).
+		int m_cropX0, m_cropY0, m_cropX1, m_cropY1 ;
+		/// \brief	The samples accumulated per pixel of the crop window by Scene::compute.
+		AccumulationBuffer m_accumulationBuffer ;
 		/// \brief	The scene geometry (basic representation without any optimization).
 		::std::deque<::std::pair<BoundingBox, Geometry> > m_geometries ;
 		//Geometry m_geometry ;
@@ -54,15 +83,34 @@ namespace Geometry
 		size_t m_lightSamples;
 		/// brief Rendering pass number
 		int m_pass;
-		/// <summary>
-		/// The light sampler associated with the scene
-		/// </summary>
-
-		//LightSampler m_lightSampler;
 		//Les sources surfaciques de lumiere de la scene
 		::std::vector<LightSource*> m_lightSampler;
+		/// \brief The light source (index in m_lightSampler) of the geometries of the light sources, by index in m_geometries
+		::std::map<size_t, size_t> m_lightSourceGeometries;
+		/// \brief The emissive triangles of the geometries which are not part of a light source (built with the BVH),
+		/// sampled by Scene::phongDirect as one more surface light
+		LightSampler m_emitters;
+		/// \brief All the emissive triangles of the geometries (built with the BVH), the photons are emitted from them
+		LightSampler m_photonEmitters;
+		/// \brief The hierarchy of the emissive triangles of the geometries (built with the BVH)
+		LightBVH m_lightBVH;
+		/// \brief The light of an emissive triangle and the share of the triangle in the area of this light
+		struct LightShare
+		{
+			/// \brief The index of the light source in m_lightSampler, -1 for the emissive geometries of m_emitters
+			int source;
+			double share;
+		};
+		/// \brief The light of each triangle of m_lightBVH (see Scene::phongDirect)
+		::std::unordered_map<const Triangle*, LightShare> m_lightShares;
 		//La structure d'optimisation qui va permettre d'optimiser le calcul d'intersections
 		BVH *m_bvh;
+		/// \brief true if the geometry changed since the BVH has been built
+		bool m_bvhDirty = true;
+		/// \brief Rest pose of the geometries moved by Scene::setGeometryTransform (indexed as m_geometries)
+		::std::map<size_t, ::std::deque<Math::Vector3f> > m_restVertices;
+		/// \brief Current transform of the geometries moved by Scene::setGeometryTransform
+		::std::map<size_t, MeshTransform> m_geometryTransforms;
 		//******GI
 		//Activer ou desactiver l'illumination globale
 		bool m_GI_surface = true;
@@ -70,7 +118,72 @@ namespace Geometry
 		bool m_GI_graineUnique = false; // NE PAS TOUCHE MAMA
 		//pathtracing
 		bool m_GI_indirect = true;
-
+		/// \brief Use the iterative path tracer (Scene::pathTracingIterative) instead of the recursive one
+		bool m_GI_iterative = false;
+		/// \brief The number of bounces of the iterative path tracer before the russian roulette starts
+		int m_rouletteDepth = 3;
+		/// \brief Multiple importance sampling of the surface lights in the iterative path tracer
+		bool m_GI_mis = false;
+		/// \brief Interpolation of the indirect diffuse lighting from an irradiance cache (see Scene::setIrradianceCache)
+		bool m_irradianceCaching = false;
+		double m_irradianceAccuracy = 0.2;
+		int m_irradianceRays = 64;
+		LightCache m_irradianceCache;
+		/// \brief The baked diffuse lighting and its use by the renderings (see Scene::bakeLightmap)
+		Lightmap m_lightmap;
+		bool m_useLightmap = false;
+		/// \brief Two pass photon mapping render mode (see Scene::setPhotonMapping)
+		bool m_photonMapping = false;
+		int m_photonCount = 200000;
+		int m_causticPhotonCount = 200000;
+		int m_photonGather = 64;
+		PhotonMap m_globalPhotons;
+		PhotonMap m_causticPhotons;
+		/// \brief The maximum radius of the photon gathers (relative to the scene, see Scene::computePhotonMaps)
+		double m_globalRadius = 1.0;
+		double m_causticRadius = 1.0;
+		/// \brief The hierarchical radiosity solution and its render mode (see Scene::setRadiosity)
+		bool m_radiosityEnabled = false;
+		double m_radiosityAccuracy = 1e-4;
+		Radiosity m_radiosity;
+		/// \brief Path guiding of the iterative path tracer (see Scene::setPathGuiding)
+		bool m_pathGuiding = false;
+		double m_guidingProbability = 0.5;
+		GuidingField m_guiding;
+		/// \brief The paths are recorded in the guiding field (during the training iterations of Scene::compute)
+		bool m_guidingTraining = false;
+		/// \brief Use Owen scrambled Sobol sequences (true) or independent random numbers (false)
+		bool m_GI_qmc = true;
+		/// \brief Global seed of the pixel samplers
+		unsigned int m_samplerSeed = 0;
+		/// \brief The checkpoint file of Scene::compute (no checkpoint if empty)
+		::std::string m_checkpointFile;
+		/// \brief The time between two checkpoints (in seconds)
+		double m_checkpointInterval = 300.0;
+		/// \brief Resume Scene::compute from the checkpoint file if it exists
+		bool m_resume = false;
+		/// \brief The fingerprint of the rendering saved in the checkpoints (see Scene::renderFingerprint)
+		::std::uint64_t m_checkpointFingerprint = 0;
+		/// \brief Wall clock budget of Scene::compute in seconds (0: no limit)
+		double m_timeBudget = 0.0;
+		/// \brief Noise level stopping Scene::compute (0: no target, see AccumulationBuffer::noise)
+		double m_noiseTarget = 0.0;
+		/// \brief Progressive resolution preview of the first pass (see Scene::setPreview)
+		bool m_preview = false;
+		/// \brief Denoising of the rendered image (see Scene::setDenoiser)
+		bool m_denoise = false;
+		Denoiser m_denoiser;
+		/// \brief The features guiding the denoiser and the denoised image (crop window)
+		FeatureBuffer m_features;
+		AccumulationBuffer m_denoised;
+		/// \brief Computation of the auxiliary buffers (see Scene::setAuxiliaryBuffers)
+		bool m_aovs = false;
+		/// \brief The direct lighting part of the samples (crop window)
+		AccumulationBuffer m_directBuffer;
+		/// \brief The traversal cost render mode (see Scene::setHeatmap)
+		Heatmap m_heatmap;
+		/// \brief The time spent computing vertex normals in Scene::add (seconds)
+		double m_normalsTime = 0.0;
 
 	public:
 
@@ -85,9 +198,157 @@ namespace Geometry
 		/// \param [in,out]	visu	If non-null, the visu.
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		Scene(Visualizer::Visualizer * visu)
-			: m_visu(visu), m_diffuseSamples(30), m_specularSamples(30), m_lightSamples(0), m_bvh(nullptr)
+			: m_visu(visu), m_width(visu->width()), m_height(visu->height()), m_cropX0(0), m_cropY0(0), m_cropX1(visu->width()), m_cropY1(visu->height()), m_diffuseSamples(30), m_specularSamples(30), m_lightSamples(0), m_bvh(nullptr)
+		{}
+
+		/// <summary>
+		/// Constructor of a headless scene (no window, the result is only available in the accumulation buffer).
+		/// </summary>
+		/// <param name="width">The width of the rendered image.</param>
+		/// <param name="height">The height of the rendered image.</param>
+		Scene(int width, int height)
+			: m_visu(nullptr), m_width(width), m_height(height), m_cropX0(0), m_cropY0(0), m_cropX1(width), m_cropY1(height), m_diffuseSamples(30), m_specularSamples(30), m_lightSamples(0), m_bvh(nullptr)
 		{}
 
+		/// <summary>
+		/// Returns the width of the rendered image.
+		/// </summary>
+		int width() const
+		{ return m_width; }
+
+		/// <summary>
+		/// Returns the height of the rendered image.
+		/// </summary>
+		int height() const
+		{ return m_height; }
+
+		/// <summary>
+		/// Restricts the rendering to a region of the image (crop window). The camera still maps the full
+		/// image, so the region looks exactly as in a full rendering. The region is clamped to the image.
+		/// </summary>
+		/// <param name="x0">The first column.</param>
+		/// <param name="y0">The first row.</param>
+		/// <param name="x1">The column after the last one.</param>
+		/// <param name="y1">The row after the last one.</param>
+		void setCropWindow(int x0, int y0, int x1, int y1)
+		{
+			m_cropX0 = ::std::max(0, ::std::min(x0, m_width));
+			m_cropY0 = ::std::max(0, ::std::min(y0, m_height));
+			m_cropX1 = ::std::max(m_cropX0, ::std::min(x1, m_width));
+			m_cropY1 = ::std::max(m_cropY0, ::std::min(y1, m_height));
+		}
+
+		/// <summary>
+		/// Renders the whole image again (removes the crop window).
+		/// </summary>
+		void resetCropWindow()
+		{
+			setCropWindow(0, 0, m_width, m_height);
+		}
+
+		/// <summary>
+		/// Returns the samples accumulated by the last call to Scene::compute. The buffer covers the crop window,
+		/// its pixel (0,0) is the pixel (x0,y0) of the image.
+		/// </summary>
+		const AccumulationBuffer & getAccumulationBuffer() const
+		{ return m_accumulationBuffer; }
+
+		/// <summary>
+		/// Returns the final image of the last call to Scene::compute: the denoised image if the denoiser is enabled,
+		/// the accumulated samples otherwise (see Scene::getAccumulationBuffer).
+		/// </summary>
+		const AccumulationBuffer & getImage() const
+		{ return m_denoise ? m_denoised : m_accumulationBuffer; }
+
+		/// <summary>
+		/// Returns the time spent computing the vertex normals of the added geometries, in seconds.
+		/// </summary>
+		double normalsTime() const
+		{ return m_normalsTime; }
+
+		/// <summary>
+		/// Returns the point lights of the scene.
+		/// </summary>
+		const ::std::vector<PointLight> & getLights() const
+		{ return m_lights; }
+
+		/// <summary>
+		/// Returns the surface light sources of the scene.
+		/// </summary>
+		const ::std::vector<LightSource*> & getLightSources() const
+		{ return m_lightSampler; }
+
+		/// <summary>
+		/// Measures the memory used by the meshes, the BVH (if built), the materials, the textures and the buffers of the scene.
+		/// </summary>
+		MemoryReport memoryReport() const
+		{
+			MemoryReport report;
+			::std::set<const Material*> materials;
+			for (auto it = m_geometries.begin(), end = m_geometries.end(); it != end; ++it)
+			{
+				const Geometry & geometry = it->second;
+				report.vertices += geometry.getVertices().size() * sizeof(Math::Vector3f);
+				report.textureCoordinates += geometry.getTextureCoordinates().size() * sizeof(Math::Vector2f);
+				report.triangles += geometry.getTriangles().size() * sizeof(Triangle);
+				report.triangleCount += geometry.getTriangles().size();
+				for (const Triangle & triangle : geometry.getTriangles())
+				{
+					materials.insert(triangle.material());
+				}
+			}
+			for (auto it = m_restVertices.begin(), end = m_restVertices.end(); it != end; ++it)
+			{
+				report.restVertices += it->second.size() * sizeof(Math::Vector3f);
+			}
+			if (m_bvh != nullptr)
+			{
+				m_bvh->memoryUsage(report.bvhNodeCount, report.bvhLeafCount, report.bvhNodes, report.bvhPrimitives);
+			}
+			report.lights = m_lightBVH.memorySize() + m_emitters.memorySize() + m_photonEmitters.memorySize()
+				+ m_lightShares.size()*(sizeof(const Triangle*) + sizeof(LightShare) + 2 * sizeof(void*));
+			if (m_useLightmap)
+			{
+				report.lightmap = m_lightmap.memorySize();
+				report.lightmapTexelCount = m_lightmap.texelCount();
+			}
+			if (!m_globalPhotons.empty() || !m_causticPhotons.empty())
+			{
+				report.photonMaps = m_globalPhotons.memorySize() + m_causticPhotons.memorySize();
+				report.photonCount = m_globalPhotons.size() + m_causticPhotons.size();
+			}
+			if (!m_radiosity.empty())
+			{
+				report.radiosity = m_radiosity.memorySize();
+				report.radiosityPatches = m_radiosity.patchCount();
+				report.radiosityLinks = m_radiosity.linkCount();
+			}
+			if (m_pathGuiding)
+			{
+				report.pathGuiding = m_guiding.memorySize();
+				report.guidingCells = m_guiding.size();
+			}
+			if (m_irradianceCache.size() > 0)
+			{
+				report.irradianceCache = m_irradianceCache.memorySize();
+				report.irradianceRecordCount = m_irradianceCache.size();
+			}
+			report.emissiveTriangleCount = m_lightBVH.size();
+			::std::set<const Texture*> textures;
+			for (const Material * material : materials)
+			{
+				report.materials += sizeof(Material);
+				if (material->hasTexture() && textures.insert(&material->getTexture()).second)
+				{
+					report.textures += sizeof(Texture) + material->getTexture().memorySize();
+				}
+			}
+			report.materialCount = materials.size();
+			report.textureCount = textures.size();
+			report.framebuffers = m_accumulationBuffer.memorySize() + m_directBuffer.memorySize() + m_denoised.memorySize() + m_features.memorySize();
+			return report;
+		}
+
 		/// <summary>
 		/// Prints stats about the geometry associated with the scene
 		/// </summary>
@@ -99,6 +360,11 @@ namespace Geometry
 				nbTriangles += it->second.getTriangles().size();
 			}
 			::std::cout << "Scene: " << nbTriangles << " triangles" << ::std::endl;
+			memoryReport().print(::std::cout);
+#ifdef Use_SpyCounters
+			// Ray statistics since the beginning of the program
+			Spy::RayCounters::total().print(::std::cout);
+#endif
 		}
 
 		/// <summary>
@@ -138,6 +404,300 @@ namespace Geometry
 			m_lightSamples = number;
 		}
 
+		/// <summary>
+		/// Selects the sampler used for global illumination.
+		/// </summary>
+		/// <param name="qmc">true for Owen scrambled Sobol sequences, false for independent random numbers.</param>
+		/// <param name="seed">The global seed of the Sobol sampler.</param>
+		void setQuasiMonteCarlo(bool qmc, unsigned int seed = 0)
+		{
+			m_GI_qmc = qmc;
+			m_samplerSeed = seed;
+		}
+
+		/// <summary>
+		/// Selects the path tracer used for global illumination.
+		/// </summary>
+		/// <param name="iterative">true for Scene::pathTracingIterative, false for the recursive Scene::pathTracing.</param>
+		/// <param name="rouletteDepth">The number of bounces of the iterative path tracer before the russian roulette starts.</param>
+		void setIterativePathTracing(bool iterative, int rouletteDepth = 3)
+		{
+			m_GI_iterative = iterative;
+			m_rouletteDepth = rouletteDepth;
+		}
+
+		/// <summary>
+		/// Enables the multiple importance sampling of the direct lighting in the iterative path tracer (see
+		/// Scene::pathTracingIterative). Without it, the direct lighting is computed by Scene::phongDirect.
+		/// </summary>
+		void setMultipleImportanceSampling(bool mis)
+		{
+			m_GI_mis = mis;
+		}
+
+		/// <summary>
+		/// Enables the irradiance caching render mode (see Scene::irradianceCaching): the indirect diffuse lighting
+		/// is interpolated between sparse records instead of being traced for each sample. Suited to diffuse scenes
+		/// where the indirect lighting is smooth. Requires the surface lights and the indirect lighting.
+		/// </summary>
+		/// <param name="enable">Enables the render mode.</param>
+		/// <param name="accuracy">The maximum error of the records used by a point (lower: more records).</param>
+		/// <param name="gatherRays">The number of rays gathering the irradiance of a record.</param>
+		void setIrradianceCache(bool enable, double accuracy = 0.2, int gatherRays = 64)
+		{
+			m_irradianceCaching = enable;
+			m_irradianceAccuracy = accuracy;
+			m_irradianceRays = gatherRays;
+		}
+
+		/// <summary>
+		/// Enables the photon mapping render mode (see Scene::photonMapping): before the first pass, photons are shot
+		/// from the emissive triangles and stored in a global and a caustic photon map, then the indirect lighting
+		/// of the samples is estimated from the density of the photons. Suited to caustics, which the path tracers
+		/// hardly converge. Requires the surface lights and the indirect lighting.
+		/// </summary>
+		/// <param name="enable">Enables the render mode.</param>
+		/// <param name="photons">The number of photons emitted for the global photon map.</param>
+		/// <param name="causticPhotons">The number of photons emitted for the caustic photon map.</param>
+		/// <param name="gather">The number of photons of a radiance estimate.</param>
+		void setPhotonMapping(bool enable, int photons = 200000, int causticPhotons = 200000, int gather = 64)
+		{
+			m_photonMapping = enable;
+			m_photonCount = photons;
+			m_causticPhotonCount = causticPhotons;
+			m_photonGather = ::std::min(::std::max(gather, 1), (int)PhotonMap::maxGather);
+		}
+
+		/// <summary>
+		/// Enables the radiosity render mode (see Scene::radiosityShading): the diffuse interreflections between the
+		/// triangles are solved once by hierarchical radiosity (see Radiosity), then the samples only cast their
+		/// primary ray and look the solution up. The solution does not depend on the camera, it is kept by the
+		/// following renderings until the geometries change. Suited to the purely diffuse scenes (the glossy lobes
+		/// are ignored), lit by their emissive triangles.
+		/// </summary>
+		/// <param name="enable">Enables the render mode.</param>
+		/// <param name="accuracy">A link between two patches is refined if it transports more than this ratio of the
+		/// emitted power.</param>
+		void setRadiosity(bool enable, double accuracy = 1e-4)
+		{
+			if (accuracy != m_radiosityAccuracy) { m_radiosity.clear(); }
+			m_radiosityEnabled = enable;
+			m_radiosityAccuracy = accuracy;
+		}
+
+		/// <summary>
+		/// Solves the radiosity of the scene for the radiosity render mode (see Scene::setRadiosity). The form factors
+		/// are computed in parallel, their visibility is tested with the BVH.
+		/// If the scene has too many triangles (see Radiosity::maxTriangles), the radiosity render mode is disabled.
+		/// </summary>
+		/// <param name="maxDepth">The maximum depth of the paths: the number of bounces of the solution is maxDepth+1.</param>
+		void solveRadiosity(int maxDepth)
+		{
+			TraceScope("Radiosity", "render");
+			if (m_bvh == nullptr || m_bvhDirty)
+			{
+				buildBVH();
+			}
+			double power = 0.0;
+			for (const ::std::pair<BoundingBox, Geometry> & geometry : m_geometries)
+			{
+				for (const Triangle & triangle : geometry.second.getTriangles())
+				{
+					power += 2.0*Math::pi*triangle.material()->getEmissive().grey()*triangle.surface();
+				}
+			}
+			// The patches are not split below the texels of the default lightmap
+			const double texelSize = (m_sceneBoundingBox.max() - m_sceneBoundingBox.min()).norm() / 256.0;
+			System::Clock clock;
+			if (!m_radiosity.solve(m_geometries, [this](Math::Vector3f const & from, Math::Vector3f const & to, const Triangle * target) {
+				return visible(from, to, target);
+			}, maxDepth + 1, m_radiosityAccuracy*power, texelSize*texelSize*0.5))
+			{
+				::std::cerr << "Radiosity: disabled, the scene is rendered by path tracing" << ::std::endl;
+				m_radiosityEnabled = false;
+				return;
+			}
+			::std::cout << "Radiosity: solved in " << clock.elapsed() << " s" << ::std::endl;
+		}
+
+		/// <summary>
+		/// Enables the path guiding of the iterative path tracer with multiple importance sampling: the directions of
+		/// the diffuse surfaces are sampled from a mixture of their BSDF and of a distribution of the incident
+		/// radiance learnt from the previous passes (see GuidingField). Scene::compute trains the distributions during
+		/// iterations of 1, 2, 4... passes, until the next iteration would exceed half of the passes, then renders
+		/// with the last learnt distributions. All the passes are accumulated (the estimator is unbiased whatever
+		/// the distributions). Suited to the indirect lighting coming through small openings.
+		/// </summary>
+		/// <param name="enable">Enables the path guiding.</param>
+		/// <param name="probability">The probability of sampling the learnt distribution rather than the BSDF.</param>
+		void setPathGuiding(bool enable, double probability = 0.5)
+		{
+			m_pathGuiding = enable;
+			m_guidingProbability = ::std::min(::std::max(probability, 0.0), 1.0);
+		}
+
+		/// <summary>
+		/// Bakes the diffuse irradiance (direct and indirect) of the triangles of the scene in the lightmap, then the
+		/// renderings look it up and only trace the glossy paths (see Scene::lightmapped). The scene must be static.
+		/// The lattice points are computed in parallel, slightly inside their triangle to avoid the shadows of the
+		/// adjacent geometry along the edges.
+		/// </summary>
+		/// <param name="maxDepth">The maximum depth of the paths.</param>
+		/// <param name="samples">The number of samples per lattice point and per side.</param>
+		/// <param name="texelSize">The distance between the lattice points (0: 1/256 of the scene diagonal).</param>
+		void bakeLightmap(int maxDepth, int samples = 256, double texelSize = 0.0)
+		{
+			TraceScope("Lightmap", "render");
+			if (m_bvh == nullptr || m_bvhDirty)
+			{
+				buildBVH();
+			}
+			if (texelSize <= 0.0) { texelSize = (m_sceneBoundingBox.max() - m_sceneBoundingBox.min()).norm() / 256.0; }
+			m_lightmap.build(m_geometries, texelSize);
+			System::Clock clock;
+			::std::cout << "Lightmap: baking " << m_lightmap.texelCount() << " texels (" << samples << " samples per side)" << ::std::endl;
+			const double inset = 0.01;
+#pragma omp parallel for schedule(dynamic)
+			for (int index = 0; index < (int)m_lightmap.size(); ++index)
+			{
+				const Triangle & triangle = *m_lightmap.triangle(index);
+				const int resolution = m_lightmap.resolution(index);
+				for (int i = 0; i <= resolution && resolution > 0; ++i)
+				{
+					for (int j = 0; i + j <= resolution; ++j)
+					{
+						const double u = (double)i / resolution*(1.0 - inset) + inset / 3.0;
+						const double v = (double)j / resolution*(1.0 - inset) + inset / 3.0;
+						m_lightmap.set(index, Lightmap::Front, i, j, bakeIrradiance(triangle, u, v, Lightmap::Front, maxDepth, samples));
+						m_lightmap.set(index, Lightmap::Back, i, j, bakeIrradiance(triangle, u, v, Lightmap::Back, maxDepth, samples));
+					}
+				}
+			}
+			::std::cout << "Lightmap: baked in " << clock.elapsed() << " s" << ::std::endl;
+			m_useLightmap = true;
+		}
+
+		/// <summary>
+		/// Saves the lightmap computed by Scene::bakeLightmap.
+		/// </summary>
+		bool saveLightmap(const ::std::string & filename) const
+		{
+			return m_useLightmap && m_lightmap.save(filename);
+		}
+
+		/// <summary>
+		/// Loads a lightmap baked for this scene and renders with it (see Scene::bakeLightmap).
+		/// </summary>
+		/// <returns>false if the lightmap is invalid or has been baked for another scene.</returns>
+		bool loadLightmap(const ::std::string & filename)
+		{
+			m_useLightmap = m_lightmap.load(filename, m_geometries);
+			return m_useLightmap;
+		}
+
+		/// <summary>
+		/// Enables the periodic checkpointing of Scene::compute.
+		/// </summary>
+		/// <param name="filename">The checkpoint file.</param>
+		/// <param name="interval">The time between two checkpoints (in seconds).</param>
+		/// <param name="resume">If true and the file matches the rendering parameters, the rendering is resumed from it.</param>
+		void setCheckpoint(const ::std::string & filename, double interval = 300.0, bool resume = false)
+		{
+			m_checkpointFile = filename;
+			m_checkpointInterval = interval;
+			m_resume = resume;
+		}
+
+		/// <summary>
+		/// Returns the checkpoint file of Scene::compute (empty if the checkpointing is disabled).
+		/// </summary>
+		const ::std::string & getCheckpointFile() const
+		{
+			return m_checkpointFile;
+		}
+
+		/// <summary>
+		/// Changes the checkpoint file of Scene::compute, keeping the interval and the resume flag (see Scene::setCheckpoint).
+		/// </summary>
+		void setCheckpointFile(const ::std::string & filename)
+		{
+			m_checkpointFile = filename;
+		}
+
+		/// <summary>
+		/// Sets the criteria stopping Scene::compute before its number of passes, the first reached one stops the rendering.
+		/// The time budget covers the whole call of Scene::compute (BVH, irradiance cache, photon maps, radiosity and passes)
+		/// but the final denoising. At least one pass is rendered, even if the preparation exceeds the budget.
+		/// </summary>
+		/// <param name="timeBudget">The wall clock budget in seconds, no pass is started if it is expected to end after the budget (0: no limit).</param>
+		/// <param name="noiseTarget">The relative noise of the image to reach (0: no target, see AccumulationBuffer::noise).</param>
+		void setStoppingCriteria(double timeBudget, double noiseTarget)
+		{
+			m_timeBudget = timeBudget;
+			m_noiseTarget = noiseTarget;
+		}
+
+		/// <summary>
+		/// Enables the progressive resolution preview: the first pass is computed at 1/8, 1/4, 1/2 and then full
+		/// resolution, coarse pixels being displayed as blocks until they are refined. Each level only computes the
+		/// pixels missing from the previous ones, so the preview costs exactly one pass and the image is unchanged.
+		/// </summary>
+		void setPreview(bool preview)
+		{
+			m_preview = preview;
+		}
+
+		/// <summary>
+		/// Enables the denoising of the image at the end of Scene::compute (see Scene::getImage).
+		/// </summary>
+		void setDenoiser(bool enable, Denoiser const & denoiser = Denoiser())
+		{
+			m_denoise = enable;
+			m_denoiser = denoiser;
+		}
+
+		/// <summary>
+		/// Enables the auxiliary buffers computed along the image: the features of the primary hits (see Geometry::FeatureBuffer)
+		/// and the split of the radiance into direct and indirect lighting (see Scene::saveAuxiliaryBuffers).
+		/// </summary>
+		void setAuxiliaryBuffers(bool enable)
+		{
+			m_aovs = enable;
+		}
+
+		bool auxiliaryBuffers() const
+		{ return m_aovs; }
+
+		/// <summary>
+		/// Sets the traversal cost render mode: Scene::compute renders the cost of the BVH traversals of each pixel
+		/// as a false color image instead of the radiance (a metric of Heatmap::None renders the radiance).
+		/// </summary>
+		void setHeatmap(Heatmap const & heatmap)
+		{
+			m_heatmap = heatmap;
+		}
+
+		/// <summary>
+		/// Saves the auxiliary buffers of the last call to Scene::compute next to an image (see FeatureBuffer::save):
+		/// the features, image.direct.pfm (emission and direct lighting at the first hit) and image.indirect.pfm (the rest).
+		/// </summary>
+		/// <returns>true if all the files have been written.</returns>
+		bool saveAuxiliaryBuffers(const ::std::string & imageFilename) const
+		{
+			AccumulationBuffer indirect(m_accumulationBuffer.width(), m_accumulationBuffer.height());
+			for (int y = 0; y < indirect.height(); ++y)
+			{
+				for (int x = 0; x < indirect.width(); ++x)
+				{
+					indirect.add(x, y, m_accumulationBuffer.mean(x, y) + m_directBuffer.mean(x, y)*-1.0);
+				}
+			}
+			bool result = m_features.save(imageFilename);
+			result &= m_directBuffer.savePFM(FeatureBuffer::auxiliaryFilename(imageFilename, "direct"));
+			result &= indirect.savePFM(FeatureBuffer::auxiliaryFilename(imageFilename, "indirect"));
+			return result;
+		}
+
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	void Scene::add(const Geometry & geometry)
 		///
@@ -153,7 +713,10 @@ namespace Geometry
 			if (geometry.getVertices().size() == 0) { return; }
 			BoundingBox box(geometry) ;
 			m_geometries.push_back(::std::make_pair(box, geometry)) ;
+			System::Clock normalsClock;
 			m_geometries.back().second.computeVertexNormals(Math::piDiv4/2);
+			m_normalsTime += normalsClock.elapsed();
+			m_bvhDirty = true;
 			if (m_geometries.size() == 1)
 			{
 				m_sceneBoundingBox = box;
@@ -192,7 +755,18 @@ namespace Geometry
 		void add(LightSource *light)
 		{
 			m_lightSampler.push_back(light);
-			add(*light);			
+			const size_t index = m_geometries.size();
+			add(*light);
+			if (m_geometries.size() > index) { m_lightSourceGeometries[index] = m_lightSampler.size() - 1; }
+		}
+
+		/// <summary>
+		/// True if Scene::phongDirect samples the emission of a triangle (emissive geometries which are not part of a
+		/// light source): a path reaching it after a bounce must not add this emission again.
+		/// </summary>
+		bool sampledByPhongDirect(const Triangle * triangle) const
+		{
+			return m_GI_surface && !triangle->material()->getEmissive().isBlack() && m_emitters.pdfArea(triangle) > 0.0;
 		}
 
 		////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -210,6 +784,59 @@ namespace Geometry
 			m_camera = cam ;
 		}
 
+		/// <summary>
+		/// Returns the camera.
+		/// </summary>
+		const Camera & getCamera() const
+		{
+			return m_camera;
+		}
+
+		/// <summary>
+		/// Returns the number of geometries (meshes) of the scene, in the order of Scene::add.
+		/// </summary>
+		size_t geometryCount() const
+		{
+			return m_geometries.size();
+		}
+
+		/// <summary>
+		/// Places a geometry: the transform is applied to the geometry as it was when first moved (rest pose),
+		/// so transforms do not accumulate. Vertex normals, bounding boxes are updated and the BVH is rebuilt
+		/// by the next Scene::compute. Setting the current transform again does nothing. Note that surface
+		/// lights (LightSource) keep sampling their own triangles.
+		/// </summary>
+		/// <param name="index">The index of the geometry (see Scene::geometryCount).</param>
+		/// <param name="transform">The transform of the rest pose.</param>
+		void setGeometryTransform(size_t index, MeshTransform const & transform)
+		{
+			if (index >= m_geometries.size()) { return; }
+			auto current = m_geometryTransforms.find(index);
+			if (current != m_geometryTransforms.end() && current->second == transform) { return; }
+			if (current == m_geometryTransforms.end() && transform == MeshTransform()) { return; }
+			Geometry & geometry = m_geometries[index].second;
+			auto rest = m_restVertices.find(index);
+			if (rest == m_restVertices.end())
+			{
+				rest = m_restVertices.insert(::std::make_pair(index, geometry.getVertices())).first;
+			}
+			::std::deque<Math::Vector3f> vertices(rest->second.size());
+			for (size_t cpt = 0; cpt < vertices.size(); ++cpt)
+			{
+				vertices[cpt] = transform.apply(rest->second[cpt]);
+			}
+			geometry.setVertices(vertices);
+			geometry.computeVertexNormals(Math::piDiv4 / 2);
+			m_geometryTransforms[index] = transform;
+			m_geometries[index].first = BoundingBox(geometry);
+			m_sceneBoundingBox = m_geometries.front().first;
+			for (auto it = m_geometries.begin(), end = m_geometries.end(); it != end; ++it)
+			{
+				m_sceneBoundingBox.update(it->first);
+			}
+			m_bvhDirty = true;
+		}
+
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	RGBColor Scene::sendRay(Ray const & ray, double limit, int depth, int maxDepth)
 		///
@@ -224,7 +851,7 @@ namespace Geometry
 		///
 		/// \return	The computed color.
 		////////////////////////////////////////////////////////////////////////////////////////////////////
-		RGBColor sendRay(Ray const & ray, int depth, int maxDepth, int diffuseSamples, int specularSamples)
+		RGBColor sendRay(Ray const & ray, int depth, int maxDepth, int diffuseSamples, int specularSamples, RGBColor * direct = nullptr)
 		{
 			RGBColor I(0.0, 0.0, 0.0);
 			double krefl = 0.1;
@@ -246,17 +873,23 @@ namespace Geometry
 				RGBColor ia = cray.intersectionFound().triangle()->material()->getAmbient();
 
 				//On ne prend pas en compte ia dans les calculs car elle fausse le r�sultat pour (au moins) sombrero et robot
-				I = ie + phongDirect(cray) + reflection(cray, depth + 1, maxDepth, diffuseSamples, specularSamples, krefl);//+ sendRay(r_refraction, depth + 1, maxDepth, diffuseSamples, specularSamples) * krefr;
+				RGBColor local = ie + phongDirect(cray);
+				I = local + reflection(cray, depth + 1, maxDepth, diffuseSamples, specularSamples, krefl);//+ sendRay(r_refraction, depth + 1, maxDepth, diffuseSamples, specularSamples) * krefr;
 				//texture
 				RGBColor stexture = cray.intersectionFound().triangle()->sampleTexture(cray.intersectionFound().uTriangleValue(), cray.intersectionFound().vTriangleValue());
 				I = I * stexture;
+				if (direct != nullptr) { *direct = local * stexture; }
 			}
+			else if (direct != nullptr) { *direct = RGBColor(); }
 			return I;
 		}
 
 
 		
-		RGBColor pathTracing(Ray const & ray,int depth,int maxDepth, int diffuseSamples, int specularSamples)
+		/// <summary>
+		/// Path tracing. If direct is provided, it receives the emitted and directly reflected light at the first hit.
+		/// </summary>
+		RGBColor pathTracing(Ray const & ray,int depth,int maxDepth, int diffuseSamples, int specularSamples, Math::PixelSampler const & sampler, RGBColor * direct = nullptr)
 		{
 			//step 0 : init
 			CastedRay cray = CastedRay(ray);
@@ -265,9 +898,11 @@ namespace Geometry
 			//step 1 : intersection find
 			if (cray.validIntersectionFound()) {
 				//Generate uniform random p to bounce the ray or not - russian roulette
-				double p = ((double)rand() / (RAND_MAX));
+				double p = sampler.get(depth, Math::PixelSampler::Roulette);
 				double absorption = 1 - p;
-				RGBColor Le = cray.intersectionFound().triangle()->material()->getEmissive();
+				// The emission sampled by the direct lighting of the previous hit is not counted again
+				const Triangle * triangle = cray.intersectionFound().triangle();
+				RGBColor Le = (depth == 0 || !sampledByPhongDirect(triangle)) ? triangle->material()->getEmissive() : RGBColor();
 				RGBColor stexture = cray.intersectionFound().triangle()->sampleTexture(cray.intersectionFound().uTriangleValue(), cray.intersectionFound().vTriangleValue());
 
 				if (p < absorption) {
@@ -281,48 +916,755 @@ namespace Geometry
 					RGBColor rayColorSum(0.0, 0.0, 0.0);
 					for (int i = 0; i < nbRay; i++)
 					{
-						CastedRay randomRay = CastedRay(source, rdirection.generate());
-						RGBColor rayColor = pathTracing(randomRay, depth, maxDepth, diffuseSamples, specularSamples) *absorption;
+						CastedRay randomRay = CastedRay(source, rdirection.generate(sampler, depth));
+						SpyCount(rays[Spy::RayCounters::Diffuse]);
+						RGBColor rayColor = pathTracing(randomRay, depth + 1, maxDepth, diffuseSamples, specularSamples, sampler) *absorption;
 						
 						rayColorSum = rayColorSum + rayColor / nbRay;
 					}
 
-					return Le + phongDirect(cray)*stexture+rayColorSum;
+					RGBColor local = Le + phongDirect(cray, &sampler, depth)*stexture;
+					if (direct != nullptr) { *direct = local; }
+					return local + rayColorSum;
 				}
 				else {
 					//step 3 - stop recuression 
-					return Le + phongDirect(cray)*stexture;
+					SpyPathDepth(depth);
+					RGBColor local = Le + phongDirect(cray, &sampler, depth)*stexture;
+					if (direct != nullptr) { *direct = local; }
+					return local;
 				}
 			}
 			else {
+				SpyPathDepth(depth);
+				if (direct != nullptr) { *direct = RGBColor(); }
 				return RGBColor(0.0, 0.0, 0.0); //background color
 			}
 		}
 
-		RGBColor phongDirect(CastedRay const &cray) {
+		/// <summary>
+		/// Iterative path tracing: each vertex adds its emitted and directly reflected light weighted by the throughput
+		/// of the path, then the path continues in a cosine distributed direction and its throughput is multiplied by
+		/// the diffuse reflectance (with texture) of the surface. After rouletteDepth bounces, the path survives the
+		/// russian roulette with a probability equal to its largest throughput component (capped to 1) and the
+		/// throughput is divided by this probability. The path never exceeds maxDepth bounces, so the stack use does
+		/// not depend on the path length. If direct is provided, it receives the emitted and directly reflected light
+		/// at the first hit.
+		/// With multiple importance sampling (see Scene::setMultipleImportanceSampling), the surfaces use their Phong
+		/// BSDF: the direct lighting combines a point sampled on the emissive triangles (Scene::directLighting) with
+		/// the BSDF sampled direction continuing the path, which adds the emission of the triangle it hits. Both are
+		/// weighted by the power heuristic so that the light is not counted twice.
+		/// Without it, the emission of the triangles hit after the first bounce is ignored when Scene::phongDirect
+		/// already samples them (see Scene::sampledByPhongDirect), otherwise it would be counted twice.
+		/// </summary>
+		/// <param name="emission">false to ignore the emission of the first hit.</param>
+		/// <param name="distance">If provided, receives the distance of the first hit (infinity if the ray escapes).</param>
+		RGBColor pathTracingIterative(Ray const & ray, int maxDepth, Math::PixelSampler const & sampler, RGBColor * direct = nullptr, bool emission = true, double * distance = nullptr)
+		{
+			const bool mis = m_GI_mis && m_GI_surface;
 			RGBColor result(0.0, 0.0, 0.0);
-			
-			//Global Illumination
-			if (m_GI_surface) {
-
-				for (LightSource * source : m_lightSampler) {
-				
-					PointLight light = source->generate();
-					if (!phongShadow(cray, light)) {
-						//pas dans l'ombre donc on calcule
-						result = result + (phongDiffuse(cray, light) + phongSpecular(cray, light))*light.color();
-						}
-					
+			RGBColor throughput(1.0, 1.0, 1.0);
+			// The vertices of a training path of the path guiding
+			const bool training = m_guidingTraining && mis;
+			GuidingField::Vertex vertices[GuidingField::maxVertices];
+			int recorded = 0;
+			// The density of the BSDF sampled direction of the current ray (0 for the primary ray) and the normal at its origin
+			double bsdfDensity = 0.0;
+			Math::Vector3f originNormal;
+			CastedRay cray(ray);
+			if (direct != nullptr) { *direct = RGBColor(); }
+			if (distance != nullptr) { *distance = ::std::numeric_limits<double>::infinity(); }
+			for (int depth = 0;; ++depth)
+			{
+				optim(cray, "BVH");
+				if (!cray.validIntersectionFound())
+				{
+					SpyPathDepth(depth);
+					break;
 				}
-			}
+				const RayTriangleIntersection & hit = cray.intersectionFound();
+				const Triangle * triangle = hit.triangle();
+				if (depth == 0 && distance != nullptr) { *distance = hit.tRayValue(); }
+				RGBColor stexture = triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+				const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+				const RGBColor emissive = (depth > 0 || emission) ? triangle->material()->getEmissive() : RGBColor();
+				RGBColor local;
+				if (mis)
+				{
+					PhongBSDF bsdf(*triangle->material(), stexture, N, cray.direction());
+					const Math::DirectionalQuadtree * guide = guidingDistribution(hit.intersection(), bsdf);
+					local = emissive * stexture * emissionWeight(cray, originNormal, bsdfDensity) + directLighting(cray, bsdf, sampler, depth, guide);
+					if (depth == 0 && direct != nullptr) { *direct = local; }
+					result = result + throughput*local;
+					for (int cpt = 0; cpt < recorded; ++cpt) { vertices[cpt].radiance = vertices[cpt].radiance + throughput*local; }
+					if (depth >= maxDepth)
+					{
+						SpyPathDepth(depth);
+						break;
+					}
+					Math::Vector3f next;
+					RGBColor weight;
+					::std::pair<double, double> xi = sampler.get2D(depth, Math::PixelSampler::BsdfDirection);
+					if (!sampleScattering(bsdf, guide, xi.first, xi.second, next, weight, bsdfDensity))
+					{
+						SpyPathDepth(depth);
+						break;
+					}
+					throughput = throughput*weight;
+					if (!continuePath(throughput, depth, sampler))
+					{
+						SpyPathDepth(depth);
+						break;
+					}
+					if (training && recorded < GuidingField::maxVertices && !bsdf.diffuse().isBlack())
+					{
+						GuidingField::Vertex vertex = { hit.intersection(), next, bsdfDensity, throughput, RGBColor() };
+						vertices[recorded++] = vertex;
+					}
+					originNormal = bsdf.normal();
+					cray = CastedRay(hit.intersection(), next);
+				}
+				else
+				{
+					local = ((depth == 0 || !sampledByPhongDirect(triangle)) ? emissive : RGBColor()) + phongDirect(cray, &sampler, depth)*stexture;
+					if (depth == 0 && direct != nullptr) { *direct = local; }
+					result = result + throughput*local;
 
-			//Classic Raytracing
-			else {
-				//On verifie pour chaque lumiere si celle si eclaire notre point d'intersection
-				for (const PointLight & light : m_lights) {
-					if (!phongShadow(cray, light)) {
-						//pas dans l'ombre donc on calcule
-						result = result + (phongDiffuse(cray, light) + phongSpecular(cray, light))*light.color();
+					// Hard cap of the path length
+					if (depth >= maxDepth)
+					{
+						SpyPathDepth(depth);
+						break;
+					}
+					throughput = throughput*triangle->material()->getDiffuse()*stexture;
+					if (!continuePath(throughput, depth, sampler))
+					{
+						SpyPathDepth(depth);
+						break;
+					}
+
+					// Next vertex
+					Math::RandomDirection rdirection(N.normalized());
+					cray = CastedRay(hit.intersection(), rdirection.generate(sampler, depth));
+				}
+				SpyCount(rays[Spy::RayCounters::Diffuse]);
+			}
+			if (recorded > 0) { m_guiding.record(vertices, recorded); }
+			return result;
+		}
+
+		/// <summary>
+		/// The learnt distribution of the incident radiance guiding the directions of a surface point, nullptr if the
+		/// path guiding is disabled, if nothing has been learnt at the point or if the surface is not diffuse (the
+		/// glossy lobes are narrower than the cells of the distributions).
+		/// </summary>
+		const Math::DirectionalQuadtree * guidingDistribution(Math::Vector3f const & position, PhongBSDF const & bsdf) const
+		{
+			if (!m_pathGuiding || bsdf.diffuse().isBlack()) { return nullptr; }
+			return m_guiding.distribution(position);
+		}
+
+		/// <summary>
+		/// The solid angle density of Scene::sampleScattering for a direction (normalized).
+		/// </summary>
+		double scatteringDensity(PhongBSDF const & bsdf, const Math::DirectionalQuadtree * guide, Math::Vector3f const & direction) const
+		{
+			if (guide == nullptr) { return bsdf.pdf(direction); }
+			return m_guidingProbability*guide->pdf(direction) + (1.0 - m_guidingProbability)*bsdf.pdf(direction);
+		}
+
+		/// <summary>
+		/// Samples the direction continuing a path: from the BSDF or, with path guiding, from the mixture of the learnt
+		/// distribution and of the BSDF (the first value also selects the strategy).
+		/// </summary>
+		/// <param name="direction">Receives the direction.</param>
+		/// <param name="weight">Receives BSDF*cos/density.</param>
+		/// <param name="density">Receives the solid angle density of the direction (see Scene::scatteringDensity).</param>
+		/// <returns>false if the sampled direction is below the surface.</returns>
+		bool sampleScattering(PhongBSDF const & bsdf, const Math::DirectionalQuadtree * guide, double xi1, double xi2, Math::Vector3f & direction, RGBColor & weight, double & density) const
+		{
+			if (guide == nullptr) { return bsdf.sample(xi1, xi2, direction, weight, density); }
+			if (bsdf.isBlack()) { return false; }
+			if (xi1 < m_guidingProbability)
+			{
+				double guideDensity;
+				direction = guide->sample(xi1 / m_guidingProbability, xi2, guideDensity).normalized();
+			}
+			else
+			{
+				double bsdfDensity;
+				if (!bsdf.sample((xi1 - m_guidingProbability) / (1.0 - m_guidingProbability), xi2, direction, weight, bsdfDensity)) { return false; }
+			}
+			const double cosine = bsdf.normal()*direction;
+			density = scatteringDensity(bsdf, guide, direction);
+			if (cosine <= 0.0 || density <= 0.0) { return false; }
+			weight = bsdf.eval(direction)*(cosine / density);
+			return true;
+		}
+
+		/// <summary>
+		/// The russian roulette of Scene::pathTracingIterative: after rouletteDepth bounces, the path survives with a
+		/// probability equal to its largest throughput component (capped to 1) and its throughput is divided by
+		/// this probability. Before, only paths with a black throughput are stopped.
+		/// </summary>
+		/// <returns>true if the path continues.</returns>
+		bool continuePath(RGBColor & throughput, int depth, Math::PixelSampler const & sampler) const
+		{
+			if (depth < m_rouletteDepth) { return !throughput.isBlack(); }
+			double survival = ::std::min(1.0, ::std::max(throughput[0], ::std::max(throughput[1], throughput[2])));
+			if (sampler.get(depth, Math::PixelSampler::Roulette) >= survival) { return false; }
+			throughput = throughput / survival;
+			return true;
+		}
+
+		/// <summary>
+		/// The multiple importance sampling weight of the emission of a hit reached by a BSDF sampled direction of
+		/// density bsdfDensity from a point of normal originNormal (primary rays have a null density and their
+		/// emission has weight 1).
+		/// </summary>
+		double emissionWeight(CastedRay const & cray, Math::Vector3f const & originNormal, double bsdfDensity) const
+		{
+			if (bsdfDensity <= 0.0) { return 1.0; }
+			const RayTriangleIntersection & hit = cray.intersectionFound();
+			double pdfArea = m_lightBVH.pdfArea(cray.source(), originNormal, hit.triangle());
+			if (pdfArea <= 0.0) { return 1.0; }
+			double cosine = ::std::abs(hit.triangle()->normal()*cray.direction());
+			if (cosine <= 0.0) { return 0.0; }
+			double distance = hit.tRayValue();
+			double lightDensity = pdfArea*distance*distance / cosine;
+			return PhongBSDF::powerHeuristic(bsdfDensity, lightDensity);
+		}
+
+		/// <summary>
+		/// Direct lighting at the intersection by light sampling: one point on the emissive triangles, chosen with the
+		/// light hierarchy and the light dimensions of the pixel sampler at the given depth, weighted by the power
+		/// heuristic against the BSDF sampling.
+		/// </summary>
+		RGBColor directLighting(CastedRay const & cray, PhongBSDF const & bsdf, Math::PixelSampler const & sampler, int depth, const Math::DirectionalQuadtree * guide = nullptr)
+		{
+			RGBColor result(0.0, 0.0, 0.0);
+			if (bsdf.isBlack()) { return result; }
+			const Math::Vector3f position = cray.intersectionFound().intersection();
+			::std::pair<double, double> xi = sampler.get2D(depth, Math::PixelSampler::LightPosition);
+			LightBVH::Sample sample;
+			if (!m_lightBVH.sample(position, bsdf.normal(), sampler.get(depth, Math::PixelSampler::LightChoice), xi.first, xi.second, sample)) { return result; }
+			Math::Vector3f toLight = sample.point - position;
+			double distance = toLight.norm();
+			if (distance <= 0.0 || sample.pdfArea <= 0.0) { return result; }
+			toLight = toLight / distance;
+			double lightCosine = ::std::abs(sample.normal*toLight);
+			RGBColor f = bsdf.eval(toLight);
+			if (lightCosine <= 0.0 || f.isBlack()) { return result; }
+			if (phongShadow(cray, PointLight(sample.point, sample.emission))) { return result; }
+			double lightDensity = sample.pdfArea*distance*distance / lightCosine;
+			double cosine = ::std::abs(bsdf.normal()*toLight);
+			double weight = PhongBSDF::powerHeuristic(lightDensity, scatteringDensity(bsdf, guide, toLight));
+			return f*sample.emission*(cosine*weight / lightDensity);
+		}
+
+		/// <summary>
+		/// Irradiance caching (see Scene::setIrradianceCache): the emitted light and the direct lighting of the first
+		/// hit are computed for each sample (multiple importance sampling of a light sample and of a BSDF direction
+		/// only counting the emission it reaches), its indirect diffuse lighting is interpolated from the irradiance
+		/// cache (Scene::indirectIrradiance) and its glossy lobe is path traced. If direct is provided, it receives
+		/// the emitted and directly reflected light at the first hit.
+		/// </summary>
+		RGBColor irradianceCaching(Ray const & ray, int maxDepth, Math::PixelSampler const & sampler, RGBColor * direct = nullptr)
+		{
+			CastedRay cray(ray);
+			optim(cray, "BVH");
+			if (direct != nullptr) { *direct = RGBColor(); }
+			SpyPathDepth(0);
+			if (!cray.validIntersectionFound()) { return RGBColor(); }
+			const RayTriangleIntersection & hit = cray.intersectionFound();
+			const Triangle * triangle = hit.triangle();
+			RGBColor stexture = triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+			const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+			PhongBSDF bsdf(*triangle->material(), stexture, N, cray.direction());
+			RGBColor local = triangle->material()->getEmissive()*stexture + directLighting(cray, bsdf, sampler, 0);
+			Math::Vector3f next;
+			RGBColor weight;
+			double density;
+			::std::pair<double, double> xi = sampler.get2D(0, Math::PixelSampler::BsdfDirection);
+			if (bsdf.sample(xi.first, xi.second, next, weight, density))
+			{
+				local = local + sampledEmission(hit.intersection(), bsdf.normal(), next, density)*weight;
+			}
+			if (direct != nullptr) { *direct = local; }
+			if (maxDepth < 1) { return local; }
+			RGBColor result = local;
+			if (!bsdf.diffuse().isBlack())
+			{
+				result = result + bsdf.diffuse()*indirectIrradiance(hit.intersection(), bsdf.normal(), maxDepth)*(1.0 / Math::pi);
+			}
+			// The glossy direction uses the BSDF dimensions of the second bounce and its path the following ones. The
+			// emission it reaches is part of the direct lighting.
+			xi = sampler.get2D(1, Math::PixelSampler::BsdfDirection);
+			if (bsdf.sampleSpecular(xi.first, xi.second, next, weight))
+			{
+				SpyCount(rays[Spy::RayCounters::Reflection]);
+				result = result + weight*pathTracingIterative(Ray(hit.intersection(), next), maxDepth - 1, Math::ShiftedPixelSampler(sampler, 2), nullptr, false);
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// The emission reached from a surface point by a BSDF sampled direction of the given density, weighted by the
+		/// power heuristic against Scene::directLighting.
+		/// </summary>
+		RGBColor sampledEmission(Math::Vector3f const & position, Math::Vector3f const & normal, Math::Vector3f const & direction, double density)
+		{
+			CastedRay emission(position, direction);
+			optim(emission, "BVH");
+			if (!emission.validIntersectionFound()) { return RGBColor(); }
+			const RayTriangleIntersection & light = emission.intersectionFound();
+			RGBColor emitted = light.triangle()->material()->getEmissive();
+			if (emitted.isBlack()) { return emitted; }
+			return emitted*light.triangle()->sampleTexture(light.uTriangleValue(), light.vTriangleValue())*emissionWeight(emission, normal, density);
+		}
+
+		/// <summary>
+		/// Lightmap rendering (see Scene::bakeLightmap): the diffuse lighting of the first hit is looked up in the
+		/// lightmap, its glossy lobe is path traced (the emission it reaches included). The triangles missing from the
+		/// lightmap are path traced. If direct is provided, it receives the emitted and diffuse light at the first hit.
+		/// </summary>
+		RGBColor lightmapped(Ray const & ray, int maxDepth, Math::PixelSampler const & sampler, RGBColor * direct = nullptr)
+		{
+			CastedRay cray(ray);
+			optim(cray, "BVH");
+			if (direct != nullptr) { *direct = RGBColor(); }
+			if (!cray.validIntersectionFound())
+			{
+				SpyPathDepth(0);
+				return RGBColor();
+			}
+			const RayTriangleIntersection & hit = cray.intersectionFound();
+			const Triangle * triangle = hit.triangle();
+			RGBColor stexture = triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+			const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+			PhongBSDF bsdf(*triangle->material(), stexture, N, cray.direction());
+			RGBColor local = triangle->material()->getEmissive()*stexture;
+			if (!bsdf.diffuse().isBlack())
+			{
+				RGBColor irradiance;
+				const Lightmap::Side side = (N*triangle->normal() >= 0.0) ? Lightmap::Front : Lightmap::Back;
+				if (!m_lightmap.lookup(triangle, hit.uTriangleValue(), hit.vTriangleValue(), side, irradiance))
+				{
+					return pathTracingIterative(ray, maxDepth, sampler, direct);
+				}
+				local = local + bsdf.diffuse()*irradiance*(1.0 / Math::pi);
+			}
+			if (direct != nullptr) { *direct = local; }
+			RGBColor result = local;
+			Math::Vector3f next;
+			RGBColor weight;
+			::std::pair<double, double> xi = sampler.get2D(0, Math::PixelSampler::BsdfDirection);
+			if (maxDepth >= 1 && bsdf.sampleSpecular(xi.first, xi.second, next, weight))
+			{
+				SpyCount(rays[Spy::RayCounters::Reflection]);
+				result = result + weight*pathTracingIterative(Ray(hit.intersection(), next), maxDepth - 1, Math::ShiftedPixelSampler(sampler, 1));
+			}
+			SpyPathDepth(0);
+			return result;
+		}
+
+		/// <summary>
+		/// Computes the irradiance of a side of a triangle at the coordinates (u,v) for the lightmap: the outgoing
+		/// radiance of a white lambertian surface (irradiance / pi) is estimated by samples combining a light sample
+		/// and a cosine distributed direction (multiple importance sampling of the emission it reaches) continued by
+		/// Scene::pathTracingIterative. The samples are Sobol points seeded by the position.
+		/// </summary>
+		RGBColor bakeIrradiance(const Triangle & triangle, double u, double v, Lightmap::Side side, int maxDepth, int samples)
+		{
+			static const Material white(RGBColor(), RGBColor(1.0, 1.0, 1.0), RGBColor(), 1.0);
+			const Math::Vector3f geometricNormal = (side == Lightmap::Front) ? triangle.normal().normalized() : -triangle.normal().normalized();
+			const Math::Vector3f position = triangle.pointFromBraycentric(Math::makeVector(1.0 - u - v, u, v));
+			const Math::Vector3f N = triangle.sampleNormal(u, v, position + geometricNormal);
+			// A ray hitting the point from the baked side: the direct lighting is computed at an intersection
+			CastedRay cray(position + geometricNormal*m_lightmap.texelSize(), -geometricNormal);
+			if (!cray.intersect(&triangle)) { return RGBColor(); }
+			PhongBSDF bsdf(white, RGBColor(1.0, 1.0, 1.0), N, cray.direction());
+			const Math::Vector3f & point = cray.intersectionFound().intersection();
+			const unsigned int seed = Math::SobolSampler::pixelSeed((int)floor(point[0] * 4096.0), (int)floor(point[1] * 4096.0), m_samplerSeed + (unsigned int)floor(point[2] * 4096.0));
+			RGBColor sum;
+			for (int sample = 0; sample < samples; ++sample)
+			{
+				Math::SobolSampler sampler(seed, sample);
+				sum = sum + directLighting(cray, bsdf, sampler, 0);
+				Math::Vector3f next;
+				RGBColor weight;
+				double density;
+				::std::pair<double, double> xi = sampler.get2D(0, Math::PixelSampler::BsdfDirection);
+				if (bsdf.sample(xi.first, xi.second, next, weight, density))
+				{
+					sum = sum + sampledEmission(point, bsdf.normal(), next, density)*weight;
+					if (maxDepth >= 1)
+					{
+						SpyCount(rays[Spy::RayCounters::Diffuse]);
+						sum = sum + weight*pathTracingIterative(Ray(point, next), maxDepth - 1, Math::ShiftedPixelSampler(sampler, 1), nullptr, false);
+					}
+				}
+			}
+			return sum*(Math::pi / samples);
+		}
+
+		/// <summary>
+		/// Radiosity rendering (see Scene::setRadiosity): the emitted light of the first hit plus its diffuse
+		/// reflectance times the irradiance interpolated in the radiosity solution. If direct is provided, it receives
+		/// the same value.
+		/// </summary>
+		RGBColor radiosityShading(Ray const & ray, RGBColor * direct = nullptr)
+		{
+			CastedRay cray(ray);
+			optim(cray, "BVH");
+			SpyPathDepth(0);
+			if (direct != nullptr) { *direct = RGBColor(); }
+			if (!cray.validIntersectionFound()) { return RGBColor(); }
+			const RayTriangleIntersection & hit = cray.intersectionFound();
+			const Triangle * triangle = hit.triangle();
+			RGBColor stexture = triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+			const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+			PhongBSDF bsdf(*triangle->material(), stexture, N, cray.direction());
+			RGBColor result = triangle->material()->getEmissive()*stexture;
+			RGBColor irradiance;
+			const Radiosity::Side side = (N*triangle->normal() >= 0.0) ? Radiosity::Front : Radiosity::Back;
+			if (!bsdf.diffuse().isBlack() && m_radiosity.lookup(triangle, hit.uTriangleValue(), hit.vTriangleValue(), side, irradiance))
+			{
+				result = result + bsdf.diffuse()*irradiance*(1.0 / Math::pi);
+			}
+			if (direct != nullptr) { *direct = result; }
+			return result;
+		}
+
+		/// <summary>
+		/// The visibility between a point and a point of a target triangle (the target itself does not occlude).
+		/// </summary>
+		bool visible(Math::Vector3f const & from, Math::Vector3f const & to, const Triangle * target)
+		{
+			const Math::Vector3f direction = to - from;
+			const double distance = direction.norm();
+			if (distance <= 0.0) { return true; }
+			CastedRay cray(from, direction);
+			SpyCount(rays[Spy::RayCounters::Shadow]);
+			optim(cray, "BVH");
+			return !cray.validIntersectionFound() || cray.intersectionFound().triangle() == target || cray.intersectionFound().tRayValue() >= distance*(1.0 - 1e-6);
+		}
+
+		/// <summary>
+		/// Photon mapping (see Scene::setPhotonMapping). At each vertex of the camera path, the light leaving the
+		/// surface is split in:
+		///  - the emitted light (first vertex only) and the direct lighting, by multiple importance sampling of a light
+		///    sample and of a BSDF direction only counting the emission it reaches,
+		///  - the caustics (light reflected only by glossy lobes since the lights), estimated from the caustic map,
+		///  - the remaining indirect diffuse lighting, by a final gather: a cosine distributed ray estimates the light
+		///    leaving the surface it hits from the global map, the photons of caustic paths only counting through
+		///    its diffuse lobe (their glossy reflection is a caustic of the vertex),
+		///  - the glossy lobe, continuing the path (without the emission it reaches, part of the direct lighting).
+		/// Each vertex uses the dimensions of two bounces of the pixel sampler. If direct is provided, it receives the
+		/// emitted and directly reflected light at the first hit.
+		/// </summary>
+		RGBColor photonMapping(Ray const & ray, int maxDepth, Math::PixelSampler const & sampler, RGBColor * direct = nullptr)
+		{
+			RGBColor result;
+			RGBColor throughput(1.0, 1.0, 1.0);
+			CastedRay cray(ray);
+			if (direct != nullptr) { *direct = RGBColor(); }
+			for (int depth = 0;; ++depth)
+			{
+				optim(cray, "BVH");
+				if (!cray.validIntersectionFound())
+				{
+					SpyPathDepth(depth);
+					break;
+				}
+				const Math::ShiftedPixelSampler vertex(sampler, 2 * depth);
+				const RayTriangleIntersection & hit = cray.intersectionFound();
+				const Triangle * triangle = hit.triangle();
+				RGBColor stexture = triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+				const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+				PhongBSDF bsdf(*triangle->material(), stexture, N, cray.direction());
+				RGBColor local = directLighting(cray, bsdf, vertex, 0);
+				if (depth == 0) { local = local + triangle->material()->getEmissive()*stexture; }
+				Math::Vector3f next;
+				RGBColor weight;
+				double density;
+				::std::pair<double, double> xi = vertex.get2D(0, Math::PixelSampler::BsdfDirection);
+				if (bsdf.sample(xi.first, xi.second, next, weight, density))
+				{
+					local = local + sampledEmission(hit.intersection(), bsdf.normal(), next, density)*weight;
+				}
+				if (depth == 0 && direct != nullptr) { *direct = local; }
+				result = result + throughput*local;
+				if (depth >= maxDepth)
+				{
+					SpyPathDepth(depth);
+					break;
+				}
+				if (!bsdf.diffuse().isBlack())
+				{
+					RGBColor indirect = photonRadiance(m_causticPhotons, m_causticRadius, hit.intersection(), bsdf, false);
+					xi = vertex.get2D(1, Math::PixelSampler::LightPosition);
+					CastedRay gather(hit.intersection(), Math::RandomDirection(bsdf.normal()).generate(xi.first, xi.second));
+					SpyCount(rays[Spy::RayCounters::Diffuse]);
+					optim(gather, "BVH");
+					if (gather.validIntersectionFound())
+					{
+						const RayTriangleIntersection & gathered = gather.intersectionFound();
+						const Triangle * surface = gathered.triangle();
+						PhongBSDF gatheredBsdf(*surface->material(), surface->sampleTexture(gathered.uTriangleValue(), gathered.vTriangleValue()),
+							surface->sampleNormal(gathered.uTriangleValue(), gathered.vTriangleValue(), gather.source()), gather.direction());
+						// Cosine distributed direction: the weight of the lambertian lobe is its reflectance
+						indirect = indirect + bsdf.diffuse()*photonRadiance(m_globalPhotons, m_globalRadius, gathered.intersection(), gatheredBsdf, true);
+					}
+					result = result + throughput*indirect;
+				}
+				// The glossy direction uses the BSDF dimensions of the second bounce of the vertex, and its roulette too
+				xi = vertex.get2D(1, Math::PixelSampler::BsdfDirection);
+				if (!bsdf.sampleSpecular(xi.first, xi.second, next, weight))
+				{
+					SpyPathDepth(depth);
+					break;
+				}
+				throughput = throughput*weight;
+				if (!continuePath(throughput, depth, Math::ShiftedPixelSampler(sampler, depth + 1)))
+				{
+					SpyPathDepth(depth);
+					break;
+				}
+				SpyCount(rays[Spy::RayCounters::Reflection]);
+				cray = CastedRay(hit.intersection(), next);
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// The radiance estimate of a photon map: the light reflected by a surface point toward the direction of its
+		/// BSDF, from the power of the nearest photons divided by the area of the disc containing them.
+		/// </summary>
+		/// <param name="maxRadius">The maximum radius of the disc.</param>
+		/// <param name="glossy">Reflects the photons having been diffusely reflected with the whole BSDF, otherwise
+		/// the photons are only reflected by the lambertian lobe.</param>
+		RGBColor photonRadiance(PhotonMap const & map, double maxRadius, Math::Vector3f const & position, PhongBSDF const & bsdf, bool glossy) const
+		{
+			if (map.empty() || bsdf.isBlack()) { return RGBColor(); }
+			PhotonMap::Neighbour nearest[PhotonMap::maxGather];
+			double radius2;
+			const size_t found = map.nearest(position, bsdf.normal(), maxRadius, m_photonGather, nearest, radius2);
+			if (found == 0 || radius2 <= 0.0) { return RGBColor(); }
+			RGBColor sum;
+			for (size_t cpt = 0; cpt < found; ++cpt)
+			{
+				const Photon & photon = *nearest[cpt].second;
+				// The direction toward the origin of the photon
+				const Math::Vector3f incoming = -photon.getDirection();
+				if (bsdf.normal()*incoming <= 0.0) { continue; }
+				const RGBColor reflectance = (glossy && photon.diffuse()) ? bsdf.eval(incoming) : bsdf.diffuse()*(1.0 / Math::pi);
+				sum = sum + reflectance*photon.getPower();
+			}
+			return sum / (Math::pi*radius2);
+		}
+
+		/// <summary>
+		/// Traces a photon (Jensen's russian roulette: the photon is diffusely reflected, glossily reflected or
+		/// absorbed with probabilities given by the reflectances of the surface, so its power stays constant). The
+		/// photon is emitted from a point sampled on the emissive triangles (by the light dimensions of the first
+		/// bounce of the sampler), on a side of the triangle and in a cosine distributed direction (by its BSDF
+		/// dimensions), each bounce uses its roulette and BSDF dimensions. The photons are stored on the reflecting
+		/// surfaces they hit, with their direction of travel.
+		/// </summary>
+		/// <param name="emitted">The number of emitted photons sharing the power of the lights.</param>
+		/// <param name="caustic">Only keeps the photons reflected by glossy lobes since the light (stored on diffuse
+		/// surfaces), otherwise keeps all the photons.</param>
+		void tracePhoton(Math::PixelSampler const & sampler, int emitted, bool caustic, int maxDepth, ::std::vector<Photon> & photons)
+		{
+			LightSampler::Sample light = m_photonEmitters.sample(sampler, 0);
+			if (light.pdfArea <= 0.0) { return; }
+			::std::pair<double, double> xi = sampler.get2D(0, Math::PixelSampler::BsdfDirection);
+			// Triangles emit on both sides: the first value chooses the side, the cosine distribution follows
+			const Math::Vector3f normal = (xi.first < 0.5) ? light.normal.normalized() : -light.normal.normalized();
+			const double xi1 = (xi.first < 0.5) ? 2.0*xi.first : 2.0*xi.first - 1.0;
+			// Power: L cos / (pdfArea * pdfDirection) with pdfDirection = cos / (2 pi)
+			RGBColor power = light.emission*(2.0*Math::pi / (light.pdfArea*emitted));
+			bool diffuse = false;
+			CastedRay cray(light.point, Math::RandomDirection(normal).generate(xi1, xi.second));
+			for (int bounce = 1; bounce <= maxDepth + 1; ++bounce)
+			{
+				optim(cray, "BVH");
+				if (!cray.validIntersectionFound()) { return; }
+				const RayTriangleIntersection & hit = cray.intersectionFound();
+				const Triangle * triangle = hit.triangle();
+				const Math::Vector3f N = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+				PhongBSDF bsdf(*triangle->material(), triangle->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue()), N, cray.direction());
+				if (bsdf.isBlack()) { return; }
+				if (!caustic || (bounce > 1 && !bsdf.diffuse().isBlack()))
+				{
+					photons.push_back(Photon(hit.intersection(), power, cray.direction().normalized(), diffuse));
+				}
+				if (bounce > maxDepth) { return; }
+				const double diffuseProbability = bsdf.diffuse().grey();
+				const double specularProbability = bsdf.specular().grey();
+				const double choice = sampler.get(bounce, Math::PixelSampler::Roulette);
+				xi = sampler.get2D(bounce, Math::PixelSampler::BsdfDirection);
+				Math::Vector3f next;
+				if (choice < diffuseProbability)
+				{
+					// The caustic paths end at their first diffuse reflection
+					if (caustic) { return; }
+					next = Math::RandomDirection(bsdf.normal()).generate(xi.first, xi.second);
+					power = power*bsdf.diffuse() / diffuseProbability;
+					diffuse = true;
+				}
+				else if (choice < diffuseProbability + specularProbability)
+				{
+					RGBColor weight;
+					if (!bsdf.sampleSpecular(xi.first, xi.second, next, weight)) { return; }
+					power = power*weight / specularProbability;
+				}
+				else
+				{
+					return;
+				}
+				cray = CastedRay(hit.intersection(), next);
+			}
+		}
+
+		/// <summary>
+		/// Emits photons in parallel and builds their photon map. The photons are traced by chunks, each chunk filling
+		/// its own buffer, and the buffers are merged in the order of the chunks before the kd-tree is built, so the
+		/// map does not depend on the scheduling of the threads. Photon i is driven by the sample i of a Sobol
+		/// sequence, which stratifies the emission.
+		/// </summary>
+		void tracePhotons(PhotonMap & map, int emitted, bool caustic, int maxDepth)
+		{
+			const int chunkSize = 4096;
+			const int chunks = (emitted + chunkSize - 1) / chunkSize;
+			::std::vector<::std::vector<Photon> > buffers(chunks);
+			const unsigned int seed = Math::SobolSampler::pixelSeed(caustic ? 1 : 0, -1, m_samplerSeed);
+#pragma omp parallel for schedule(dynamic)
+			for (int chunk = 0; chunk < chunks; ++chunk)
+			{
+				for (int index = chunk*chunkSize; index < ::std::min(emitted, (chunk + 1)*chunkSize); ++index)
+				{
+					tracePhoton(Math::SobolSampler(seed, index), emitted, caustic, maxDepth, buffers[chunk]);
+				}
+			}
+			size_t count = 0;
+			for (const ::std::vector<Photon> & buffer : buffers) { count += buffer.size(); }
+			::std::vector<Photon> photons;
+			photons.reserve(count);
+			for (::std::vector<Photon> & buffer : buffers)
+			{
+				photons.insert(photons.end(), buffer.begin(), buffer.end());
+				::std::vector<Photon>().swap(buffer);
+			}
+			map.build(photons);
+		}
+
+		/// <summary>
+		/// Computes the global and caustic photon maps before the first pass. The maximum radius of the gathers is
+		/// 1/10 of the scene diagonal for the global map and 1/50 for the caustic map.
+		/// </summary>
+		void computePhotonMaps(int maxDepth)
+		{
+			TraceScope("PhotonMaps", "render");
+			System::Clock clock;
+			const double size = (m_sceneBoundingBox.max() - m_sceneBoundingBox.min()).norm();
+			m_globalRadius = 0.1*size;
+			m_causticRadius = 0.02*size;
+			m_globalPhotons.clear();
+			m_causticPhotons.clear();
+			if (m_photonEmitters.hasLights())
+			{
+				tracePhotons(m_globalPhotons, m_photonCount, false, maxDepth);
+				tracePhotons(m_causticPhotons, m_causticPhotonCount, true, maxDepth);
+			}
+			::std::cout << "Photon maps: " << m_globalPhotons.size() << " global photons, " << m_causticPhotons.size() << " caustic photons (" << clock.elapsed() << " s)" << ::std::endl;
+		}
+
+		/// <summary>
+		/// The indirect irradiance at a surface point: interpolated from the irradiance cache or, if no record is valid
+		/// at the point, computed by Scene::irradianceRecord and inserted in the cache.
+		/// </summary>
+		RGBColor indirectIrradiance(Math::Vector3f const & position, Math::Vector3f const & normal, int maxDepth)
+		{
+			RGBColor irradiance;
+			if (m_irradianceCache.lookup(position, normal, irradiance)) { return irradiance; }
+			LightCache::Record record = irradianceRecord(position, normal, maxDepth);
+			m_irradianceCache.insert(record);
+			return record.irradiance;
+		}
+
+		/// <summary>
+		/// Computes an irradiance record by gathering: m_irradianceRays cosine distributed rays, stratified by a Sobol
+		/// sequence seeded by the position, each continued by Scene::pathTracingIterative without the emission of its
+		/// first hit (it belongs to the direct lighting). The radius is the harmonic mean distance of the first hits.
+		/// </summary>
+		LightCache::Record irradianceRecord(Math::Vector3f const & position, Math::Vector3f const & normal, int maxDepth)
+		{
+			LightCache::Record record;
+			record.position = position;
+			record.normal = normal;
+			const unsigned int seed = Math::SobolSampler::pixelSeed((int)floor(position[0] * 4096.0), (int)floor(position[1] * 4096.0), m_samplerSeed + (unsigned int)floor(position[2] * 4096.0));
+			Math::RandomDirection cosine(normal);
+			RGBColor sum;
+			double inverseDistances = 0.0;
+			for (int ray = 0; ray < m_irradianceRays; ++ray)
+			{
+				// The camera dimensions stratify the gathering directions, the paths use the dimensions of the bounces
+				Math::SobolSampler sampler(seed, ray);
+				::std::pair<double, double> xi = sampler.lens();
+				double distance;
+				SpyCount(rays[Spy::RayCounters::Diffuse]);
+				sum = sum + pathTracingIterative(Ray(position, cosine.generate(xi.first, xi.second)), maxDepth - 1, sampler, nullptr, false, &distance);
+				inverseDistances += 1.0 / distance;
+			}
+			// Cosine distributed directions: the irradiance is pi times the mean radiance
+			record.irradiance = sum*(Math::pi / m_irradianceRays);
+			record.radius = (inverseDistances > 0.0) ? m_irradianceRays / inverseDistances : ::std::numeric_limits<double>::max();
+			return record;
+		}
+
+		/// <summary>
+		/// Direct lighting at the intersection. Surface lights are sampled with the light dimensions of the 
+		/// provided pixel sampler at the given depth or with their own stratified sampling if no sampler is provided.
+		/// The emissive triangles of the geometries which are not part of a light source act as one more surface light.
+		/// One light is sampled per shading point: the light hierarchy chooses an emissive triangle, its light generates
+		/// the point light and the contribution is divided by the probability of choosing this light through the
+		/// triangle (see Scene::buildLightShares).
+		/// </summary>
+		RGBColor phongDirect(CastedRay const &cray, Math::PixelSampler const * sampler = nullptr, int depth = 0) {
+			RGBColor result(0.0, 0.0, 0.0);
+			
+			//Global Illumination
+			if (m_GI_surface) {
+
+				double choice = (sampler == nullptr) ? Math::RandomDirection::random() : sampler->get(depth, Math::PixelSampler::LightChoice);
+				::std::pair<double, double> xi = (sampler == nullptr)
+					? ::std::make_pair(Math::RandomDirection::random(), Math::RandomDirection::random())
+					: sampler->get2D(depth, Math::PixelSampler::LightPosition);
+				// No receiver bound: the specular term of the phong model does not vanish behind the surface
+				LightBVH::Sample sample;
+				if (m_lightBVH.sample(cray.intersectionFound().intersection(), Math::makeVector(0.0f, 0.0f, 0.0f), choice, xi.first, xi.second, sample, LightBVH::Inverse)) {
+					const LightShare & share = m_lightShares.find(sample.triangle)->second;
+					// The light of the triangle, with the remaining part of the choice
+					PointLight light = (share.source < 0) ? m_emitters.sample(sample.choice, xi.first, xi.second).pointLight()
+						: (sampler == nullptr) ? m_lightSampler[share.source]->generate()
+						: m_lightSampler[share.source]->generate(sample.choice, xi.first, xi.second);
+					if (!phongShadow(cray, light)) {
+						//pas dans l'ombre donc on calcule
+						double probability = sample.pdfArea*sample.triangle->surface();
+						result = (phongDiffuse(cray, light) + phongSpecular(cray, light))*light.color()*(share.share / probability);
+					}
+				}
+			}
+
+			//Classic Raytracing
+			else {
+				//On verifie pour chaque lumiere si celle si eclaire notre point d'intersection
+				for (const PointLight & light : m_lights) {
+					if (!phongShadow(cray, light)) {
+						//pas dans l'ombre donc on calcule
+						result = result + (phongDiffuse(cray, light) + phongSpecular(cray, light))*light.color();
 					}
 				}
 			}
@@ -354,6 +1696,7 @@ namespace Geometry
 			//retourne true si dans l'ombre
 			bool shadow = false;
 			CastedRay cshadow(light.position(), cray.intersectionFound().intersection() - light.position());
+			SpyCount(rays[Spy::RayCounters::Shadow]);
 
 			optim(cshadow, "BVH");
 			if (cshadow.validIntersectionFound()) {
@@ -390,6 +1733,7 @@ namespace Geometry
 			//if (N*cray.direction() < 0) N = -N;
 
 			CastedRay creflection(cray.intersectionFound().intersection(), cray.intersectionFound().triangle()->reflectionDirection(N.normalized(),cray.direction()));
+			SpyCount(rays[Spy::RayCounters::Reflection]);
 
 			return cray.intersectionFound().triangle()->material()->getSpecular()*sendRay(creflection, depth + 1, maxDepth, diffuseSamples, specularSamples)*krefl;
 		}
@@ -402,6 +1746,8 @@ namespace Geometry
 			else {
 				optimTemp(cray);
 			}
+			if (cray.validIntersectionFound()) { SpyCount(hits); }
+			else { SpyCount(misses); }
 		}
 
 		void optimTemp(CastedRay &cray) {
@@ -423,10 +1769,543 @@ namespace Geometry
 			}
 		}
 
+		/// <summary>
+		/// Associates each emissive triangle of the light hierarchy with its light (see Scene::phongDirect). The share
+		/// of a triangle of a light source is its part of the emissive area of the light source, the share of an
+		/// emissive geometry is its probability in m_emitters.
+		/// </summary>
+		void buildLightShares()
+		{
+			m_lightShares.clear();
+			::std::vector<double> areas(m_lightSampler.size(), 0.0);
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				for (size_t index = 0; index < m_geometries.size(); ++index)
+				{
+					auto source = m_lightSourceGeometries.find(index);
+					for (const Triangle & triangle : m_geometries[index].second.getTriangles())
+					{
+						// The emissive triangles kept by the light hierarchy
+						if (triangle.material()->getEmissive().isBlack() || triangle.surface() <= 0.0) { continue; }
+						if (source == m_lightSourceGeometries.end())
+						{
+							if (pass == 1) { m_lightShares[&triangle] = LightShare{ -1, m_emitters.pdfArea(&triangle)*triangle.surface() }; }
+						}
+						else if (pass == 0) { areas[source->second] += triangle.surface(); }
+						else { m_lightShares[&triangle] = LightShare{ (int)source->second, triangle.surface() / areas[source->second] }; }
+					}
+				}
+			}
+		}
+
 		void buildBVH() {
+			TraceScope("buildBVH", "load");
+			delete m_bvh;
 			m_bvh = new BVH(m_geometries, m_sceneBoundingBox);
+			m_bvhDirty = false;
+			// The light structures refer to the triangles of the geometries as well: every emissive triangle is a light
+			m_emitters.build(m_geometries, [this](size_t index) { return m_lightSourceGeometries.count(index) == 0; });
+			m_photonEmitters.build(m_geometries);
+			m_lightBVH.build(m_geometries);
+			buildLightShares();
+			resetIrradianceCache();
+			// The radiosity solution refers to the previous geometries
+			m_radiosity.clear();
+		}
+
+		/// <summary>
+		/// True if the samples are computed by Scene::irradianceCaching.
+		/// </summary>
+		bool useIrradianceCache() const
+		{
+			return m_irradianceCaching && m_GI_indirect && m_GI_surface;
+		}
+
+		/// <summary>
+		/// True if the samples are computed by Scene::photonMapping.
+		/// </summary>
+		bool usePhotonMapping() const
+		{
+			return m_photonMapping && m_GI_indirect && m_GI_surface;
 		}
 
+		/// <summary>
+		/// True if the samples are computed by Scene::radiosityShading.
+		/// </summary>
+		bool useRadiosity() const
+		{
+			return m_radiosityEnabled && m_GI_indirect && m_GI_surface;
+		}
+
+		/// <summary>
+		/// Ends a training iteration of the path guiding once 1, 3, 7... passes are completed (iterations of 1, 2, 4...
+		/// passes). The training stops when the next iteration would end after half of the passes.
+		/// </summary>
+		void trainPathGuiding(int totalSamples)
+		{
+			if (!m_guidingTraining || ((m_pass + 1) & m_pass) != 0) { return; }
+			TraceScope("PathGuiding", "render");
+			m_guiding.refine();
+			m_guidingTraining = 2 * m_pass + 1 <= totalSamples / 2;
+			::std::cout << "Path guiding: iteration " << m_guiding.iteration() << ", " << m_guiding.size() << " cells" << (m_guidingTraining ? "" : " (training done)") << ::std::endl;
+		}
+
+		/// <summary>
+		/// Removes the records of the irradiance cache. The radius of the records is bounded relatively to the size
+		/// of the scene.
+		/// </summary>
+		void resetIrradianceCache()
+		{
+			const double size = (m_sceneBoundingBox.max() - m_sceneBoundingBox.min()).norm();
+			m_irradianceCache.reset(m_irradianceAccuracy, 0.001*size, 0.1*size);
+		}
+
+		/// <summary>
+		/// Fills the irradiance cache before the first pass: the primary rays through the pixels of grids of step
+		/// 16, 8, 4 then 2 in the crop window look up the cache and create the missing records, so that the records
+		/// are placed coarse to fine. The records missing during the rendering are created on demand.
+		/// </summary>
+		void computeIrradianceCache(int maxDepth)
+		{
+			TraceScope("IrradianceCache", "render");
+			for (int step = 16; step >= 2; step /= 2)
+			{
+#pragma omp parallel for schedule(dynamic)
+				for (int y = m_cropY0 + step / 2; y < m_cropY1; y += step)
+				{
+					for (int x = m_cropX0 + step / 2; x < m_cropX1; x += step)
+					{
+						CastedRay cray(m_camera.getRay((double)x / m_width, (double)y / m_height));
+						optim(cray, "BVH");
+						if (!cray.validIntersectionFound()) { continue; }
+						const RayTriangleIntersection & hit = cray.intersectionFound();
+						if (hit.triangle()->material()->getDiffuse().isBlack()) { continue; }
+						const Math::Vector3f N = hit.triangle()->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source()).normalized();
+						indirectIrradiance(hit.intersection(), N, maxDepth);
+					}
+				}
+			}
+			::std::cout << "Irradiance cache: " << m_irradianceCache.size() << " records" << ::std::endl;
+		}
+
+		/// <summary>
+		/// Computes one sample of a pixel. The sample index fully determines the sub pixel cell
+		/// (sample modulo subPixelDivision^2) and the sequence of random numbers, so that any set of
+		/// samples can be computed independently (in any order, by any thread or process).
+		/// </summary>
+		/// <param name="x">The x coordinate of the pixel.</param>
+		/// <param name="y">The y coordinate of the pixel.</param>
+		/// <param name="sampleIndex">The index of the sample.</param>
+		/// <param name="maxDepth">The maximum recursive depth.</param>
+		/// <param name="subPixelDivision">The sub pixel subdivisions.</param>
+		/// <returns>The radiance of the sample.</returns>
+		/// <param name="direct">If provided, receives the direct lighting part of the sample (emission and one bounce).</param>
+		RGBColor samplePixel(int x, int y, unsigned long long sampleIndex, int maxDepth, int subPixelDivision, RGBColor * direct = nullptr)
+		{
+			const double step = 1.0 / subPixelDivision;
+			const int cell = (int)(sampleIndex % (unsigned long long)(subPixelDivision*subPixelDivision));
+			const double xp = -0.5 + (cell / subPixelDivision)*step;
+			const double yp = -0.5 + (cell % subPixelDivision)*step;
+			// One scrambled sequence per pixel (the same for all pixels with a unique seed)
+			Math::SobolSampler sobol(Math::SobolSampler::pixelSeed(m_GI_graineUnique ? 0 : x, m_GI_graineUnique ? 0 : y, m_samplerSeed), sampleIndex);
+			Math::RandomPixelSampler random;
+			const Math::PixelSampler & sampler = m_GI_qmc ? static_cast<const Math::PixelSampler &>(sobol) : random;
+			// Jittered position inside the sub pixel
+			::std::pair<double, double> lens = sampler.lens();
+			Ray primary = m_camera.getRay(((double)x + xp + lens.first*step) / m_width, ((double)y + yp + lens.second*step) / m_height);
+			SpyCount(rays[Spy::RayCounters::Primary]);
+			// Ray casting
+			if (m_useLightmap && m_GI_indirect && m_GI_surface) {
+				return lightmapped(primary, maxDepth, sampler, direct);
+			}
+			if (useRadiosity()) {
+				return radiosityShading(primary, direct);
+			}
+			if (usePhotonMapping()) {
+				return photonMapping(primary, maxDepth, sampler, direct);
+			}
+			if (useIrradianceCache()) {
+				return irradianceCaching(primary, maxDepth, sampler, direct);
+			}
+			if (m_GI_indirect && m_GI_iterative) {
+				return pathTracingIterative(primary, maxDepth, sampler, direct);
+			}
+			if (m_GI_indirect) {
+				return pathTracing(primary, 0, maxDepth, m_diffuseSamples, m_specularSamples, sampler, direct);
+			}
+			return sendRay(primary, 0, maxDepth, m_diffuseSamples, m_specularSamples, direct);
+		}
+
+		/// <summary>
+		/// Computes the samples [sampleBegin;sampleEnd) of the pixels of the tile [x0;x1)x[y0;y1) without 
+		/// any display. The BVH must have been built (see Scene::buildBVH).
+		/// </summary>
+		/// <param name="tile">Receives the samples, its size must be (x1-x0)x(y1-y0), pixel (x0,y0) is stored at (0,0).</param>
+		/// <param name="maxDepth">The maximum recursive depth.</param>
+		/// <param name="subPixelDivision">The sub pixel subdivisions.</param>
+		void renderTile(AccumulationBuffer & tile, int x0, int y0, int x1, int y1, unsigned long long sampleBegin, unsigned long long sampleEnd, int maxDepth, int subPixelDivision)
+		{
+			TraceScope("Tile", "render");
+#pragma omp parallel for schedule(dynamic)
+			for (int y = y0; y < y1; y++)
+			{
+				TraceScope("Line", "render");
+				for (int x = x0; x < x1; x++)
+				{
+					for (unsigned long long sample = sampleBegin; sample < sampleEnd; ++sample)
+					{
+						tile.add(x - x0, y - y0, samplePixel(x, y, sample, maxDepth, subPixelDivision));
+					}
+				}
+			}
+		}
+
+
+		/// <summary>
+		/// Computes the features of the pixels of the crop window with one primary ray through the center of each sub pixel.
+		/// The identifiers are only computed with the auxiliary buffers, with a ray through the center of the pixel.
+		/// Triangles are numbered in the order of the meshes, materials in the order of their first use.
+		/// </summary>
+		void computeFeatures(int subPixelDivision)
+		{
+			TraceScope("computeFeatures", "render");
+			m_features = FeatureBuffer(m_cropX1 - m_cropX0, m_cropY1 - m_cropY0);
+			const double step = 1.0 / subPixelDivision;
+			// Identifiers of the triangles (triangle, mesh) and of the materials
+			::std::unordered_map<const Triangle*, ::std::pair<int, int> > triangleIds;
+			::std::unordered_map<const Material*, int> materialIds;
+			if (m_aovs)
+			{
+				int triangleId = 0;
+				for (size_t mesh = 0; mesh < m_geometries.size(); ++mesh)
+				{
+					for (const Triangle & triangle : m_geometries[mesh].second.getTriangles())
+					{
+						triangleIds[&triangle] = ::std::make_pair(triangleId++, (int)mesh);
+						materialIds.insert(::std::make_pair(triangle.material(), (int)materialIds.size()));
+					}
+				}
+			}
+#pragma omp parallel for schedule(dynamic)
+			for (int y = m_cropY0; y < m_cropY1; y++)
+			{
+				for (int x = m_cropX0; x < m_cropX1; x++)
+				{
+					RGBColor albedo;
+					Math::Vector3f normal(0.0);
+					double depth = 0.0;
+					int hits = 0;
+					for (int i = 0; i < subPixelDivision; ++i)
+					{
+						for (int j = 0; j < subPixelDivision; ++j)
+						{
+							CastedRay cray(m_camera.getRay((x - 0.5 + (i + 0.5)*step) / m_width, (y - 0.5 + (j + 0.5)*step) / m_height));
+							SpyCount(rays[Spy::RayCounters::Primary]);
+							optim(cray, "BVH");
+							if (cray.validIntersectionFound())
+							{
+								const RayTriangleIntersection & hit = cray.intersectionFound();
+								albedo = albedo + hit.triangle()->material()->getDiffuse() * hit.triangle()->sampleTexture(hit.uTriangleValue(), hit.vTriangleValue());
+								normal = normal + hit.triangle()->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+								depth += hit.tRayValue();
+								++hits;
+							}
+						}
+					}
+					if (hits > 0)
+					{
+						m_features.set(x - m_cropX0, y - m_cropY0, albedo / hits, (normal.norm() > 0.0) ? normal.normalized() : normal, depth / hits);
+					}
+					if (m_aovs)
+					{
+						CastedRay cray(m_camera.getRay((double)x / m_width, (double)y / m_height));
+						SpyCount(rays[Spy::RayCounters::Primary]);
+						optim(cray, "BVH");
+						if (cray.validIntersectionFound())
+						{
+							const Triangle * triangle = cray.intersectionFound().triangle();
+							const ::std::pair<int, int> & ids = triangleIds.find(triangle)->second;
+							m_features.setIds(x - m_cropX0, y - m_cropY0, ids.first, ids.second, materialIds.find(triangle->material())->second);
+						}
+					}
+				}
+			}
+		}
+
+		/// <summary>
+		/// Denoises the accumulated samples and displays the result.
+		/// </summary>
+		void denoise()
+		{
+			System::Clock clock;
+			{
+				TraceScope("Denoise", "render");
+				m_denoised = m_denoiser.denoise(m_accumulationBuffer, m_features);
+			}
+			::std::cout << "Denoising: " << clock.elapsed() << "s." << ::std::endl;
+			if (m_visu != nullptr)
+			{
+				for (int y = m_cropY0; y < m_cropY1; y++)
+				{
+					for (int x = m_cropX0; x < m_cropX1; x++)
+					{
+						m_visu->plot(x, y, m_denoised.mean(x - m_cropX0, y - m_cropY0) * 10);
+					}
+				}
+				TraceScope("Display", "display");
+				m_visu->update();
+			}
+		}
+
+		/// <summary>
+		/// Computes one sample of a pixel of the crop window and accumulates it (and its direct lighting if the
+		/// auxiliary buffers are enabled).
+		/// </summary>
+		void accumulateSample(int x, int y, unsigned long long sampleIndex, int maxDepth, int subPixelDivision)
+		{
+			if (m_aovs)
+			{
+				RGBColor direct;
+				m_accumulationBuffer.add(x - m_cropX0, y - m_cropY0, samplePixel(x, y, sampleIndex, maxDepth, subPixelDivision, &direct));
+				m_directBuffer.add(x - m_cropX0, y - m_cropY0, direct);
+			}
+			else
+			{
+				m_accumulationBuffer.add(x - m_cropX0, y - m_cropY0, samplePixel(x, y, sampleIndex, maxDepth, subPixelDivision));
+			}
+		}
+
+		/// <summary>
+		/// Renders the traversal cost image of the crop window (see Scene::setHeatmap). Each pixel averages the
+		/// cost of its subPixelDivision^2 first samples, the false colors are stored in the accumulation buffer.
+		/// </summary>
+		void computeHeatmap(int maxDepth, int subPixelDivision)
+		{
+			TraceScope("Heatmap", "render");
+			const int width = m_cropX1 - m_cropX0;
+			const int height = m_cropY1 - m_cropY0;
+			const int samples = subPixelDivision*subPixelDivision;
+			::std::vector<double> cost(width*height);
+#pragma omp parallel for schedule(dynamic)
+			for (int y = m_cropY0; y < m_cropY1; y++)
+			{
+				for (int x = m_cropX0; x < m_cropX1; x++)
+				{
+					BVH::TraversalCost pixelCost;
+					BVH::threadCost() = &pixelCost;
+					for (int sample = 0; sample < samples; ++sample)
+					{
+						if (m_heatmap.path)
+						{
+							samplePixel(x, y, sample, maxDepth, subPixelDivision);
+						}
+						else
+						{
+							const double step = 1.0 / subPixelDivision;
+							CastedRay cray(m_camera.getRay((x - 0.5 + (sample / subPixelDivision + 0.5)*step) / m_width, (y - 0.5 + (sample % subPixelDivision + 0.5)*step) / m_height));
+							optim(cray, "BVH");
+						}
+					}
+					BVH::threadCost() = nullptr;
+					cost[(y - m_cropY0)*width + (x - m_cropX0)] = m_heatmap.value(pixelCost) / samples;
+				}
+			}
+			double maxCost = 0.0;
+			double meanCost = 0.0;
+			for (double value : cost)
+			{
+				maxCost = ::std::max(maxCost, value);
+				meanCost += value / cost.size();
+			}
+			const double scale = (m_heatmap.scale > 0.0) ? m_heatmap.scale : maxCost;
+			::std::cout << "Heatmap: " << ((m_heatmap.metric == Heatmap::Nodes) ? "nodes" : "triangles") << " per " << (m_heatmap.path ? "path" : "primary ray")
+				<< ", mean " << meanCost << ", max " << maxCost << ", red = " << scale << ::std::endl;
+			m_accumulationBuffer = AccumulationBuffer(width, height);
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					RGBColor color = Heatmap::falseColor((scale > 0.0) ? cost[y*width + x] / scale : 0.0);
+					m_accumulationBuffer.add(x, y, color);
+					if (m_visu != nullptr)
+					{
+						m_visu->plot(x + m_cropX0, y + m_cropY0, (unsigned char)(color[0] * 255), (unsigned char)(color[1] * 255), (unsigned char)(color[2] * 255));
+					}
+				}
+			}
+			if (m_visu != nullptr)
+			{
+				TraceScope("Display", "display");
+				m_visu->update();
+			}
+		}
+
+		/// <summary>
+		/// Returns the seed of the random numbers of a pass, a function of the pass so that resumed renderings are reproducible.
+		/// </summary>
+		int passSeed(int pass) const
+		{
+			return (int)(Math::SobolSampler::hash(Math::SobolSampler::hashCombine(m_samplerSeed, (unsigned int)pass)) % ((unsigned int)RAND_MAX + 1));
+		}
+
+		/// <summary>
+		/// Computes the first pass (sample 0 of each pixel of the crop window) by increasing resolution (see Scene::setPreview).
+		/// </summary>
+		void computePreview(int maxDepth, int subPixelDivision)
+		{
+			const int newSeed = passSeed(0);
+			std::srand(newSeed);
+			for (int block = 8; block >= 1; block /= 2)
+			{
+				::std::cout << "Preview: 1/" << block << ::std::endl;
+				TraceScope("Preview", "render");
+#pragma omp parallel for schedule(dynamic)
+				for (int y = m_cropY0; y < m_cropY1; y += block)
+				{
+					for (int x = m_cropX0; x < m_cropX1; x += block)
+					{
+						const int bx = x - m_cropX0;
+						const int by = y - m_cropY0;
+						// Pixels of the previous levels are reused
+						if (m_accumulationBuffer.count(bx, by) == 0)
+						{
+							if (m_GI_graineUnique) std::srand(newSeed);
+							accumulateSample(x, y, 0, maxDepth, subPixelDivision);
+						}
+						// The pixel is splatted on its block until the next level refines it
+						RGBColor color = m_accumulationBuffer.mean(bx, by) * 10;
+#pragma omp critical (visu)
+						for (int py = y; py < ::std::min(y + block, m_cropY1); ++py)
+						{
+							for (int px = x; px < ::std::min(x + block, m_cropX1); ++px)
+							{
+								m_visu->plot(px, py, color);
+							}
+						}
+					}
+				}
+				TraceScope("Display", "display");
+				m_visu->update();
+			}
+		}
+
+		/// <summary>
+		/// Computes the fingerprint of what a checkpoint depends on besides the image parameters: the camera, the lights,
+		/// the geometries with their materials and the settings of the integrator. The sampler seed and the sampler type
+		/// are not part of it since they are restored from the checkpoint.
+		/// </summary>
+		::std::uint64_t renderFingerprint() const
+		{
+			System::Fingerprint fingerprint;
+			auto addVector = [&fingerprint](const Math::Vector3f & v) { fingerprint.add(v[0]).add(v[1]).add(v[2]); };
+			auto addColor = [&fingerprint](const RGBColor & c) { fingerprint.add(c[0]).add(c[1]).add(c[2]); };
+			// The camera, through the rays of two opposite corners of the image
+			for (double corner = 0.0; corner <= 1.0; corner += 1.0)
+			{
+				const Ray ray = m_camera.getRay(corner, corner);
+				addVector(ray.source());
+				addVector(ray.direction());
+			}
+			fingerprint.add((::std::uint64_t)m_lights.size()).add((::std::uint64_t)m_lightSampler.size());
+			for (const PointLight & light : m_lights)
+			{
+				addVector(light.position());
+				addColor(light.color());
+			}
+			for (auto it = m_geometries.begin(); it != m_geometries.end(); ++it)
+			{
+				const Geometry & geometry = it->second;
+				fingerprint.add((::std::uint64_t)geometry.getVertices().size()).add((::std::uint64_t)geometry.getTriangles().size());
+				for (const Math::Vector3f & vertex : geometry.getVertices()) { addVector(vertex); }
+				const Material * previous = nullptr;
+				for (const Triangle & triangle : geometry.getTriangles())
+				{
+					const Material * material = triangle.material();
+					if (material == previous) { continue; }
+					previous = material;
+					addColor(material->getDiffuse());
+					addColor(material->getSpecular());
+					addColor(material->getEmissive());
+					fingerprint.add(material->getShininess());
+				}
+			}
+			fingerprint.add((::std::uint64_t)m_diffuseSamples).add((::std::uint64_t)m_specularSamples).add((::std::uint64_t)m_lightSamples);
+			fingerprint.add(m_GI_surface).add(m_GI_graineUnique).add(m_GI_indirect).add(m_GI_iterative).add(m_rouletteDepth).add(m_GI_mis);
+			fingerprint.add(m_irradianceCaching).add(m_irradianceAccuracy).add(m_irradianceRays).add(m_useLightmap);
+			fingerprint.add(m_photonMapping).add(m_photonCount).add(m_causticPhotonCount).add(m_photonGather);
+			fingerprint.add(m_radiosityEnabled).add(m_radiosityAccuracy).add(m_pathGuiding).add(m_guidingProbability);
+			return fingerprint.value();
+		}
+
+		/// <summary>
+		/// Saves the current state of Scene::compute in the checkpoint file.
+		/// </summary>
+		void saveCheckpoint(int maxDepth, int subPixelDivision, int passPerPixel)
+		{
+			TraceScope("Checkpoint", "io");
+			RenderCheckpoint checkpoint;
+			checkpoint.frameWidth = m_width;
+			checkpoint.frameHeight = m_height;
+			checkpoint.cropX = m_cropX0;
+			checkpoint.cropY = m_cropY0;
+			checkpoint.maxDepth = maxDepth;
+			checkpoint.subPixelDivision = subPixelDivision;
+			checkpoint.passPerPixel = passPerPixel;
+			checkpoint.pass = m_pass;
+			checkpoint.samplerSeed = m_samplerSeed;
+			checkpoint.qmc = m_GI_qmc ? 1 : 0;
+			checkpoint.fingerprint = m_checkpointFingerprint;
+			checkpoint.buffer = m_accumulationBuffer;
+			checkpoint.direct = m_directBuffer;
+			if (checkpoint.save(m_checkpointFile))
+			{
+				::std::cout << "Checkpoint: pass " << m_pass << " saved in " << m_checkpointFile << ::std::endl;
+			}
+		}
+
+		/// <summary>
+		/// Restores the state of Scene::compute from the checkpoint file if it matches the rendering parameters.
+		/// </summary>
+		/// <returns>true if the rendering has been resumed.</returns>
+		bool resumeCheckpoint(int maxDepth, int subPixelDivision, int passPerPixel)
+		{
+			RenderCheckpoint checkpoint;
+			if (!checkpoint.load(m_checkpointFile))
+			{
+				::std::cout << "Checkpoint: no checkpoint in " << m_checkpointFile << ", starting from scratch" << ::std::endl;
+				return false;
+			}
+			if (!checkpoint.matches(m_width, m_height, m_cropX0, m_cropY0, m_cropX1 - m_cropX0, m_cropY1 - m_cropY0, maxDepth, subPixelDivision, passPerPixel, m_checkpointFingerprint))
+			{
+				::std::cerr << "Checkpoint: " << m_checkpointFile << " has been produced with other rendering parameters, starting from scratch" << ::std::endl;
+				return false;
+			}
+			// The direct lighting of all the passes is needed to split the auxiliary buffers
+			if (m_aovs && (checkpoint.direct.width() != m_directBuffer.width() || checkpoint.direct.height() != m_directBuffer.height()))
+			{
+				::std::cerr << "Checkpoint: " << m_checkpointFile << " has no direct lighting buffer, starting from scratch" << ::std::endl;
+				return false;
+			}
+			m_accumulationBuffer = checkpoint.buffer;
+			if (m_aovs) { m_directBuffer = checkpoint.direct; }
+			m_pass = (int)checkpoint.pass;
+			m_samplerSeed = checkpoint.samplerSeed;
+			m_GI_qmc = (checkpoint.qmc != 0);
+			::std::cout << "Checkpoint: resuming at pass " << m_pass << ::std::endl;
+			if (m_visu != nullptr)
+			{
+				for (int y = m_cropY0; y < m_cropY1; y++)
+				{
+					for (int x = m_cropX0; x < m_cropX1; x++)
+					{
+						m_visu->plot(x, y, m_accumulationBuffer.mean(x - m_cropX0, y - m_cropY0) * 10);
+					}
+				}
+				TraceScope("Display", "display");
+				m_visu->update();
+			}
+			return true;
+		}
 
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// \fn	void Scene::compute(int maxDepth)
@@ -441,92 +2320,160 @@ namespace Geometry
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		void compute(int maxDepth, int subPixelDivision = 1, int passPerPixel = 1)
 		{
-			
-			buildBVH();
-			// We prepare the light sampler (the sampler only stores triangles with a non null emissive component).
-			/*
-			for (auto it = m_geometries.begin(), end = m_geometries.end(); it != end; ++it)
+			// The time budget starts with the call
+			System::Clock computeClock;
+			// The BVH is kept between renderings until the geometry changes
+			if (m_bvh == nullptr || m_bvhDirty)
 			{
-				//emissive a voir
-				//m_lightSampler.add(it->second);
-				m_SAMPLER.add(it->second);
+				buildBVH();
+			}
+			// Traversal cost render mode
+			if (m_heatmap.metric != Heatmap::None)
+			{
+				computeHeatmap(maxDepth, subPixelDivision);
+				return;
+			}
+			// Features guiding the denoiser or exported as auxiliary buffers
+			if (m_denoise || m_aovs)
+			{
+				computeFeatures(subPixelDivision);
+			}
+			// Irradiance records of the first hits, placed before the first pass
+			if (useIrradianceCache() && maxDepth > 0)
+			{
+				resetIrradianceCache();
+				computeIrradianceCache(maxDepth);
+			}
+			// Photons shot from the lights before the first pass
+			if (usePhotonMapping() && maxDepth > 0)
+			{
+				computePhotonMaps(maxDepth);
+			}
+			// The radiosity solution is kept while the geometries and the accuracy are unchanged
+			if (useRadiosity() && m_radiosity.empty())
+			{
+				solveRadiosity(maxDepth);
 			}
-			*/
-
-			// Step on x and y for subpixel sampling
-			double step = 1.0f/subPixelDivision ;
 			// Table accumulating values computed per pixel (enable rendering of each pass)
-			::std::vector<::std::vector<::std::pair<int, RGBColor> > > pixelTable(m_visu->width(), ::std::vector<::std::pair<int, RGBColor> >(m_visu->width(), ::std::make_pair(0, RGBColor()))) ;
-
-			// 1 - Rendering time
-			LARGE_INTEGER frequency;        // ticks per second
-			LARGE_INTEGER t1, t2;           // ticks
-			double elapsedTime;
-			// get ticks per second
-			QueryPerformanceFrequency(&frequency);
-			// start timer
-			QueryPerformanceCounter(&t1);
+			m_accumulationBuffer = AccumulationBuffer(m_cropX1 - m_cropX0, m_cropY1 - m_cropY0);
+			// The direct lighting, restored with the samples of a resumed rendering
+			m_directBuffer = AccumulationBuffer(m_aovs ? m_cropX1 - m_cropX0 : 0, m_aovs ? m_cropY1 - m_cropY0 : 0);
+			const int totalSamples = passPerPixel * subPixelDivision * subPixelDivision;
 			// Rendering pass number
 			m_pass = 0;
-			// Rendering
+			if (!m_checkpointFile.empty())
+			{
+				m_checkpointFingerprint = renderFingerprint();
+			}
+			if (m_resume && !m_checkpointFile.empty())
+			{
+				resumeCheckpoint(maxDepth, subPixelDivision, passPerPixel);
+			}
+			const int firstPass = m_pass;
+			// Path guiding: the distributions are learnt from the first passes
+			m_guidingTraining = m_pathGuiding && m_GI_indirect && m_GI_iterative && m_GI_mis && m_GI_surface && !useIrradianceCache() && !usePhotonMapping() && !useRadiosity() && !m_useLightmap;
+			if (m_pathGuiding) { m_guiding.reset(m_sceneBoundingBox); }
 
-			for(int passPerPixelCounter = 0 ; passPerPixelCounter<passPerPixel ; ++passPerPixelCounter)
+			// 1 - Rendering time
+			System::Clock clock;
+			double elapsedTime = 0.0;
+			double lastCheckpoint = 0.0;
+			// Progressive resolution preview of the first pass
+			if (m_preview && m_visu != nullptr && m_pass == 0)
 			{
-				for (double xp = -0.5; xp < 0.5; xp += step)
-				{
-					for (double yp = -0.5; yp < 0.5; yp += step)
-					{
-						int newSeed = std::rand();
+				computePreview(maxDepth, subPixelDivision);
+				m_pass = 1;
+			}
+			// Rendering: one pass per sample index (passPerPixel x sub pixel cells)
+			while (m_pass < totalSamples)
+			{
+				TraceScope("Pass", "render");
+				// Seed of the random numbers of this pass
+				int newSeed = passSeed(m_pass);
+				std::srand(newSeed);
 
-						::std::cout << "Pass: " << m_pass << "/" << passPerPixel * subPixelDivision * subPixelDivision << ::std::endl;
-						++m_pass;
-						// Sends primary rays for each pixel (uncomment the pragma to parallelize rendering)
+				::std::cout << "Pass: " << m_pass << "/" << totalSamples << ::std::endl;
+				// Index of this sample in the per pixel (quasi) random sequence
+				const unsigned long long sampleIndex = m_pass;
+				++m_pass;
+				// Sends primary rays for each pixel (uncomment the pragma to parallelize rendering)
 #pragma omp parallel for schedule(dynamic)//, 10)//guided)//dynamic)
-						for (int y = 0; y < m_visu->height(); y++)
+				for (int y = m_cropY0; y < m_cropY1; y++)
+				{
+					TraceScope("Line", "render");
+					for (int x = m_cropX0; x < m_cropX1; x++)
+					{
+						if (m_visu != nullptr)
 						{
-							for (int x = 0; x < m_visu->width(); x++)
-							{
 #pragma omp critical (visu)
-								m_visu->plot(x, y, RGBColor(1000.0, 0.0, 0.0));
-								//Echantillonnage
-								if (m_GI_graineUnique) std::srand(newSeed);
-								// Ray casting
-								RGBColor result;
-								if (m_GI_indirect) {
-									result = pathTracing(m_camera.getRay(((double)x + xp) / m_visu->width(), ((double)y + yp) / m_visu->height()), 0, maxDepth, m_diffuseSamples, m_specularSamples);
-								}
-								else {
-									result = sendRay(m_camera.getRay(((double)x + xp) / m_visu->width(), ((double)y + yp) / m_visu->height()), 0, maxDepth, m_diffuseSamples, m_specularSamples);
-								}
-								
-								// Accumulation of ray casting result in the associated pixel
-								::std::pair<int, RGBColor> & currentPixel = pixelTable[x][y];
-								currentPixel.first++;
-								currentPixel.second = currentPixel.second + result;
-								// Pixel rendering (with simple tone mapping)
+							m_visu->plot(x, y, RGBColor(1000.0, 0.0, 0.0));
+						}
+						//Echantillonnage
+						if (m_GI_graineUnique) std::srand(newSeed);
+						// Accumulation of ray casting result in the associated pixel
+						accumulateSample(x, y, sampleIndex, maxDepth, subPixelDivision);
+						// Pixel rendering (with simple tone mapping)
+						if (m_visu != nullptr)
+						{
 #pragma omp critical (visu)
-								m_visu->plot(x, y, pixelTable[x][y].second / (double)(pixelTable[x][y].first) * 10);
-								// Updates the rendering context (per pixel) - warning per pixel update can be costly...
+							m_visu->plot(x, y, m_accumulationBuffer.mean(x - m_cropX0, y - m_cropY0) * 10);
+						}
+						// Updates the rendering context (per pixel) - warning per pixel update can be costly...
 //#pragma omp critical (visu)
-								//m_visu->update();
-							}
-							// Updates the rendering context (per line)
+						//m_visu->update();
+					}
+					// Updates the rendering context (per line)
+					if (m_visu != nullptr)
+					{
 #pragma omp critical (visu)
+						{
+							TraceScope("Display", "display");
 							m_visu->update();
 						}
-						// Updates the rendering context (per pass)
-						//m_visu->update();
-						// We print time for each pass
-						QueryPerformanceCounter(&t2);
-						elapsedTime = (double)(t2.QuadPart - t1.QuadPart) / (double)frequency.QuadPart;
-						double remainingTime = (elapsedTime / m_pass)*(passPerPixel * subPixelDivision * subPixelDivision - m_pass);
-						::std::cout << "time: " << elapsedTime << "s. " <<", remaining time: "<< remainingTime << "s. " <<", total time: "<< elapsedTime + remainingTime << ::std::endl;
 					}
 				}
+				// Updates the rendering context (per pass)
+				//m_visu->update();
+				// We print time for each pass
+				const double passTime = clock.elapsed() - elapsedTime;
+				elapsedTime += passTime;
+				double remainingTime = (elapsedTime / (m_pass - firstPass))*(totalSamples - m_pass);
+				trainPathGuiding(totalSamples);
+				::std::cout << "time: " << elapsedTime << "s. " <<", remaining time: "<< remainingTime << "s. " <<", total time: "<< elapsedTime + remainingTime << ::std::endl;
+				// Periodic checkpoint
+				if (!m_checkpointFile.empty() && elapsedTime - lastCheckpoint >= m_checkpointInterval)
+				{
+					saveCheckpoint(maxDepth, subPixelDivision, passPerPixel);
+					lastCheckpoint = elapsedTime;
+				}
+				// Stopping criteria
+				if (m_timeBudget > 0.0 && computeClock.elapsed() + passTime > m_timeBudget)
+				{
+					::std::cout << "Time budget reached (" << m_timeBudget << "s.)" << ::std::endl;
+					break;
+				}
+				if (m_noiseTarget > 0.0)
+				{
+					double noise = m_accumulationBuffer.noise();
+					::std::cout << "noise: " << noise << ::std::endl;
+					if (noise >= 0.0 && noise <= m_noiseTarget)
+					{
+						::std::cout << "Noise target reached (" << m_noiseTarget << ")" << ::std::endl;
+						break;
+					}
+				}
+			}
+			m_guidingTraining = false;
+			if (!m_checkpointFile.empty())
+			{
+				saveCheckpoint(maxDepth, subPixelDivision, passPerPixel);
+			}
+			if (m_denoise)
+			{
+				denoise();
 			}
 			// stop timer
-			QueryPerformanceCounter(&t2);
-			elapsedTime = (double)(t2.QuadPart - t1.QuadPart) / (double)frequency.QuadPart;
+			elapsedTime = clock.elapsed();
 			::std::cout<<"time: "<<elapsedTime<<"s. "<<::std::endl ;
 		}
 	} ;
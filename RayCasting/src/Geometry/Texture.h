@@ -38,6 +38,20 @@ namespace Geometry
 			return m_data != NULL;
 		}
 
+		int width() const
+		{ return m_width; }
+
+		int height() const
+		{ return m_height; }
+
+		/// <summary>
+		/// Returns the size of the pixel data (allocated by SOIL) in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return isValid() ? (size_t)m_width * m_height * 3 : 0;
+		}
+
 		RGBColor pixel(int x, int y) const
 		{
 			while (x < 0) { x += m_width; }
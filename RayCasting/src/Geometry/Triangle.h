@@ -215,6 +215,14 @@ namespace Geometry
 			return (vertex(0) + vertex(1) + vertex(2)) / 3;
 		}
 
+		/// <summary>
+		/// Returns true if the vertices have texture coordinates.
+		/// </summary>
+		bool hasTextureCoordinates() const
+		{
+			return m_textureCoordinates[0] != NULL;
+		}
+
 		/// <summary>
 		/// Gets the textures coordinates of a vertex.
 		/// </summary>
@@ -530,6 +538,17 @@ namespace Geometry
 		{
 			double r = (double)rand() / RAND_MAX;
 			double s = (double)rand() / RAND_MAX;
+			return sampleBarycentric(r, s);
+		}
+
+		/// <summary>
+		/// Computes barycentric coordinates uniformly distributed on the triangle from two uniform values.
+		/// </summary>
+		/// <param name="r">A uniform value in [0;1].</param>
+		/// <param name="s">A uniform value in [0;1].</param>
+		/// <returns></returns>
+		static Math::Vector3f sampleBarycentric(double r, double s)
+		{
 			double a = double(1.0) - sqrt(s);
 			double b = (double)((1.0 - r)*sqrt(s));
 			double c = r*sqrt(s);
@@ -543,8 +562,7 @@ namespace Geometry
 		/// <returns></returns>
 		Math::Vector3f pointFromBraycentric(const Math::Vector3f & barycentric) const
 		{
-			Math::Vector3f tmp = randomBarycentric();
-			return ((*m_vertex[0]) * tmp[0] + (*m_vertex[1]) * tmp[1] + (*m_vertex[2]) * tmp[2]);
+			return ((*m_vertex[0]) * barycentric[0] + (*m_vertex[1]) * barycentric[1] + (*m_vertex[2]) * barycentric[2]);
 		}
 
 		/// <summary>
@@ -554,7 +572,7 @@ namespace Geometry
 		/// <returns> The color of the texture at the given barycentric coordinates</returns>
 		RGBColor sampleTexture(const Math::Vector3f & barycentic) const
 		{
-			if (m_material->hasTexture())
+			if (m_material->hasTexture() && hasTextureCoordinates())
 			{
 				Math::Vector2f textureCoord = textureCoordinate(0)*barycentic[0] + textureCoordinate(1)*barycentic[1] + textureCoordinate(2)*barycentic[2];
 				return m_material->getTexture().pixel(textureCoord);
@@ -562,6 +580,27 @@ namespace Geometry
 			return RGBColor(1.0, 1.0, 1.0);
 		}
 
+		/// <summary>
+		/// Computes the emissive color of the material modulated by the texture averaged on the triangle 
+		/// (subdivisions^2 stratified samples). Used to weight textured emitters when sampling lights.
+		/// </summary>
+		/// <param name="subdivisions"> The number of strata per dimension</param>
+		/// <returns> The average emitted color of the triangle</returns>
+		RGBColor averageEmission(int subdivisions = 4) const
+		{
+			const RGBColor & emissive = m_material->getEmissive();
+			if (emissive.isBlack() || !m_material->hasTexture() || !hasTextureCoordinates()) { return emissive; }
+			RGBColor sum;
+			for (int i = 0; i < subdivisions; ++i)
+			{
+				for (int j = 0; j < subdivisions; ++j)
+				{
+					sum = sum + sampleTexture(sampleBarycentric((i + 0.5) / subdivisions, (j + 0.5) / subdivisions));
+				}
+			}
+			return emissive * sum / double(subdivisions*subdivisions);
+		}
+
 		/// <summary>
 		///  Computes a random point on the triangle
 		/// </summary>
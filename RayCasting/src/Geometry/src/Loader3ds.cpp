@@ -1,5 +1,6 @@
 #include <Geometry/Loader3ds.h>
 #include <lib3ds/mesh.h>
+#include <System/Trace.h>
 
 namespace Geometry
 {
@@ -85,6 +86,7 @@ namespace Geometry
 
 	Loader3ds::Loader3ds( const ::std::string & filename, const ::std::string & texturePath )
 	{
+		TraceScope("Loader3ds", "load", filename.c_str());
 		::std::cout<<"Loader3ds: loading file "<<filename<<::std::endl; 
 		m_file = lib3ds_file_load(filename.c_str()) ;
 		if(m_file==NULL)
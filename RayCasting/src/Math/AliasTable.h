@@ -0,0 +1,107 @@
+#ifndef _Math_AliasTable_H
+#define _Math_AliasTable_H
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
+namespace Math
+{
+	/// <summary>
+	/// Walker's alias table (built with Vose's method): samples an index with a probability proportional to its
+	/// weight in constant time from one uniform value. The table is immutable once built, so it can be queried
+	/// concurrently.
+	/// </summary>
+	class AliasTable
+	{
+	protected:
+		/// <summary> The probability of keeping the index of a cell (else its alias is returned). </summary>
+		::std::vector<double> m_threshold;
+		::std::vector<size_t> m_alias;
+		/// <summary> The normalized weights. </summary>
+		::std::vector<double> m_probability;
+
+	public:
+		/// <summary>
+		/// Builds the table from non negative weights (a null total gives uniform probabilities).
+		/// </summary>
+		void build(const ::std::vector<double> & weights)
+		{
+			const size_t size = weights.size();
+			m_threshold.assign(size, 1.0);
+			m_alias.resize(size);
+			m_probability.assign(size, 0.0);
+			if (size == 0) { return; }
+			double total = 0.0;
+			for (double weight : weights) { total += weight; }
+			::std::vector<double> scaled(size);
+			for (size_t cpt = 0; cpt < size; ++cpt)
+			{
+				m_probability[cpt] = (total > 0.0) ? weights[cpt] / total : 1.0 / size;
+				scaled[cpt] = m_probability[cpt] * size;
+				m_alias[cpt] = cpt;
+			}
+			::std::vector<size_t> small, large;
+			for (size_t cpt = 0; cpt < size; ++cpt)
+			{
+				(scaled[cpt] < 1.0 ? small : large).push_back(cpt);
+			}
+			while (!small.empty() && !large.empty())
+			{
+				size_t less = small.back();
+				small.pop_back();
+				size_t more = large.back();
+				m_threshold[less] = scaled[less];
+				m_alias[less] = more;
+				scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+				if (scaled[more] < 1.0)
+				{
+					large.pop_back();
+					small.push_back(more);
+				}
+			}
+			// The remaining cells are full (up to rounding errors)
+			for (size_t cell : small) { m_threshold[cell] = 1.0; }
+			for (size_t cell : large) { m_threshold[cell] = 1.0; }
+		}
+
+		size_t size() const
+		{
+			return m_probability.size();
+		}
+
+		bool empty() const
+		{
+			return m_probability.empty();
+		}
+
+		/// <summary>
+		/// Samples an index from a uniform value in [0;1). The table must not be empty.
+		/// </summary>
+		size_t sample(double u) const
+		{
+			const size_t size = m_probability.size();
+			double scaled = u * size;
+			size_t cell = ::std::min((size_t)scaled, size - 1);
+			return (scaled - cell < m_threshold[cell]) ? cell : m_alias[cell];
+		}
+
+		/// <summary>
+		/// Returns the probability of sampling an index.
+		/// </summary>
+		double probability(size_t index) const
+		{
+			return m_probability[index];
+		}
+
+		/// <summary>
+		/// Returns the memory used by the table in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_threshold.capacity()*sizeof(double) + m_alias.capacity()*sizeof(size_t) + m_probability.capacity()*sizeof(double);
+		}
+	};
+}
+
+#endif
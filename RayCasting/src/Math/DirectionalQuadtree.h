@@ -0,0 +1,252 @@
+#ifndef _Math_DirectionalQuadtree_H
+#define _Math_DirectionalQuadtree_H
+
+#include <Math/Vectorf.h>
+#include <Math/Constant.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+
+namespace Math
+{
+	/// <summary>
+	/// A piecewise constant distribution of directions (Muller et al. 17, practical path guiding): the sphere is
+	/// mapped on the unit square by the cylindrical coordinates (cos(theta), phi), which preserve the areas, and the
+	/// square is adaptively subdivided by a quadtree. Each node stores the energy of its four quadrants. The energy
+	/// is recorded concurrently (atomic additions along the path of the direction), a direction is sampled by
+	/// descending from the root with probabilities proportional to the energies of the quadrants. The topology of
+	/// the tree is rebuilt from the energy of another tree so that the quadrants with more energy are finer.
+	/// </summary>
+	class DirectionalQuadtree
+	{
+	protected:
+		struct Node
+		{
+			::std::atomic<float> energy[4];
+			/// <summary> The index of the node of each quadrant, 0 for a leaf (the root is never a child). </summary>
+			::std::uint32_t child[4];
+
+			Node()
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					energy[c].store(0.0f, ::std::memory_order_relaxed);
+					child[c] = 0;
+				}
+			}
+
+			Node(const Node & other)
+			{
+				*this = other;
+			}
+
+			Node & operator=(const Node & other)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					energy[c].store(other.energy[c].load(::std::memory_order_relaxed), ::std::memory_order_relaxed);
+					child[c] = other.child[c];
+				}
+				return *this;
+			}
+
+			float total() const
+			{
+				return energy[0].load(::std::memory_order_relaxed) + energy[1].load(::std::memory_order_relaxed)
+					+ energy[2].load(::std::memory_order_relaxed) + energy[3].load(::std::memory_order_relaxed);
+			}
+		};
+
+		::std::vector<Node> m_nodes;
+
+		static const int maxDepth = 20;
+
+		static void add(::std::atomic<float> & target, float value)
+		{
+			float current = target.load(::std::memory_order_relaxed);
+			while (!target.compare_exchange_weak(current, current + value, ::std::memory_order_relaxed))
+			{}
+		}
+
+		/// <summary>
+		/// The quadrant of a point of the square [0;1)^2 (1: right half, 2: upper half) and the point in the quadrant.
+		/// </summary>
+		static int quadrant(double & x, double & y)
+		{
+			int result = 0;
+			x *= 2.0;
+			y *= 2.0;
+			if (x >= 1.0) { result += 1; x -= 1.0; }
+			if (y >= 1.0) { result += 2; y -= 1.0; }
+			return result;
+		}
+
+		/// <summary>
+		/// Creates the subtree of a quadrant of energy energy (source: the node of the quadrant in the source tree,
+		/// 0 if the source quadrant is a leaf) while its share of the total energy exceeds the threshold.
+		/// </summary>
+		void refine(const DirectionalQuadtree & source, ::std::uint32_t sourceNode, float energy, float total, double threshold, int depth, ::std::uint32_t node, int quadrant)
+		{
+			if (depth >= maxDepth || energy <= threshold*total) { return; }
+			const ::std::uint32_t created = (::std::uint32_t)m_nodes.size();
+			m_nodes.push_back(Node());
+			m_nodes[node].child[quadrant] = created;
+			for (int c = 0; c < 4; ++c)
+			{
+				// A leaf of the source spreads its energy uniformly on its quadrants
+				const float childEnergy = (sourceNode != 0) ? source.m_nodes[sourceNode].energy[c].load(::std::memory_order_relaxed) : energy / 4.0f;
+				const ::std::uint32_t childSource = (sourceNode != 0) ? source.m_nodes[sourceNode].child[c] : 0;
+				refine(source, childSource, childEnergy, total, threshold, depth + 1, created, c);
+			}
+		}
+
+	public:
+		/// <summary>
+		/// Constructor: the uniform distribution (a root without energy).
+		/// </summary>
+		DirectionalQuadtree()
+			: m_nodes(1)
+		{}
+
+		/// <summary>
+		/// Maps a direction on the unit square (cylindrical coordinates, area preserving).
+		/// </summary>
+		static void toSquare(Vector3f const & direction, double & x, double & y)
+		{
+			x = ::std::min(::std::max((direction[2] + 1.0)*0.5, 0.0), 1.0 - 1e-9);
+			double phi = atan2(direction[1], direction[0]);
+			if (phi < 0.0) { phi += 2.0*pi; }
+			y = ::std::min(phi / (2.0*pi), 1.0 - 1e-9);
+		}
+
+		/// <summary>
+		/// Maps a point of the unit square on the sphere (inverse of DirectionalQuadtree::toSquare).
+		/// </summary>
+		static Vector3f fromSquare(double x, double y)
+		{
+			const double cosTheta = 2.0*x - 1.0;
+			const double sinTheta = sqrt(::std::max(0.0, 1.0 - cosTheta*cosTheta));
+			const double phi = 2.0*pi*y;
+			return makeVector(sinTheta*cos(phi), sinTheta*sin(phi), cosTheta);
+		}
+
+		/// <summary>
+		/// Returns the recorded energy.
+		/// </summary>
+		double energy() const
+		{
+			return m_nodes[0].total();
+		}
+
+		size_t nodeCount() const
+		{
+			return m_nodes.size();
+		}
+
+		/// <summary>
+		/// Returns the memory used by the tree in bytes.
+		/// </summary>
+		size_t memorySize() const
+		{
+			return m_nodes.capacity()*sizeof(Node);
+		}
+
+		/// <summary>
+		/// Adds energy to a direction (normalized). Can be called concurrently.
+		/// </summary>
+		void record(Vector3f const & direction, float value)
+		{
+			if (!(value > 0.0f)) { return; }
+			double x, y;
+			toSquare(direction, x, y);
+			::std::uint32_t node = 0;
+			for (;;)
+			{
+				const int c = quadrant(x, y);
+				add(m_nodes[node].energy[c], value);
+				if (m_nodes[node].child[c] == 0) { return; }
+				node = m_nodes[node].child[c];
+			}
+		}
+
+		/// <summary>
+		/// Samples a direction from two uniform values in [0;1). A tree without energy samples uniform directions.
+		/// </summary>
+		/// <param name="density">Receives the solid angle density of the direction.</param>
+		Vector3f sample(double xi1, double xi2, double & density) const
+		{
+			double x = 0.0, y = 0.0;
+			double size = 1.0;
+			double squareDensity = 1.0;
+			if (m_nodes[0].total() > 0.0f)
+			{
+				::std::uint32_t node = 0;
+				for (;;)
+				{
+					const Node & current = m_nodes[node];
+					const double total = current.total();
+					double e[4];
+					for (int c = 0; c < 4; ++c) { e[c] = current.energy[c].load(::std::memory_order_relaxed) / total; }
+					// Chooses the column (right half) then the row (upper half) of the quadrant
+					const double right = e[1] + e[3];
+					int c = 0;
+					if (xi1 < 1.0 - right) { xi1 = xi1 / (1.0 - right); }
+					else { c = 1; xi1 = ::std::min((xi1 - (1.0 - right)) / right, 1.0 - 1e-12); }
+					const double upper = (e[c] + e[c + 2] > 0.0) ? e[c + 2] / (e[c] + e[c + 2]) : 0.5;
+					if (xi2 < 1.0 - upper) { xi2 = xi2 / (1.0 - upper); }
+					else { c += 2; xi2 = ::std::min((xi2 - (1.0 - upper)) / upper, 1.0 - 1e-12); }
+					size *= 0.5;
+					if (c & 1) { x += size; }
+					if (c & 2) { y += size; }
+					squareDensity *= 4.0*e[c];
+					if (current.child[c] == 0) { break; }
+					node = current.child[c];
+				}
+			}
+			density = squareDensity / (4.0*pi);
+			return fromSquare(x + xi1*size, y + xi2*size);
+		}
+
+		/// <summary>
+		/// Returns the solid angle density of DirectionalQuadtree::sample for a direction (normalized).
+		/// </summary>
+		double pdf(Vector3f const & direction) const
+		{
+			double squareDensity = 1.0;
+			if (m_nodes[0].total() > 0.0f)
+			{
+				double x, y;
+				toSquare(direction, x, y);
+				::std::uint32_t node = 0;
+				for (;;)
+				{
+					const Node & current = m_nodes[node];
+					const int c = quadrant(x, y);
+					squareDensity *= 4.0*current.energy[c].load(::std::memory_order_relaxed) / current.total();
+					if (current.child[c] == 0 || squareDensity <= 0.0) { break; }
+					node = current.child[c];
+				}
+			}
+			return squareDensity / (4.0*pi);
+		}
+
+		/// <summary>
+		/// Rebuilds the tree without energy: a quadrant is subdivided while its share of the energy of the source
+		/// tree exceeds the threshold. A source without energy gives a single node.
+		/// </summary>
+		void rebuild(const DirectionalQuadtree & source, double threshold)
+		{
+			m_nodes.assign(1, Node());
+			const float total = source.m_nodes[0].total();
+			if (!(total > 0.0f)) { return; }
+			for (int c = 0; c < 4; ++c)
+			{
+				refine(source, source.m_nodes[0].child[c], source.m_nodes[0].energy[c].load(::std::memory_order_relaxed), total, threshold, 1, 0, c);
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _Math_PixelSampler_H
+#define _Math_PixelSampler_H
+
+#include <stdlib.h>
+#include <utility>
+
+namespace Math
+{
+	/// <summary>
+	/// Source of uniform random numbers in [0;1) for one sample of one pixel. Each bounce of a path
+	/// owns a fixed block of dimensions so that a given dimension always drives the same decision
+	/// (lens position, light choice, light position, BSDF direction, russian roulette). This fixed
+	/// allocation is what allows low discrepancy samplers to stratify each decision.
+	/// </summary>
+	class PixelSampler
+	{
+	public:
+		/// <summary>
+		/// The dimensions allocated to each bounce. Two dimensional decisions use two consecutive dimensions.
+		/// </summary>
+		enum Dimension
+		{
+			LightChoice = 0,
+			LightPosition = 1,
+			BsdfDirection = 3,
+			Roulette = 5,
+			DimensionsPerBounce = 6
+		};
+
+		/// <summary>
+		/// The number of dimensions used by the camera (sub pixel position / lens) before the first bounce.
+		/// </summary>
+		static const unsigned int CameraDimensions = 2;
+
+		virtual ~PixelSampler()
+		{}
+
+		/// <summary>
+		/// Returns the value of the given absolute dimension for the current sample.
+		/// </summary>
+		/// <param name="dimension">The absolute dimension.</param>
+		/// <returns>A value in [0;1)</returns>
+		virtual double get(unsigned int dimension) const = 0;
+
+		/// <summary>
+		/// Returns the value associated with a decision at a given bounce.
+		/// </summary>
+		/// <param name="bounce">The bounce index (0 for the first intersection).</param>
+		/// <param name="dimension">The decision.</param>
+		/// <returns>A value in [0;1)</returns>
+		double get(unsigned int bounce, Dimension dimension) const
+		{
+			return get(CameraDimensions + bounce*DimensionsPerBounce + dimension);
+		}
+
+		/// <summary>
+		/// Returns the two values associated with a two dimensional decision at a given bounce.
+		/// </summary>
+		/// <param name="bounce">The bounce index (0 for the first intersection).</param>
+		/// <param name="dimension">The first dimension of the decision.</param>
+		/// <returns></returns>
+		::std::pair<double, double> get2D(unsigned int bounce, Dimension dimension) const
+		{
+			unsigned int first = CameraDimensions + bounce*DimensionsPerBounce + dimension;
+			return ::std::make_pair(get(first), get(first + 1));
+		}
+
+		/// <summary>
+		/// Returns the two values used to place the sample in the pixel footprint (lens).
+		/// </summary>
+		/// <returns></returns>
+		::std::pair<double, double> lens() const
+		{
+			return ::std::make_pair(get(0u), get(1u));
+		}
+	};
+
+	/// <summary>
+	/// A view of a pixel sampler starting at a later bounce: bounce b of this sampler is bounce b+offset of the
+	/// underlying sampler. Allows a path started at a bounce to use the dimensions of the following bounces.
+	/// </summary>
+	class ShiftedPixelSampler : public PixelSampler
+	{
+	protected:
+		const PixelSampler & m_sampler;
+		unsigned int m_offset;
+
+	public:
+		using PixelSampler::get;
+
+		ShiftedPixelSampler(PixelSampler const & sampler, unsigned int offset)
+			: m_sampler(sampler), m_offset(offset*DimensionsPerBounce)
+		{}
+
+		double get(unsigned int dimension) const
+		{
+			return m_sampler.get(dimension + m_offset);
+		}
+	};
+
+	/// <summary>
+	/// A pixel sampler returning independent pseudo random numbers (the historical behaviour of the renderer).
+	/// </summary>
+	class RandomPixelSampler : public PixelSampler
+	{
+	public:
+		using PixelSampler::get;
+
+		double get(unsigned int) const
+		{
+			return (double)rand() / ((double)RAND_MAX + 1.0);
+		}
+	};
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <Math/sobol.h>
+#include <Math/PixelSampler.h>
 
 namespace Math
 {
@@ -38,12 +39,24 @@ namespace Math
 		{
 			//double rand1 = random() ;
 			double rand1 = Math::Sobol::sample(m_index, 0, m_scramble);
-			double p = pow(rand1, 1/(n+1)) ;
-			double theta = acos(p) ;
 			//double rand2 = random() ;
 			double rand2 = Math::Sobol::sample(m_index, 1, m_scramble);
-			double phy = (double)(2*M_PI*rand2) ;
 			m_index++;
+			return polar(rand1, rand2, n) ;
+		}
+
+		/// <summary>
+		/// Maps two uniform values to spherical coordinates repecting a cos^n distribution.
+		/// </summary>
+		/// <param name="rand1">A uniform value in [0;1) driving theta.</param>
+		/// <param name="rand2">A uniform value in [0;1) driving phi.</param>
+		/// <param name="n">The shininess (1.0 if diffuse).</param>
+		/// <returns></returns>
+		static ::std::pair<double,double> polar(double rand1, double rand2, double n)
+		{
+			double p = pow(rand1, 1/(n+1)) ;
+			double theta = acos(p) ;
+			double phy = (double)(2*M_PI*rand2) ;
 			return ::std::make_pair(theta, phy) ;
 		}
 
@@ -146,7 +159,39 @@ namespace Math
 		////////////////////////////////////////////////////////////////////////////////////////////////////
 		Math::Vector3f generate() const
 		{
-			::std::pair<double,double> perturbation = randomPolar(m_n) ;
+			return getDirection(randomPolar(m_n)) ;
+		}
+
+		/// <summary>
+		/// Generates a direction respecting a cosine^n distribution from two uniform values. This is the 
+		/// entry point for (quasi) Monte Carlo samplers.
+		/// </summary>
+		/// <param name="xi1">A uniform value in [0;1).</param>
+		/// <param name="xi2">A uniform value in [0;1).</param>
+		/// <returns>The direction.</returns>
+		Math::Vector3f generate(double xi1, double xi2) const
+		{
+			return getDirection(polar(xi1, xi2, m_n)) ;
+		}
+
+		/// <summary>
+		/// Generates a direction using the BSDF dimensions of a pixel sampler at the given bounce.
+		/// </summary>
+		/// <param name="sampler">The pixel sampler.</param>
+		/// <param name="bounce">The bounce index.</param>
+		/// <returns>The direction.</returns>
+		Math::Vector3f generate(PixelSampler const & sampler, unsigned int bounce) const
+		{
+			::std::pair<double, double> xi = sampler.get2D(bounce, PixelSampler::BsdfDirection) ;
+			return generate(xi.first, xi.second) ;
+		}
+
+	protected:
+		/// <summary>
+		/// Rotates the main direction by the provided spherical coordinates.
+		/// </summary>
+		Math::Vector3f getDirection(::std::pair<double,double> const & perturbation) const
+		{
 			Math::Quaternion<double> q1(m_directionNormal, perturbation.first) ;
 			Math::Quaternion<double> q2(m_direction, perturbation.second) ;
 			Math::Quaternion<double> result = q2.rotate(q1.rotate(m_direction)) ;
@@ -0,0 +1,117 @@
+#ifndef _Math_SobolSampler_H
+#define _Math_SobolSampler_H
+
+#include <Math/PixelSampler.h>
+#include <Math/sobol.h>
+
+namespace Math
+{
+	/// <summary>
+	/// Owen scrambled Sobol sampler. Each pixel owns its own scrambling seed and walks the Sobol
+	/// sequence with the sample index (i.e. the rendering pass). The scrambling is the hash based
+	/// nested uniform scrambling of Burley ("Practical Hash-based Owen Scrambling", JCGT 2020): it keeps
+	/// the stratification of the sequence while decorrelating pixels and dimensions.
+	/// </summary>
+	class SobolSampler : public PixelSampler
+	{
+	protected:
+		/// <summary> The seed of the pixel. </summary>
+		unsigned int m_seed;
+		/// <summary> The shuffled index of the sample in the Sobol sequence. </summary>
+		unsigned int m_index;
+		/// <summary> The unshuffled sample index (used for dimensions beyond the Sobol table). </summary>
+		unsigned long long m_sampleIndex;
+
+		static unsigned int reverseBits(unsigned int x)
+		{
+			x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+			x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+			x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+			x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+			return (x >> 16) | (x << 16);
+		}
+
+		static unsigned int laineKarrasPermutation(unsigned int x, unsigned int seed)
+		{
+			x += seed;
+			x ^= x * 0x6c50b47cu;
+			x ^= x * 0xb82f1e52u;
+			x ^= x * 0xc7afe638u;
+			x ^= x * 0x8d22f6e6u;
+			return x;
+		}
+
+		/// <summary>
+		/// Owen scrambling of a 32 bits fixed point value: each bit is flipped depending on the bits above it.
+		/// </summary>
+		static unsigned int nestedUniformScramble(unsigned int x, unsigned int seed)
+		{
+			return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+		}
+
+	public:
+		using PixelSampler::get;
+
+		/// <summary>
+		/// A 32 bits integer hash (lowbias32).
+		/// </summary>
+		static unsigned int hash(unsigned int x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		/// <summary>
+		/// Combines a value with a seed.
+		/// </summary>
+		static unsigned int hashCombine(unsigned int seed, unsigned int value)
+		{
+			return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+		}
+
+		/// <summary>
+		/// Computes the scrambling seed of a pixel.
+		/// </summary>
+		/// <param name="x">The x coordinate of the pixel.</param>
+		/// <param name="y">The y coordinate of the pixel.</param>
+		/// <param name="seed">A global seed (changes the whole image noise pattern).</param>
+		/// <returns></returns>
+		static unsigned int pixelSeed(int x, int y, unsigned int seed = 0)
+		{
+			return hash(hashCombine(hashCombine(hash(seed), (unsigned int)x), (unsigned int)y));
+		}
+
+		/// <summary>
+		/// Initializes the sampler for a given sample of a pixel.
+		/// </summary>
+		/// <param name="seed">The seed of the pixel (see pixelSeed).</param>
+		/// <param name="sampleIndex">The index of the sample, the same pixel must use successive indices.</param>
+		SobolSampler(unsigned int seed, unsigned long long sampleIndex)
+			: m_seed(seed), m_sampleIndex(sampleIndex)
+		{
+			m_index = nestedUniformScramble((unsigned int)sampleIndex, hash(seed));
+		}
+
+		double get(unsigned int dimension) const
+		{
+			unsigned int dimensionSeed = hashCombine(m_seed, hash(dimension));
+			unsigned int bits;
+			if (dimension < Sobol::Matrices::num_dimensions)
+			{
+				bits = nestedUniformScramble(Sobol::sampleBits(m_index, dimension), dimensionSeed);
+			}
+			else
+			{
+				// Out of the Sobol table: falls back on a hashed (pseudo random) value
+				bits = hash(hashCombine(dimensionSeed, (unsigned int)m_sampleIndex ^ (unsigned int)(m_sampleIndex >> 32)));
+			}
+			return bits * (1.0 / 4294967296.0);
+		}
+	};
+}
+
+#endif
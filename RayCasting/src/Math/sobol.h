@@ -60,6 +60,25 @@ namespace Math
 			return result * (1.0 / (1ULL << Matrices::size));
 		}
 
+		// Same as sample, but returns the 32 most significant bits of the
+		// unscrambled component as an integer. This is the form expected by
+		// bit-level scrambles such as Owen scrambling.
+		inline unsigned int sampleBits(
+			unsigned long long index,
+			const unsigned dimension)
+		{
+			assert(dimension < Matrices::num_dimensions);
+
+			unsigned long long result = 0ULL;
+			for (unsigned i = dimension * Matrices::size; index; index >>= 1, ++i)
+			{
+				if (index & 1)
+					result ^= Matrices::matrices[i];
+			}
+
+			return (unsigned int)(result >> (Matrices::size - 32));
+		}
+
 	} // namespace sobol
 }
 
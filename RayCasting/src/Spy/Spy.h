@@ -1,5 +1,6 @@
 /*
  *  Macros d'aide au debug.
+ *  Dfinir la macro Use_SpyCounters pour compter les rayons (voir Spy::RayCounters).
  *  Dfinir la macro Use_Spy pour utiliser les fonctionnalits.
  *  Dfinir la macro SpyLevel fournissant le niveau des affichages.
  *
@@ -7,6 +8,9 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
 
 #ifndef _Spy_Spy_H
 #define _Spy_Spy_H
@@ -27,12 +31,178 @@
 
 #endif
 
+#ifdef Use_SpyCounters
+
+#define SpyCount(counter) (++::Spy::RayCounters::local().counter)
+#define SpyCountN(counter, n) (::Spy::RayCounters::local().counter += (n))
+#define SpyPathDepth(depth) (::Spy::RayCounters::local().addPathDepth(depth))
+
+#else
+
+#define SpyCount(counter)
+#define SpyCountN(counter, n)
+#define SpyPathDepth(depth)
+
+#endif
+
 namespace Spy
 {
 	inline void verify(bool value, std::string const & message)
 	{
 		Spy_ConditionnalCode( if(!value) { std::cout<<message<<std::endl ; } ) 
 	}
+
+	/// <summary>
+	/// Ray tracing counters. Each thread increments its own counters (see RayCounters::local) through the
+	/// SpyCount, SpyCountN and SpyPathDepth macros, so the hot path has no atomic operation nor lock. The
+	/// macros are empty unless Use_SpyCounters is defined.
+	/// </summary>
+	class RayCounters
+	{
+	public:
+		enum RayType { Primary, Shadow, Reflection, Diffuse, RayTypes };
+		enum { MaxPathDepth = 32 };
+
+		/// <summary> The number of rays per type. </summary>
+		unsigned long long rays[RayTypes];
+		/// <summary> The number of BVH nodes visited. </summary>
+		unsigned long long nodes;
+		/// <summary> The number of ray / bounding box tests. </summary>
+		unsigned long long boxTests;
+		/// <summary> The number of ray / triangle tests. </summary>
+		unsigned long long triangleTests;
+		/// <summary> The number of rays hitting / missing the scene. </summary>
+		unsigned long long hits;
+		unsigned long long misses;
+		/// <summary> The number of paths per depth of their last ray (the last entry gathers the deeper paths). </summary>
+		unsigned long long pathDepth[MaxPathDepth + 1];
+
+		RayCounters()
+		{ reset(); }
+
+		void reset()
+		{
+			::std::fill(rays, rays + RayTypes, 0ULL);
+			nodes = boxTests = triangleTests = hits = misses = 0;
+			::std::fill(pathDepth, pathDepth + MaxPathDepth + 1, 0ULL);
+		}
+
+		void addPathDepth(int depth)
+		{
+			++pathDepth[::std::min(::std::max(depth, 0), (int)MaxPathDepth)];
+		}
+
+		RayCounters & operator+= (RayCounters const & other)
+		{
+			for (int i = 0; i < RayTypes; ++i) { rays[i] += other.rays[i]; }
+			nodes += other.nodes;
+			boxTests += other.boxTests;
+			triangleTests += other.triangleTests;
+			hits += other.hits;
+			misses += other.misses;
+			for (int i = 0; i <= MaxPathDepth; ++i) { pathDepth[i] += other.pathDepth[i]; }
+			return *this;
+		}
+
+		/// <summary>
+		/// Returns the counters of the calling thread.
+		/// </summary>
+		static RayCounters & local();
+
+		/// <summary>
+		/// Returns the sum of the counters of all the threads. The counters of running threads are read without
+		/// synchronization, call it when no rendering is in progress.
+		/// </summary>
+		static RayCounters total();
+
+		/// <summary>
+		/// Resets the counters of all the threads (same restriction as RayCounters::total).
+		/// </summary>
+		static void resetAll();
+
+		void print(::std::ostream & out) const
+		{
+			const unsigned long long casted = hits + misses;
+			const double perRay = (casted > 0) ? 1.0 / casted : 0.0;
+			out << "Rays: " << casted << " (primary " << rays[Primary] << ", shadow " << rays[Shadow] << ", reflection " << rays[Reflection] << ", diffuse " << rays[Diffuse] << ")" << ::std::endl;
+			out << "Rays: " << hits << " hits, " << misses << " misses" << ::std::endl;
+			out << "BVH: " << nodes << " nodes visited (" << nodes*perRay << "/ray), " << boxTests << " box tests (" << boxTests*perRay << "/ray), "
+				<< triangleTests << " triangle tests (" << triangleTests*perRay << "/ray)" << ::std::endl;
+			int last = MaxPathDepth;
+			while (last > 0 && pathDepth[last] == 0) { --last; }
+			out << "Path depth:";
+			for (int i = 0; i <= last; ++i) { out << " " << i << ((i == MaxPathDepth) ? "+" : "") << ":" << pathDepth[i]; }
+			out << ::std::endl;
+		}
+
+	protected:
+		friend class ThreadRayCounters;
+
+		struct Registry;
+
+		static Registry & registry();
+	};
+
+	/// <summary> The counters of the running threads and the counters of the terminated threads. </summary>
+	struct RayCounters::Registry
+	{
+		::std::mutex mutex;
+		::std::vector<RayCounters*> threads;
+		RayCounters terminated;
+	};
+
+	inline RayCounters::Registry & RayCounters::registry()
+	{
+		static Registry result;
+		return result;
+	}
+
+	/// <summary>
+	/// The counters of a thread, registered for the lifetime of the thread (only the registration locks).
+	/// </summary>
+	class ThreadRayCounters
+	{
+	public:
+		RayCounters counters;
+
+		ThreadRayCounters()
+		{
+			RayCounters::Registry & registry = RayCounters::registry();
+			::std::lock_guard<::std::mutex> lock(registry.mutex);
+			registry.threads.push_back(&counters);
+		}
+
+		~ThreadRayCounters()
+		{
+			RayCounters::Registry & registry = RayCounters::registry();
+			::std::lock_guard<::std::mutex> lock(registry.mutex);
+			registry.terminated += counters;
+			registry.threads.erase(::std::find(registry.threads.begin(), registry.threads.end(), &counters));
+		}
+	};
+
+	inline RayCounters & RayCounters::local()
+	{
+		static thread_local ThreadRayCounters result;
+		return result.counters;
+	}
+
+	inline RayCounters RayCounters::total()
+	{
+		Registry & registry = RayCounters::registry();
+		::std::lock_guard<::std::mutex> lock(registry.mutex);
+		RayCounters result = registry.terminated;
+		for (RayCounters * counters : registry.threads) { result += *counters; }
+		return result;
+	}
+
+	inline void RayCounters::resetAll()
+	{
+		Registry & registry = RayCounters::registry();
+		::std::lock_guard<::std::mutex> lock(registry.mutex);
+		registry.terminated.reset();
+		for (RayCounters * counters : registry.threads) { counters->reset(); }
+	}
 } 
 
 #undef Spy_ConditionnalCode
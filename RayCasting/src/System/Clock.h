@@ -0,0 +1,43 @@
+#ifndef _System_Clock_H
+#define _System_Clock_H
+
+#include <chrono>
+
+namespace System
+{
+	/// <summary>
+	/// A portable high resolution wall clock measuring the time elapsed since its creation (or its last restart).
+	/// It relies on a steady clock, so measures are not affected by system time adjustments.
+	/// </summary>
+	class Clock
+	{
+	protected:
+		typedef ::std::chrono::steady_clock clock_type;
+
+		/// <summary> The reference time. </summary>
+		clock_type::time_point m_start;
+
+	public:
+		Clock()
+			: m_start(clock_type::now())
+		{}
+
+		/// <summary>
+		/// Sets the reference time to now.
+		/// </summary>
+		void restart()
+		{
+			m_start = clock_type::now();
+		}
+
+		/// <summary>
+		/// Returns the time elapsed since the reference time, in seconds.
+		/// </summary>
+		double elapsed() const
+		{
+			return ::std::chrono::duration<double>(clock_type::now() - m_start).count();
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _System_Fingerprint_H
+#define _System_Fingerprint_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace System
+{
+	/// <summary>
+	/// A 64 bits FNV-1a hash accumulating values, used to recognize the data a file has been produced
+	/// from (see RenderCheckpoint and Lightmap). It is not a cryptographic hash.
+	/// </summary>
+	class Fingerprint
+	{
+	protected:
+		/// <summary> The current hash. </summary>
+		::std::uint64_t m_value;
+
+	public:
+		Fingerprint()
+			: m_value(0xcbf29ce484222325ull)
+		{}
+
+		/// <summary>
+		/// Adds raw bytes to the fingerprint.
+		/// </summary>
+		Fingerprint & add(const void * data, ::std::size_t size)
+		{
+			const unsigned char * bytes = (const unsigned char*)data;
+			for (::std::size_t cpt = 0; cpt < size; ++cpt)
+			{
+				m_value = (m_value ^ bytes[cpt]) * 0x100000001b3ull;
+			}
+			return *this;
+		}
+
+		/// <summary>
+		/// Adds a scalar value (an integer or a floating point number) to the fingerprint.
+		/// </summary>
+		template <class T>
+		Fingerprint & add(const T & value)
+		{
+			return add(&value, sizeof(T));
+		}
+
+		/// <summary>
+		/// Returns the hash of the added values.
+		/// </summary>
+		::std::uint64_t value() const
+		{
+			return m_value;
+		}
+	};
+}
+
+#endif
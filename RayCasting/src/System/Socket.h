@@ -0,0 +1,116 @@
+#ifndef _System_Socket_H
+#define _System_Socket_H
+
+#include <string>
+#include <cstddef>
+
+namespace System
+{
+	/// <summary>
+	/// A minimal blocking TCP socket (Winsock on Windows, BSD sockets elsewhere). Sockets are movable
+	/// but not copyable, the connection is closed by the destructor.
+	/// </summary>
+	class Socket
+	{
+	protected:
+		/// <summary> The native handle (SOCKET or file descriptor), -1 if invalid. </summary>
+		long long m_handle;
+
+		explicit Socket(long long handle)
+			: m_handle(handle)
+		{}
+
+	public:
+		Socket()
+			: m_handle(-1)
+		{}
+
+		Socket(Socket && other)
+			: m_handle(other.m_handle)
+		{
+			other.m_handle = -1;
+		}
+
+		Socket & operator= (Socket && other)
+		{
+			if (this != &other)
+			{
+				close();
+				m_handle = other.m_handle;
+				other.m_handle = -1;
+			}
+			return *this;
+		}
+
+		Socket(const Socket &) = delete;
+		Socket & operator= (const Socket &) = delete;
+
+		~Socket()
+		{
+			close();
+		}
+
+		/// <summary>
+		/// Creates a socket listening for connections.
+		/// </summary>
+		/// <param name="port">The port, 0 lets the system choose a free one (see Socket::port).</param>
+		/// <param name="remote">Listens on all the interfaces, otherwise only on the loopback one (local connections).</param>
+		/// <returns>The listening socket, invalid on failure.</returns>
+		static Socket listen(unsigned short port, bool remote = false);
+
+		/// <summary>
+		/// Connects to a listening socket.
+		/// </summary>
+		/// <param name="host">The host name or address.</param>
+		/// <param name="port">The port.</param>
+		/// <returns>The connected socket, invalid on failure.</returns>
+		static Socket connect(const ::std::string & host, unsigned short port);
+
+		/// <summary>
+		/// Accepts a connection on a listening socket (blocking).
+		/// </summary>
+		Socket accept();
+
+		/// <summary>
+		/// Waits until the socket is readable (data or pending connection).
+		/// </summary>
+		/// <param name="milliseconds">The timeout.</param>
+		/// <returns>true if the socket is readable, false on timeout.</returns>
+		bool wait(int milliseconds);
+
+		/// <summary>
+		/// Returns the local port the socket is bound to.
+		/// </summary>
+		unsigned short port() const;
+
+		/// <summary>
+		/// Sends a whole buffer.
+		/// </summary>
+		/// <returns>false if the connection has been lost.</returns>
+		bool send(const void * data, ::std::size_t size);
+
+		/// <summary>
+		/// Receives exactly size bytes.
+		/// </summary>
+		/// <returns>false if the connection has been lost.</returns>
+		bool receive(void * data, ::std::size_t size);
+
+		/// <summary>
+		/// Closes the socket.
+		/// </summary>
+		void close();
+
+		bool isValid() const
+		{ return m_handle != -1; }
+
+		template <class T>
+		bool send(const T & value)
+		{ return send(&value, sizeof(T)); }
+
+		template <class T>
+		bool receive(T & value)
+		{ return receive(&value, sizeof(T)); }
+	};
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef _System_Trace_H
+#define _System_Trace_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+namespace System
+{
+	/// <summary>
+	/// Records timed events per thread and writes them as a Chrome trace event file (JSON), which can be opened
+	/// in chrome://tracing or Perfetto. Events are recorded by System::ScopedTraceEvent (see the TraceScope macro)
+	/// in buffers owned by their thread, so recording takes no lock. When the trace is not started, an event
+	/// costs one atomic load.
+	/// </summary>
+	class Trace
+	{
+	public:
+		/// <summary> A complete event: a named interval of time of a thread. </summary>
+		struct Event
+		{
+			const char * name;
+			const char * category;
+			/// <summary> An optional argument shown with the event (e.g. a file name). </summary>
+			::std::string detail;
+			/// <summary> The start time and the duration, in microseconds. </summary>
+			long long begin;
+			long long duration;
+		};
+
+	protected:
+		/// <summary> The events of a thread. </summary>
+		struct ThreadEvents
+		{
+			int thread;
+			::std::vector<Event> events;
+		};
+
+		/// <summary> Registers the events of a thread for its lifetime, the events are kept when the thread ends. </summary>
+		class ThreadRegistration
+		{
+		public:
+			ThreadEvents events;
+
+			ThreadRegistration()
+			{
+				Trace & trace = Trace::instance();
+				::std::lock_guard<::std::mutex> lock(trace.m_mutex);
+				events.thread = trace.m_threadCount++;
+				trace.m_threads.push_back(&events);
+			}
+
+			~ThreadRegistration()
+			{
+				Trace & trace = Trace::instance();
+				::std::lock_guard<::std::mutex> lock(trace.m_mutex);
+				trace.m_terminated.push_back(events);
+				trace.m_threads.erase(::std::find(trace.m_threads.begin(), trace.m_threads.end(), &events));
+			}
+		};
+
+		::std::atomic<bool> m_enabled;
+		::std::string m_filename;
+		::std::chrono::steady_clock::time_point m_start;
+		::std::mutex m_mutex;
+		int m_threadCount;
+		::std::vector<ThreadEvents*> m_threads;
+		::std::vector<ThreadEvents> m_terminated;
+
+		Trace()
+			: m_enabled(false), m_threadCount(0)
+		{}
+
+		static ThreadEvents & localEvents()
+		{
+			static thread_local ThreadRegistration result;
+			return result.events;
+		}
+
+		static void writeString(::std::ostream & out, const ::std::string & value)
+		{
+			out << '"';
+			for (char c : value)
+			{
+				if (c == '"' || c == '\\') { out << '\\' << c; }
+				else if ((unsigned char)c < 0x20) { out << ' '; }
+				else { out << c; }
+			}
+			out << '"';
+		}
+
+		static void writeEvents(::std::ostream & out, const ThreadEvents & thread, bool & first)
+		{
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.thread << ",\"args\":{\"name\":\"Thread " << thread.thread << "\"}}";
+			first = false;
+			for (const Event & event : thread.events)
+			{
+				out << ",\n{\"name\":";
+				writeString(out, event.name);
+				out << ",\"cat\":";
+				writeString(out, event.category);
+				out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.thread << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration;
+				if (!event.detail.empty())
+				{
+					out << ",\"args\":{\"detail\":";
+					writeString(out, event.detail);
+					out << "}";
+				}
+				out << "}";
+			}
+		}
+
+	public:
+		static Trace & instance()
+		{
+			static Trace result;
+			return result;
+		}
+
+		/// <summary>
+		/// Starts recording, the events are written in a file by Trace::stop.
+		/// </summary>
+		void start(const ::std::string & filename)
+		{
+			::std::lock_guard<::std::mutex> lock(m_mutex);
+			m_filename = filename;
+			m_start = ::std::chrono::steady_clock::now();
+			m_enabled.store(true);
+		}
+
+		bool enabled() const
+		{ return m_enabled.load(::std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Returns the time elapsed since the start of the trace, in microseconds.
+		/// </summary>
+		long long now() const
+		{
+			return ::std::chrono::duration_cast<::std::chrono::microseconds>(::std::chrono::steady_clock::now() - m_start).count();
+		}
+
+		/// <summary>
+		/// Records an event of the calling thread.
+		/// </summary>
+		void record(Event && event)
+		{
+			localEvents().events.push_back(::std::move(event));
+		}
+
+		/// <summary>
+		/// Stops recording and writes the trace file. The buffers of the running threads are read without
+		/// synchronization, the other threads must not record events meanwhile.
+		/// </summary>
+		/// <returns>true if the file has been written (false if the trace has not been started).</returns>
+		bool stop()
+		{
+			if (!m_enabled.exchange(false)) { return false; }
+			::std::lock_guard<::std::mutex> lock(m_mutex);
+			::std::ofstream out(m_filename.c_str());
+			if (!out)
+			{
+				::std::cerr << "Trace: unable to write " << m_filename << ::std::endl;
+				return false;
+			}
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool first = true;
+			for (const ThreadEvents & thread : m_terminated) { writeEvents(out, thread, first); }
+			for (const ThreadEvents * thread : m_threads) { writeEvents(out, *thread, first); }
+			out << "\n]}\n";
+			for (ThreadEvents * thread : m_threads) { thread->events.clear(); }
+			m_terminated.clear();
+			return (bool)out;
+		}
+	};
+
+	/// <summary>
+	/// Records the lifetime of the object as a trace event (see System::Trace), nothing is done if the trace is not started.
+	/// </summary>
+	class ScopedTraceEvent
+	{
+	protected:
+		bool m_enabled;
+		Trace::Event m_event;
+
+	public:
+		/// <param name="name">The name of the event (must outlive the trace, e.g. a string literal).</param>
+		/// <param name="category">The category of the event (same restriction).</param>
+		/// <param name="detail">An optional argument copied in the event.</param>
+		ScopedTraceEvent(const char * name, const char * category, const char * detail = nullptr)
+			: m_enabled(Trace::instance().enabled())
+		{
+			if (m_enabled)
+			{
+				m_event.name = name;
+				m_event.category = category;
+				if (detail != nullptr) { m_event.detail = detail; }
+				m_event.begin = Trace::instance().now();
+			}
+		}
+
+		~ScopedTraceEvent()
+		{
+			if (m_enabled)
+			{
+				m_event.duration = Trace::instance().now() - m_event.begin;
+				Trace::instance().record(::std::move(m_event));
+			}
+		}
+	};
+}
+
+#define TraceConcatenate2(a, b) a##b
+#define TraceConcatenate(a, b) TraceConcatenate2(a, b)
+/// Records the enclosing scope as a trace event: TraceScope(name, category) or TraceScope(name, category, detail).
+#define TraceScope(...) ::System::ScopedTraceEvent TraceConcatenate(traceEvent, __LINE__)(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,179 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+#include <System/Socket.h>
+#include <cstring>
+#include <cstdio>
+
+namespace System
+{
+#ifdef _WIN32
+	typedef SOCKET NativeSocket;
+	typedef int IoSize;
+
+	static bool initializeNetwork()
+	{
+		static bool initialized = false;
+		if (!initialized)
+		{
+			WSADATA data;
+			initialized = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+		}
+		return initialized;
+	}
+
+	static void closeNative(NativeSocket handle)
+	{
+		closesocket(handle);
+	}
+#else
+	typedef int NativeSocket;
+	typedef size_t IoSize;
+	static const NativeSocket INVALID_SOCKET = -1;
+
+	static bool initializeNetwork()
+	{
+		return true;
+	}
+
+	static void closeNative(NativeSocket handle)
+	{
+		::close(handle);
+	}
+#endif
+
+#ifdef MSG_NOSIGNAL
+	// A lost peer must be reported by send, not kill the process with SIGPIPE
+	static const int SendFlags = MSG_NOSIGNAL;
+#else
+	static const int SendFlags = 0;
+#endif
+
+	static void disableNagle(NativeSocket handle)
+	{
+		// Messages are small requests followed by an answer, do not wait to fill packets
+		int flag = 1;
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+	}
+
+	Socket Socket::listen(unsigned short port, bool remote)
+	{
+		if (!initializeNetwork()) { return Socket(); }
+		NativeSocket handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (handle == INVALID_SOCKET) { return Socket(); }
+		int reuse = 1;
+		setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+		sockaddr_in address;
+		::std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(remote ? INADDR_ANY : INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		if (::bind(handle, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(handle, SOMAXCONN) != 0)
+		{
+			closeNative(handle);
+			return Socket();
+		}
+		return Socket((long long)handle);
+	}
+
+	Socket Socket::connect(const ::std::string & host, unsigned short port)
+	{
+		if (!initializeNetwork()) { return Socket(); }
+		addrinfo hints;
+		::std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		char service[16];
+		::std::snprintf(service, sizeof(service), "%u", (unsigned int)port);
+		addrinfo * addresses = nullptr;
+		if (getaddrinfo(host.c_str(), service, &hints, &addresses) != 0) { return Socket(); }
+		NativeSocket handle = INVALID_SOCKET;
+		for (addrinfo * current = addresses; current != nullptr; current = current->ai_next)
+		{
+			handle = ::socket(current->ai_family, current->ai_socktype, current->ai_protocol);
+			if (handle == INVALID_SOCKET) { continue; }
+			if (::connect(handle, current->ai_addr, (int)current->ai_addrlen) == 0) { break; }
+			closeNative(handle);
+			handle = INVALID_SOCKET;
+		}
+		freeaddrinfo(addresses);
+		if (handle == INVALID_SOCKET) { return Socket(); }
+		disableNagle(handle);
+		return Socket((long long)handle);
+	}
+
+	Socket Socket::accept()
+	{
+		if (!isValid()) { return Socket(); }
+		NativeSocket handle = ::accept((NativeSocket)m_handle, nullptr, nullptr);
+		if (handle == INVALID_SOCKET) { return Socket(); }
+		disableNagle(handle);
+		return Socket((long long)handle);
+	}
+
+	bool Socket::wait(int milliseconds)
+	{
+		if (!isValid()) { return false; }
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET((NativeSocket)m_handle, &readable);
+		timeval timeout;
+		timeout.tv_sec = milliseconds / 1000;
+		timeout.tv_usec = (milliseconds % 1000) * 1000;
+		return ::select((int)m_handle + 1, &readable, nullptr, nullptr, &timeout) > 0;
+	}
+
+	unsigned short Socket::port() const
+	{
+		if (!isValid()) { return 0; }
+		sockaddr_in address;
+		socklen_t length = sizeof(address);
+		if (getsockname((NativeSocket)m_handle, (sockaddr*)&address, &length) != 0) { return 0; }
+		return ntohs(address.sin_port);
+	}
+
+	bool Socket::send(const void * data, ::std::size_t size)
+	{
+		const char * current = (const char*)data;
+		while (size > 0)
+		{
+			int sent = (int)::send((NativeSocket)m_handle, current, (IoSize)size, SendFlags);
+			if (sent <= 0) { return false; }
+			current += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	bool Socket::receive(void * data, ::std::size_t size)
+	{
+		char * current = (char*)data;
+		while (size > 0)
+		{
+			int received = (int)::recv((NativeSocket)m_handle, current, (IoSize)size, 0);
+			if (received <= 0) { return false; }
+			current += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	void Socket::close()
+	{
+		if (isValid())
+		{
+			closeNative((NativeSocket)m_handle);
+			m_handle = -1;
+		}
+	}
+}
@@ -0,0 +1,249 @@
+#include <Scenes.h>
+#include <Geometry/Scene.h>
+#include <Geometry/CastedRay.h>
+#include <Math/SobolSampler.h>
+#include <Math/RandomDirection.h>
+#include <System/Clock.h>
+#include <omp.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+// Benchmark of the engine on fixed scenes. For each scene it measures the loading (3ds parsing and
+// materials), the computation of the vertex normals, the construction of the BVH and the throughput
+// of primary, shadow and diffuse bounce rays at a fixed resolution and seed, then writes JSON.
+// Usage: Benchmark [options]
+//   --scene name    benchmarks a scene (repeatable, defaults to diffuse, sombrero, dog, guitar, tibetHouse, medievalCity)
+//   --output file   the JSON report (benchmark.json by default, the scenes log their loading on the standard output)
+//   --width w       the width of the primary ray grid (256 by default)
+//   --height h      the height of the primary ray grid (256 by default)
+//   --samples n     the number of primary rays per pixel (4 by default)
+//   --seed s        the seed of the ray samplers (0 by default)
+
+/// <summary>
+/// The throughput of a type of ray.
+/// </summary>
+struct RayThroughput
+{
+	unsigned long long rays = 0;
+	unsigned long long hits = 0;
+	double seconds = 0.0;
+
+	double raysPerSecond() const
+	{ return (seconds > 0.0) ? rays / seconds : 0.0; }
+};
+
+/// <summary>
+/// The measures of a scene.
+/// </summary>
+struct SceneMeasures
+{
+	std::string name;
+	size_t triangles = 0;
+	double loadSeconds = 0.0;
+	double normalsSeconds = 0.0;
+	double bvhSeconds = 0.0;
+	Geometry::MemoryReport memory;
+	RayThroughput primary;
+	RayThroughput shadow;
+	RayThroughput diffuse;
+};
+
+/// <summary>
+/// A surface point seen by a primary ray, the origin of the shadow and diffuse rays.
+/// </summary>
+struct SurfacePoint
+{
+	Math::Vector3f position;
+	Math::Vector3f normal;
+	int x, y, sample;
+};
+
+/// <summary>
+/// Measures the ray throughputs of a scene (its BVH must be built).
+/// </summary>
+void measureRays(Geometry::Scene & scene, int width, int height, int samples, unsigned int seed, SceneMeasures & measures)
+{
+	// Primary rays: jittered in the pixels with the quasi Monte Carlo sampler
+	std::vector<std::vector<SurfacePoint> > points(height);
+	unsigned long long hits = 0;
+	System::Clock clock;
+#pragma omp parallel for schedule(dynamic) reduction(+:hits)
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			for (int sample = 0; sample < samples; ++sample)
+			{
+				Math::SobolSampler sampler(Math::SobolSampler::pixelSeed(x, y, seed), sample);
+				std::pair<double, double> lens = sampler.lens();
+				Geometry::CastedRay cray(scene.getCamera().getRay((x + lens.first) / width, (y + lens.second) / height));
+				scene.optim(cray, "BVH");
+				if (cray.validIntersectionFound())
+				{
+					const Geometry::RayTriangleIntersection & hit = cray.intersectionFound();
+					SurfacePoint point;
+					point.position = hit.intersection();
+					point.normal = hit.triangle()->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+					point.x = x;
+					point.y = y;
+					point.sample = sample;
+					points[y].push_back(point);
+					++hits;
+				}
+			}
+		}
+	}
+	measures.primary.seconds = clock.elapsed();
+	measures.primary.rays = (unsigned long long)width * height * samples;
+	measures.primary.hits = hits;
+
+	// Shadow rays: from a sampled point of each light (or above the scene without light) to the surface points
+	std::vector<Geometry::PointLight> lights = scene.getLights();
+	const std::vector<Geometry::LightSource*> & sources = scene.getLightSources();
+	if (lights.empty() && sources.empty())
+	{
+		Geometry::BoundingBox box = scene.getBoundingBox();
+		lights.push_back(Geometry::PointLight(box.max() + (box.max() - box.min())*0.5, RGBColor(1.0, 1.0, 1.0)));
+	}
+	unsigned long long rays = 0;
+	hits = 0;
+	clock.restart();
+#pragma omp parallel for schedule(dynamic) reduction(+:rays, hits)
+	for (int y = 0; y < height; ++y)
+	{
+		for (const SurfacePoint & point : points[y])
+		{
+			Math::SobolSampler sampler(Math::SobolSampler::pixelSeed(point.x, point.y, seed), point.sample);
+			std::vector<Geometry::PointLight> targets = lights;
+			for (Geometry::LightSource * source : sources) { targets.push_back(source->generate(static_cast<const Math::PixelSampler &>(sampler), 0)); }
+			for (const Geometry::PointLight & light : targets)
+			{
+				Geometry::CastedRay cshadow(light.position(), point.position - light.position());
+				scene.optim(cshadow, "BVH");
+				++rays;
+				if (cshadow.validIntersectionFound()) { ++hits; }
+			}
+		}
+	}
+	measures.shadow.seconds = clock.elapsed();
+	measures.shadow.rays = rays;
+	measures.shadow.hits = hits;
+
+	// Diffuse bounce rays: one cosine distributed direction per surface point
+	rays = 0;
+	hits = 0;
+	clock.restart();
+#pragma omp parallel for schedule(dynamic) reduction(+:rays, hits)
+	for (int y = 0; y < height; ++y)
+	{
+		for (const SurfacePoint & point : points[y])
+		{
+			Math::SobolSampler sampler(Math::SobolSampler::pixelSeed(point.x, point.y, seed), point.sample);
+			Math::RandomDirection direction(point.normal.normalized());
+			Geometry::CastedRay cray(point.position, direction.generate(sampler, 0));
+			scene.optim(cray, "BVH");
+			++rays;
+			if (cray.validIntersectionFound()) { ++hits; }
+		}
+	}
+	measures.diffuse.seconds = clock.elapsed();
+	measures.diffuse.rays = rays;
+	measures.diffuse.hits = hits;
+}
+
+/// <summary>
+/// Loads a scene and measures it.
+/// </summary>
+bool measureScene(const std::string & name, int width, int height, int samples, unsigned int seed, SceneMeasures & measures)
+{
+	measures.name = name;
+	Geometry::Scene scene(width, height);
+	System::Clock clock;
+	if (!initScene(name, scene)) { return false; }
+	const double initSeconds = clock.elapsed();
+	measures.normalsSeconds = scene.normalsTime();
+	measures.loadSeconds = initSeconds - measures.normalsSeconds;
+	clock.restart();
+	scene.buildBVH();
+	measures.bvhSeconds = clock.elapsed();
+	measures.memory = scene.memoryReport();
+	measures.triangles = measures.memory.triangleCount;
+	measureRays(scene, width, height, samples, seed, measures);
+	return true;
+}
+
+void writeThroughput(std::ostream & out, const char * name, const RayThroughput & throughput)
+{
+	out << "\"" << name << "\": { \"rays\": " << throughput.rays << ", \"hits\": " << throughput.hits << ", \"seconds\": " << throughput.seconds
+		<< ", \"raysPerSecond\": " << throughput.raysPerSecond() << " }";
+}
+
+void writeJSON(std::ostream & out, const std::vector<SceneMeasures> & scenes, int width, int height, int samples, unsigned int seed)
+{
+	out << "{\n  \"width\": " << width << ", \"height\": " << height << ", \"samples\": " << samples << ", \"seed\": " << seed
+		<< ", \"threads\": " << omp_get_max_threads() << ",\n  \"scenes\": [";
+	for (size_t i = 0; i < scenes.size(); ++i)
+	{
+		const SceneMeasures & scene = scenes[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << scene.name << "\", \"triangles\": " << scene.triangles
+			<< ", \"loadSeconds\": " << scene.loadSeconds << ", \"normalsSeconds\": " << scene.normalsSeconds << ", \"bvhSeconds\": " << scene.bvhSeconds
+			<< ", \"bvhBytes\": " << scene.memory.bvh() << ", \"bvhNodes\": " << scene.memory.bvhNodeCount << ", \"geometryBytes\": " << scene.memory.geometry() << ",\n      ";
+		writeThroughput(out, "primary", scene.primary);
+		out << ",\n      ";
+		writeThroughput(out, "shadow", scene.shadow);
+		out << ",\n      ";
+		writeThroughput(out, "diffuse", scene.diffuse);
+		out << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+int main(int argc, char ** argv)
+{
+	std::vector<std::string> names;
+	std::string output = "benchmark.json";
+	int width = 256, height = 256, samples = 4;
+	unsigned int seed = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (option == "--scene" && hasValue) { names.push_back(argv[++i]); }
+		else if (option == "--output" && hasValue) { output = argv[++i]; }
+		else if (option == "--width" && hasValue) { width = atoi(argv[++i]); }
+		else if (option == "--height" && hasValue) { height = atoi(argv[++i]); }
+		else if (option == "--samples" && hasValue) { samples = atoi(argv[++i]); }
+		else if (option == "--seed" && hasValue) { seed = (unsigned int)atoi(argv[++i]); }
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+	if (names.empty()) { names = { "diffuse", "sombrero", "dog", "guitar", "tibetHouse", "medievalCity" }; }
+
+	std::vector<SceneMeasures> scenes;
+	for (const std::string & name : names)
+	{
+		std::cerr << "Benchmark: " << name << std::endl;
+		SceneMeasures measures;
+		if (!measureScene(name, width, height, samples, seed, measures))
+		{
+			std::cerr << "Unknown scene " << name << std::endl;
+			return 1;
+		}
+		scenes.push_back(measures);
+	}
+	std::ofstream out(output.c_str());
+	writeJSON(out, scenes, width, height, samples, seed);
+	if (!out)
+	{
+		std::cerr << "Unable to write " << output << std::endl;
+		return 1;
+	}
+	std::cerr << "Benchmark: report written in " << output << std::endl;
+	return 0;
+}
@@ -26,673 +26,16 @@
 #include <Geometry/LightSurface.h>
 #include <Geometry/LightSphere.h>
 #include <Geometry/LightRectangle.h>
+#include <Geometry/DistributedRenderer.h>
+#include <Geometry/Animation.h>
+#include <map>
+#include <memory>
+#include <functional>
+#include <Scenes.h>
 
 
 
 
-/// <summary>
-/// The directory of the 3D objetcs
-/// </summary>
-const std::string m_modelDirectory = "..\\..\\Models";
-
-using Geometry::RGBColor ;
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-/// \fn	void createGround(Geometry::Scene & scene)
-///
-/// \brief	Adds a ground to the scene.
-///
-/// \author	F. Lamarche, Universit� de Rennes 1
-/// \date	03/12/2013
-///
-/// \param [in,out]	scene	The scene.
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void createGround(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	// Non emissive 
-	Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(0.5, 0.5, 0.5), RGBColor(0.5, 0.5, 0.5)*8, 1000.0f); // Non existing material...
-	//Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(0., 0., 0.), RGBColor(1., 1., 1.), 10000.0f);
-	//Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(1.0f, 1.0f, 1.0f), RGBColor(0.f, 0.f, 0.f), 100.0f);
-
-	//Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(1.0,1.0,1.0), RGBColor(), 1000.0f, RGBColor(0.5, 0.5, 0.5)*200); // Non existing material...
-
-	Geometry::Square square(material);
-	Math::Vector3f scaleV = (sb.max() - sb.min()) ;
-	double scale = ::std::max(scaleV[0], scaleV[1])*2.0;
-	square.scaleX(scale);
-	square.scaleY(scale);
-	Math::Vector3f center = (sb.min() + sb.max()) / 2.0;
-	center[2] = sb.min()[2];
-	square.translate(center);
-	scene.add(square);
-	::std::cout << "Bounding box: " << sb.min() << "/ " << sb.max() << ", scale: "<<scale<< ::std::endl;
-	::std::cout << "center: " << (sb.min() + sb.max()) / 2.0 << ::std::endl;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-/// \fn	void createGround(Geometry::Scene & scene)
-///
-/// \brief	Adds a sirface area light to the scene
-///
-/// \author	F. Lamarche, Universit� de Rennes 1
-/// \date	03/12/2013
-///
-/// \param [in,out]	scene	The scene.
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void createSurfaceLigth(Geometry::Scene & scene, double value)
-{
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(), RGBColor(), 100.0f, RGBColor(value,value,value));
-	Geometry::Square square(material);
-	Math::Vector3f scaleV = (sb.max() - sb.min());
-	//double scale = ::std::max(scaleV[0], scaleV[1])*0.1;
-	double factor = 0.5;
-	square.scaleX(scaleV[0] * factor);
-	square.scaleY(scaleV[1] * factor);
-	Math::Vector3f center = (sb.min() + sb.max()) / 2.0;
-	center[2] = sb.max()[2]*3;
-	square.translate(center);
-	scene.add(square);
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-/// \fn	void initDiffuse(Geometry::Scene & scene)
-///
-/// \brief	Adds a Cornell Box with diffuse material on each walls to the scene. This Cornel box
-/// 		contains two cubes.
-///
-/// \author	F. Lamarche, Universit� de Rennes 1
-/// \date	03/12/2013
-///
-/// \param [in,out]	scene	The scene.
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void initDiffuse(Geometry::Scene & scene)
-{
-	Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(0,0,0.0), RGBColor(0.95f,0.95f,0.95f), 1, RGBColor()) ;
-	Geometry::Material * material2 = new Geometry::Material(RGBColor(), RGBColor(1.0,1.0,1.0), RGBColor(0,0,0), 1000, RGBColor()) ;
-	Geometry::Material * redEmissive = new Geometry::Material(RGBColor(), RGBColor(1.0f,0.0,0.0), RGBColor(0.0,0.0,0.0), 20.0f, RGBColor(10.0,0,0)) ; //emissive
-	Geometry::Material * redMat = new Geometry::Material(RGBColor(), RGBColor(1.0, 0.0, 0.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	Geometry::Material * greenMat = new Geometry::Material(RGBColor(), RGBColor(0.0, 1.0, 0.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	Geometry::Material * blueMat = new Geometry::Material(RGBColor(), RGBColor(0.0, 0.0, 1.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	Geometry::Material * whiteMat = new Geometry::Material(RGBColor(), RGBColor(0.0, 1.0, 1.0), RGBColor(0.0, 0.0, 0.0), 0.0f, RGBColor());
-
-	Geometry::Cornel geo(material2, material2, material2, blueMat, redMat, greenMat) ;
-
-	geo.scaleX(10) ;
-	geo.scaleY(10) ;
-	geo.scaleZ(10) ;
-	scene.add(geo) ;
-
-	Geometry::Cube tmp(redMat) ;
-	//tmp.translate(Math::makeVector(1.0f, 3.0f, -4.0f)); //Gatien
-	tmp.translate(Math::makeVector(1.5,-1.5,0.0)) ;
-	scene.add(tmp) ;
-	
-	Geometry::Cube tmp2(redMat) ;
-	Math::Quaternion<double> cubeRota(Math::makeVector(-1.0, 1.0, 0.0), 1.0);
-	//tmp2.rotate(cubeRota);
-	//tmp2.scale(3);
-	//tmp2.translate(Math::makeVector(1.0f, -3.0f, -4.0f)); //Gatien
-	tmp2.translate(Math::makeVector(2,1,-4)) ;
-	scene.add(tmp2) ;
-
-	// 2.2 Adds point lights in the scene 
-	{
-		Geometry::PointLight pointLight(Math::makeVector(0.0f, 0.f, 2.0f), RGBColor(0.5f, 0.5f, 0.5f));
-		scene.add(pointLight);
-	}
-	{
-		Geometry::PointLight pointLight2(Math::makeVector(4.f, 0.f, 0.f), RGBColor(0.5f, 0.5f, 0.5f));
-		scene.add(pointLight2);
-	}
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 1,1,1 });
-	Geometry::Material * ematerial2 = new Geometry::Material(0, 0, 0, 0, { 0.1, 1, 1 });
-	Math::Quaternion<double> defaultRota(Math::makeVector(0.0, 0.0, 0.0), 0.0);
-	Math::Quaternion<double> q(Math::makeVector(-1.0,1.0,0.0),1.0);
-	Math::Quaternion<double> q2(Math::makeVector(0.0, 1.0, 0.0), 3.14);
-	{
-		//Rectangle du prof
-		Geometry::LightSource * surface1 = new Geometry::LightSurface(Math::makeVector(0.0f, 0.0f, 4.9f), defaultRota, 2.0,1.0, ematerial1, 25);
-		scene.add(surface1);
-
-		//Disk
-		Geometry::LightSource * surface2 = new Geometry::LightDisk(Math::makeVector(0.0f, 0.0f, 4.5f), defaultRota, 1.5f, 50, ematerial1, 64);
-		//scene.add(surface2);
-
-		//Sphere
-		Geometry::LightSource * surface3 = new Geometry::LightSphere(Math::makeVector(1.0f, 3.0f, 4.50f), 1.0f, 50, ematerial1, 400);
-		//scene.add(surface3);
-
-		//Rectangle
-		Geometry::LightSource * surface4 = new Geometry::LightRectangle(Math::makeVector(0.0f, 0.0f, 4.0f), defaultRota, 1.0 ,1.0, ematerial1, 25);
-		//scene.add(surface4);
-	}
-	{
-		Geometry::Camera camera(Math::makeVector(-4.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f), 0.3f, 1.0f, 1.0f);
-		scene.setCamera(camera);
-	}
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-/// \fn	void initSpecular(Geometry::Scene & scene)
-///
-/// \brief	Adds a Cornel box in the provided scene. Walls are specular and the box contains two 
-/// 		cubes.
-///
-/// \author	F. Lamarche, Universit� de Rennes 1
-/// \date	03/12/2013
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void initSpecular(Geometry::Scene & scene)
-{
-	Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(0,0,0.0), RGBColor(0.7f,0.7f,0.7f), 100, RGBColor()) ;
-	Geometry::Material * material2 = new Geometry::Material(RGBColor(), RGBColor(0,0,1.0f), RGBColor(0,0,0), 1000, RGBColor()) ;
-	//Geometry::Material * cubeMat = new Geometry::Material(RGBColor(), RGBColor(1.0f,0.0,0.0), RGBColor(0.0,0.0,0.0), 20.0f, RGBColor(10.0,0,0)) ;
-	Geometry::Material * cubeMat = new Geometry::Material(RGBColor(), RGBColor(1.0f, 0.0, 0.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	Geometry::Cornel geo(material, material, material, material, material, material) ; //new Geometry::Cube(material2) ;////new Cone(4, material) ; //new Geometry::Cylinder(5, 1, 1, material) ;////////new Geometry::Cube(material) ;////; //new Geometry::Cube(material) ; //new Geometry::Cylinder(100, 2, 1, material) ; //
-
-	geo.scaleX(10) ;
-	geo.scaleY(10) ;
-	geo.scaleZ(10) ;
-	scene.add(geo) ;
-
-	Geometry::Cube tmp(cubeMat) ;
-	tmp.translate(Math::makeVector(1.5,-1.5,0.0)) ;
-	scene.add(tmp) ;
-
-	Geometry::Cube tmp2(cubeMat) ;
-	tmp2.translate(Math::makeVector(2,1,-4)) ;
-	scene.add(tmp2) ;
-
-	// 2.2 Adds point lights in the scene 
-	{
-		Geometry::PointLight pointLight(Math::makeVector(0.0f, 0.f, 2.0f), RGBColor(0.5f, 0.5f, 0.5f)*5);
-	//	scene.add(pointLight);
-	}
-	{
-		Geometry::PointLight pointLight2(Math::makeVector(4.f, 0.f, 0.f), RGBColor(0.5f, 0.5f, 0.5f)*5);
-	//	scene.add(pointLight2);
-	}
-	// Sets the camera
-	{
-		Geometry::Camera camera(Math::makeVector(-4.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f), 0.3f, 1.0f, 1.0f);
-		scene.setCamera(camera);
-	}
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-/// \fn	void initDiffuseSpecular(Geometry::Scene & scene)
-///
-/// \brief	Adds a Cornel box in the provided scene. The cornel box as diffuse and specular walls and 
-/// 		contains two boxes.
-///
-/// \author	F. Lamarche, Universit� de Rennes 1
-/// \date	03/12/2013
-///
-/// \param [in,out]	scene	The scene.
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void initDiffuseSpecular(Geometry::Scene & scene)
-{
-	Geometry::Material * material = new Geometry::Material(RGBColor(), RGBColor(0,0,0.0), RGBColor(0.7f,0.7f,0.7f), 100, RGBColor()) ;
-	Geometry::Material * material2 = new Geometry::Material(RGBColor(), RGBColor(1,1,1.0f), RGBColor(0,0,0), 1000, RGBColor()) ;
-	//Geometry::Material * cubeMat = new Geometry::Material(RGBColor(), RGBColor(1.0f, 0.0, 0.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	//Geometry::Material * cubeMat2 = new Geometry::Material(RGBColor(), RGBColor(1.0f, 0.0, 0.0), RGBColor(0.0, 0.0, 0.0), 20.0f, RGBColor());
-	Geometry::Material * cubeMat = new Geometry::Material(RGBColor(), RGBColor(0.0f,0.0,0.0), RGBColor(0.0,0.0,0.0), 20.0f, RGBColor(10.0,0,0)) ;
-	Geometry::Material * cubeMat2 = new Geometry::Material(RGBColor(), RGBColor(0.0f,0.0,0.0), RGBColor(0.0,0.0,0.0), 20.0f, RGBColor(0.0,10,0)) ;
-	Geometry::Cornel geo(material2, material2, material, material, material, material) ; //new Geometry::Cube(material2) ;////new Cone(4, material) ; //new Geometry::Cylinder(5, 1, 1, material) ;////////new Geometry::Cube(material) ;////; //new Geometry::Cube(material) ; //new Geometry::Cylinder(100, 2, 1, material) ; //
-
-	geo.scaleX(10) ;
-	geo.scaleY(10) ;
-	geo.scaleZ(10) ;
-	scene.add(geo) ;
-
-
-	Geometry::Cube tmp(cubeMat2) ;
-	tmp.translate(Math::makeVector(1.5,-1.5,0.0)) ;
-	scene.add(tmp) ;
-
-	Geometry::Cube tmp2(cubeMat) ;
-	tmp2.translate(Math::makeVector(2,1,-4)) ;
-	scene.add(tmp2) ;
-
-	// 2.2 Adds point lights in the scene 
-	{
-		Geometry::PointLight pointLight(Math::makeVector(0.0f, 0.f, 2.0f), RGBColor(0.5f, 0.5f, 0.5f));
-		//scene.add(pointLight);
-	}
-	{
-		Geometry::PointLight pointLight2(Math::makeVector(4.f, 0.f, 0.f), RGBColor(0.5f, 0.5f, 0.5f));
-		//scene.add(pointLight2);
-	}
-	{
-		Geometry::Camera camera(Math::makeVector(-4.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f), 0.3f, 1.0f, 1.0f);
-		scene.setCamera(camera);
-	}
-}
-
-/// <summary>
-/// Intializes a scene containing a garage.
-/// </summary>
-/// <param name="scene"></param>
-void initGarage(Geometry::Scene & scene)
-{
-	Geometry::Loader3ds loader(m_modelDirectory+"\\garage.3ds", m_modelDirectory+"");
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		scene.add(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*1000);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0)*1000);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(750.0f, -1500.f, 1000.f)*0.85f, Math::makeVector(200.0f, 0.0f, 0.0f), 0.3f, 1.0f, 1.0f);
-		scene.setCamera(camera);
-	}
-	createGround(scene);	
-}
-
-/// <summary>
-/// Initializes a scene containing a guitar.
-/// </summary>
-/// <param name="scene"></param>
-void initGuitar(Geometry::Scene & scene)
-{
-	Geometry::Loader3ds loader(m_modelDirectory+"\\guitar2.3ds", m_modelDirectory+"");
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		scene.add(*loader.getMeshes()[cpt]);
-	}
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	//Geometry::PointLight light1(position + Math::makeVector(0.f, 0.f, 70.f/*100.f*/), RGBColor(1.0, 1.0, 1.0)*500);
-	Geometry::PointLight light1(position + Math::makeVector(1800.0f, -500.0f, 1000.0f), RGBColor(0.5, 1.0, 1.0) * 500);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position+Math::makeVector(0.f,0.f,200.f), RGBColor(1.0, 1.0, 1.0)*500);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(-500., -1000., 1000.)*1.05, Math::makeVector(500.f, 0.0f, 0.0f), 0.6f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(100.0f, -100.f, -200.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 500,1000,1000 });
-	Math::Quaternion<double> defaultRota(Math::makeVector(0.0, 0.0, 0.0), 0.0);
-	Geometry::LightSource * surface2 = new Geometry::LightDisk(Math::makeVector(1800.0f, -500.0f, 1000.0f), defaultRota, 100.0f, 50, ematerial1, 64);
-	scene.add(surface2);
-}
-
-/// <summary>
-/// Initializes a scene containing a dog
-/// </summary>
-/// <param name="scene"></param>
-void initDog(Geometry::Scene & scene)
-{
-	Geometry::Loader3ds loader(m_modelDirectory+"\\Dog\\dog.3ds", m_modelDirectory+"\\dog");
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		scene.add(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*2);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0)*2);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(10.f, 10.f, 6.f)*0.5, Math::makeVector(0.f, 0.0f, 2.5f), .7f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(-0.4f, 0.f, 0.9f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-}
-
-/// <summary>
-/// Initializes a scene containing a temple.
-/// </summary>
-/// <param name="scene"></param>
-void initTemple(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f,0.0f,0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\Temple\\Temple of St Seraphim of Sarov N270116_2.3ds", m_modelDirectory+"\\Temple");
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	//Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*60.0);
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*600.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	//Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0)*30);
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 300);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(20.0f, -100.0f, 15.0f), Math::makeVector(-20.f, 0.f, -40.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(40.f, 0.f, 0.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-	//createSurfaceLigth(scene, 50);
-	//createSurfaceLigth(scene, 500);
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 1000,1000,1000 });
-	Math::Quaternion<double> defaultRota(Math::makeVector(0.0, 0.0, 0.0), 0.0);
-	Geometry::LightSource * surface2 = new Geometry::LightDisk(Math::makeVector(1800.0f, -500.0f, 1000.0f), defaultRota, 100.0f, 50, ematerial1, 64);
-	scene.add(surface2);
-}
-
-/// <summary>
-/// Initializes a scene containing a robot.
-/// </summary>
-/// <param name="scene"></param>
-void initRobot(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\Robot.3ds", m_modelDirectory+"");
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*60.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 30);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(100.0f, -50.0f, 0.0f), Math::makeVector(0.f, 0.f, -20.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(0.f, 40.f, 50.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-}
-
-/// <summary>
-/// Initializes a scene containing a grave stone
-/// </summary>
-/// <param name="scene"></param>
-void initGraveStone(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\gravestone\\GraveStone.3ds", m_modelDirectory+"\\gravestone");
-
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		//(*it)->setSpecular(RGBColor());
-		//(*it)->setSpecular((*it)->getSpecular()*0.05);
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*1500*0.2);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 1000*0.4);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(0.f, -300.0f, 200.0f), Math::makeVector(0.f, 0.f, 60.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(0.f, 80.f, 120.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-	//createSurfaceLigth(scene, 400);
-}
-
-/// <summary>
-/// Initializes a scene containing a boat
-/// </summary>
-/// <param name="scene"></param>
-void initBoat(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\Boat\\boat.3ds", m_modelDirectory+"\\boat");
-	//// We remove the specular components of the materials...
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		(*it)->setSpecular(RGBColor());
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*6000.0);
-	scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 20000);
-	scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(5000.f, 5000.f, 200.0f), Math::makeVector(0.f, 0.f, 60.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(2000.f, 3000.f, 700.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-	//createSurfaceLigth(scene, 4000);
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 3000,3000,3000 });
-	Math::Quaternion<double> defaultRota(Math::makeVector(0.0, 0.0, 0.0), 0.0);
-	Geometry::LightSource * surface2 = new Geometry::LightDisk(sb.max(), defaultRota, 100.0f, 50, ematerial1, 64);
-	//scene.add(surface2);
-}
-
-/// <summary>
-/// Initializes a scene containing a tibet house
-/// </summary>
-/// <param name="scene"></param>
-void initTibetHouse(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\TibetHouse\\TibetHouse.3ds", m_modelDirectory+"\\TibetHouse");
-	// We remove the specular components of the materials... and add surface light sources :)
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		(*it)->setSpecular(RGBColor());
-		if ((*it)->getTextureFile() == m_modelDirectory + "\\TibetHouse" + "\\3D69C2DE.png")
-		{
-			(*it)->setEmissive(RGBColor(1.0, 1.0, 1.0)*50.0);
-		}
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*50.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 200);
-	//scene.add(light2);
-	//Geometry::PointLight light3(Math::makeVector(5.f, 35.f, 5.f), RGBColor(1.0, 1.0, 1.0) * 200); //*50
-	//scene.add(light3);
-
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 1,1,1 });
-	Geometry::Material * ematerial2 = new Geometry::Material(0, 0, 0, 0, { 0.1, 1, 1 });
-
-	//Sphere
-	Geometry::LightSource * surface3 = new Geometry::LightSphere(Math::makeVector(00.0f, 30.0f, 40.0f), 1.0f, 50, ematerial1, 100);
-	scene.add(surface3);
-
-	{
-		Geometry::Camera camera(Math::makeVector(20.f, 0.f, 0.0f), Math::makeVector(5.f, 35.f, 0.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(0.f, 5.f, 0.f)/*+Math::makeVector(0.0,5.0,0.0)*/);
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-}
-
-/// <summary>
-/// Initializes a scene containing a tibet house. Camera is placed inside the house.
-/// </summary>
-/// <param name="scene"></param>
-void initTibetHouseInside(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\TibetHouse\\TibetHouse.3ds", m_modelDirectory+"\\TibetHouse");
-	// We remove the specular components of the materials... and add surface light sources :)
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		(*it)->setSpecular(RGBColor());
-		if ((*it)->getTextureFile() == m_modelDirectory + "\\TibetHouse" + "\\3D69C2DE.png")
-		{
-			(*it)->setEmissive(RGBColor(1.0, 1.0, 1.0)*500.0);
-		}
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*500.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 200);
-	//scene.add(light2);
-	Geometry::PointLight light3(Math::makeVector(5.f, 35.f, 5.f), RGBColor(1.0, 1.0, 1.0) * 5);
-	//scene.add(light3);
-	{
-		Geometry::Camera camera(Math::makeVector(20.f, 0.f, 5.0f), Math::makeVector(5.f, 35.f, 5.f), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(10.f-2, 30.f, 0.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-	Geometry::Material * ematerial1 = new Geometry::Material(0, 0, 0, 0, { 1,1,1 });
-	Math::Quaternion<double> defaultRota(Math::makeVector(0.0, 0.0, 0.0), 0.0);
-	Geometry::LightSource * surface2 = new Geometry::LightDisk(Math::makeVector(5.f, 35.f, 5.f), defaultRota, 1.0f, 50, ematerial1, 64);
-	scene.add(surface2);
-}
-
-/// <summary>
-/// Initializes a scene containing a medieval city
-/// </summary>
-/// <param name="scene"></param>
-void initMedievalCity(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\Medieval\\MedievalCity.3ds", m_modelDirectory+"\\Medieval\\texture");
-	// We remove the specular components of the materials...
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		(*it)->setSpecular(RGBColor());
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		//loader.getMeshes()[cpt]->translate(Math::makeVector(20.f, 0.f, 40.0f));
-		//loader.getMeshes()[cpt]->rotate(Math::Quaternion<double>(Math::makeVector(0.0, 1.0, 0.0), Math::pi));
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position+Math::makeVector(0.0,0.0,150.0), RGBColor(1.0, 0.6, 0.3)*800.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position + Math::makeVector(0.0, 0.0, 1000.0), RGBColor(1.0, 1.0, 1.0) * 400);
-	//scene.add(light2);
-	//Geometry::PointLight light3(Math::makeVector(5.f, 35.f, 5.f), RGBColor(1.0, 1.0, 1.0) * 50);
-	//scene.add(light3);
-	{
-		Geometry::Camera camera(Math::makeVector(0.f, 300.f, 1000.0f), Math::makeVector(0.0,0.0,0.0), 0.3f, 1.0f, 1.0f);
-		camera.translateLocal(Math::makeVector(0.0, 800., -100.0));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-}
-
-/// <summary>
-/// Initializes a scene containing a sombrero
-/// </summary>
-/// <param name="scene"></param>
-void initSombrero(Geometry::Scene & scene)
-{
-	Geometry::BoundingBox box(Math::makeVector(0.0f, 0.0f, 0.0f), Math::makeVector(0.0f, 0.0f, 0.0f));
-	Geometry::Loader3ds loader(m_modelDirectory+"\\sombrero\\sombrero.3ds", m_modelDirectory+"\\sombrero");
-	// We remove the specular components of the materials...
-	::std::vector<Geometry::Material*> materials = loader.getMaterials();
-	for (auto it = materials.begin(), end = materials.end(); it != end; ++it)
-	{
-		(*it)->setSpecular(RGBColor()); 
-	}
-
-	for (size_t cpt = 0; cpt < loader.getMeshes().size(); ++cpt)
-	{
-		scene.add(*loader.getMeshes()[cpt]);
-		box.update(*loader.getMeshes()[cpt]);
-	}
-
-	// 2.2 Adds point lights in the scene 
-	Geometry::BoundingBox sb = scene.getBoundingBox();
-	Math::Vector3f position = sb.max();
-	Geometry::PointLight light1(position, RGBColor(1.0, 1.0, 1.0)*50.0);
-	//scene.add(light1);
-	position[1] = -position[1];
-	Geometry::PointLight light2(position, RGBColor(1.0, 1.0, 1.0) * 50);
-	//scene.add(light2);
-	{
-		Geometry::Camera camera(Math::makeVector(300.f, 0.f, 100.0f), Math::makeVector(0.f, 0.f, 0.f), 0.3f, 1.0f, 1.0f);
-		//camera.translateLocal(Math::makeVector(2000.f, 3000.f, 700.f));
-		scene.setCamera(camera);
-	}
-	createGround(scene);
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 /// \fn	void waitKeyPressed()
 ///
@@ -720,6 +63,21 @@ void waitKeyPressed()
   }/*while(!done)*/
 }
 
+/// <summary>
+/// Builds the command line starting a local worker connected to the coordinator.
+/// </summary>
+/// <param name="executable">The path of this executable (argv[0]).</param>
+/// <param name="port">The port of the coordinator.</param>
+std::string workerCommand(const std::string & executable, unsigned short port)
+{
+	std::string command = "\"" + executable + "\" --worker 127.0.0.1:" + std::to_string(port);
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of the command line
+	command = "\"" + command + "\"";
+#endif
+	return command;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 /// \fn	int main(int argc, char ** argv)
 ///
@@ -737,55 +95,290 @@ int main(int argc, char ** argv)
 {
 	omp_set_num_threads(8);
 
-	// 1 - Initializes a window for rendering
-	//Visualizer::Visualizer visu(1000,1000) ;
-	Visualizer::Visualizer visu(500, 500);
-	//Visualizer::Visualizer visu(300,300) ;
-	
-	// 2 - Initializes the scene
-	Geometry::Scene scene(&visu) ;
+	// 0 - Command line
+	//   --scene name       the rendered scene (see m_scenes)
+	//   --workers n        distributed rendering with n local worker processes (0: remote workers only)
+	//   --port p           the port of the coordinator (0: chosen by the system)
+	//   --remote-workers   the coordinator accepts the (unauthenticated) workers of other hosts, not only local ones
+	//   --worker-timeout s the coordinator fails if no worker is connected during s seconds (60 by default)
+	//   --worker host:port runs as a worker of the given coordinator
+	//   --headless         no window
+	//   --output file.pfm  saves the rendered image
+	//   --checkpoint file  periodically saves the rendering state (see --interval), one file per frame of an --animation
+	//   --interval s       the time between two checkpoints (in seconds, 300 by default)
+	//   --resume           resumes the rendering from the checkpoint file
+	//   --passes n         the number of passes per pixel
+	//   --time s           stops the rendering after s seconds (wall clock, including the BVH construction and the pre-passes)
+	//   --noise v          stops the rendering when the relative noise of the image is below v
+	//   --crop x0 y0 x1 y1 only renders (and saves) the pixels [x0;x1)x[y0;y1)
+	//   --animation file   renders the frames of an animation (see Geometry::Animation::load), --output is the frame pattern
+	//   --frames n         the number of frames of the animation (24 by default)
+	//   --preview          computes the first pass at 1/8, 1/4, 1/2 and full resolution
+	//   --denoise          denoises the image at the end of the rendering (the window and the output show the denoised image)
+	//   --aov              also saves the auxiliary buffers next to the output (see Geometry::Scene::saveAuxiliaryBuffers)
+	//   --heatmap metric   renders the BVH traversal cost of the primary rays (metric: nodes or triangles) as false colors
+	//   --heatmap-path     measures the cost of whole paths instead of primary rays
+	//   --heatmap-scale c  the cost mapped to red (the maximum cost of the image by default)
+	//   --trace file       writes a Chrome trace event file (JSON) of the loading and rendering phases
+	//   --iterative        uses the iterative path tracer instead of the recursive one
+	//   --roulette-depth n the number of bounces before the russian roulette of the iterative path tracer (3 by default)
+	//   --mis              multiple importance sampling of the surface lights in the iterative path tracer (implies --iterative)
+	//   --irradiance-cache a interpolates the indirect diffuse lighting from an irradiance cache of accuracy a (0.2: coarse, 0.05: fine)
+	//   --irradiance-rays n the number of rays gathering the irradiance of a record (64 by default)
+	//   --bake file        bakes the diffuse lighting in a lightmap saved to file, then renders with it
+	//   --bake-samples n   the number of samples per lightmap texel (256 by default)
+	//   --bake-texel s     the distance between the lightmap texels (1/256 of the scene diagonal by default)
+	//   --lightmap file    renders with a lightmap baked for the same scene (only the glossy paths are traced)
+	//   --photons n        renders by photon mapping with n photons emitted for the global photon map
+	//   --caustic-photons n the number of photons emitted for the caustic photon map (200000 by default)
+	//   --photon-gather k  the number of photons of a radiance estimate (64 by default)
+	//   --radiosity [a]    renders a hierarchical radiosity solution, links refined above the ratio a of the emitted power (1e-4 by default), up to 4096 triangles
+	//   --guiding [p]      path guiding learnt during the first passes, sampled with probability p (0.5 by default, implies --mis)
+	std::string sceneName = "diffuse";
+	std::string coordinatorAddress;
+	int localWorkers = -1;
+	int port = 0;
+	bool remoteWorkers = false;
+	double workerTimeout = 60.0;
+	bool headless = false;
+	std::string output;
+	std::string checkpoint;
+	double checkpointInterval = 300.0;
+	bool resume = false;
+	int passes = 0;
+	double timeBudget = 0.0;
+	double noiseTarget = 0.0;
+	int crop[4] = { 0, 0, -1, -1 };
+	std::string animationFile;
+	int frames = 24;
+	bool preview = false;
+	bool denoise = false;
+	bool aovs = false;
+	Geometry::Heatmap heatmap;
+	std::string traceFile;
+	bool iterative = false;
+	int rouletteDepth = 3;
+	bool mis = false;
+	double irradianceAccuracy = 0.0;
+	int irradianceRays = 64;
+	std::string bakeFile;
+	int bakeSamples = 256;
+	double bakeTexel = 0.0;
+	std::string lightmapFile;
+	int photons = 0;
+	int causticPhotons = 200000;
+	int photonGather = 64;
+	double guiding = 0.0;
+	double radiosity = 0.0;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (option == "--scene" && hasValue) { sceneName = argv[++i]; }
+		else if (option == "--workers" && hasValue) { localWorkers = atoi(argv[++i]); }
+		else if (option == "--port" && hasValue) { port = atoi(argv[++i]); }
+		else if (option == "--remote-workers") { remoteWorkers = true; }
+		else if (option == "--worker-timeout" && hasValue) { workerTimeout = atof(argv[++i]); }
+		else if (option == "--worker" && hasValue) { coordinatorAddress = argv[++i]; }
+		else if (option == "--headless") { headless = true; }
+		else if (option == "--output" && hasValue) { output = argv[++i]; }
+		else if (option == "--checkpoint" && hasValue) { checkpoint = argv[++i]; }
+		else if (option == "--interval" && hasValue) { checkpointInterval = atof(argv[++i]); }
+		else if (option == "--resume") { resume = true; }
+		else if (option == "--passes" && hasValue) { passes = atoi(argv[++i]); }
+		else if (option == "--time" && hasValue) { timeBudget = atof(argv[++i]); }
+		else if (option == "--noise" && hasValue) { noiseTarget = atof(argv[++i]); }
+		else if (option == "--animation" && hasValue) { animationFile = argv[++i]; }
+		else if (option == "--frames" && hasValue) { frames = atoi(argv[++i]); }
+		else if (option == "--preview") { preview = true; }
+		else if (option == "--denoise") { denoise = true; }
+		else if (option == "--aov") { aovs = true; }
+		else if (option == "--heatmap" && hasValue) { heatmap.metric = Geometry::Heatmap::metricFromName(argv[++i]); }
+		else if (option == "--heatmap-path") { heatmap.path = true; }
+		else if (option == "--heatmap-scale" && hasValue) { heatmap.scale = atof(argv[++i]); }
+		else if (option == "--trace" && hasValue) { traceFile = argv[++i]; }
+		else if (option == "--iterative") { iterative = true; }
+		else if (option == "--roulette-depth" && hasValue) { rouletteDepth = atoi(argv[++i]); }
+		else if (option == "--mis") { iterative = mis = true; }
+		else if (option == "--irradiance-cache" && hasValue) { irradianceAccuracy = atof(argv[++i]); }
+		else if (option == "--irradiance-rays" && hasValue) { irradianceRays = atoi(argv[++i]); }
+		else if (option == "--bake" && hasValue) { bakeFile = argv[++i]; }
+		else if (option == "--bake-samples" && hasValue) { bakeSamples = atoi(argv[++i]); }
+		else if (option == "--bake-texel" && hasValue) { bakeTexel = atof(argv[++i]); }
+		else if (option == "--lightmap" && hasValue) { lightmapFile = argv[++i]; }
+		else if (option == "--photons" && hasValue) { photons = atoi(argv[++i]); }
+		else if (option == "--caustic-photons" && hasValue) { causticPhotons = atoi(argv[++i]); }
+		else if (option == "--photon-gather" && hasValue) { photonGather = atoi(argv[++i]); }
+		else if (option == "--radiosity")
+		{
+			radiosity = 1e-4;
+			if (hasValue && argv[i + 1][0] != '-') { radiosity = atof(argv[++i]); }
+		}
+		else if (option == "--guiding")
+		{
+			guiding = 0.5;
+			iterative = mis = true;
+			if (hasValue && argv[i + 1][0] != '-') { guiding = atof(argv[++i]); }
+		}
+		else if (option == "--crop" && i + 4 < argc)
+		{
+			for (int c = 0; c < 4; ++c) { crop[c] = atoi(argv[++i]); }
+		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+	if (resume && checkpoint.empty())
+	{
+		std::cerr << "--resume needs a --checkpoint file" << std::endl;
+		return 1;
+	}
+	if (!animationFile.empty() && (!Geometry::Animation::validPattern(output) || !Geometry::Animation::validPattern(checkpoint)))
+	{
+		std::cerr << "The --output and --checkpoint patterns of an --animation need a single %d or %0Nd conversion (%% for a % character)" << std::endl;
+		return 1;
+	}
+	if (m_scenes.find(sceneName) == m_scenes.end())
+	{
+		std::cerr << "Unknown scene " << sceneName << std::endl;
+		return 1;
+	}
 
-	
-	// 2.1 initializes the geometry (choose only one initialization)
-	initDiffuse(scene) ;
-	//initDiffuseSpecular(scene) ;
-	//initSpecular(scene) ;
-	//initGuitar(scene);
-	//initDog(scene);
-	//initGarage(scene);
-	//initTemple(scene);
-	//initRobot(scene);
-	//initGraveStone(scene);
-	//initBoat(scene);
-	//initSombrero(scene);
-	//initTibetHouse(scene);
-	//initTibetHouseInside(scene);
-	//initMedievalCity(scene);
-	// Shows stats
-	scene.printStats();
+	if (!traceFile.empty()) { System::Trace::instance().start(traceFile); }
 
-	// 3 - Computes the scene
+	// Worker of a distributed rendering: everything is described by the coordinator
+	if (!coordinatorAddress.empty())
+	{
+		size_t separator = coordinatorAddress.rfind(':');
+		if (separator == std::string::npos)
+		{
+			std::cerr << "Expected host:port after --worker" << std::endl;
+			return 1;
+		}
+		bool done = Geometry::RenderWorker::run(coordinatorAddress.substr(0, separator), (unsigned short)atoi(coordinatorAddress.substr(separator + 1).c_str()), initScene);
+		System::Trace::instance().stop();
+		return done ? 0 : 1;
+	}
+
+	// 1 - Initializes a window for rendering
+	//const int width = 1000, height = 1000;
+	const int width = 500, height = 500;
+	//const int width = 300, height = 300;
+	std::unique_ptr<Visualizer::Visualizer> visu;
+	if (!headless)
+	{
+		visu.reset(new Visualizer::Visualizer(width, height));
+	}
+
+	// 2 - Rendering parameters
 	unsigned int passPerPixel = 1000 / 16;	// Number of rays per pixel 
 	unsigned int subPixelSampling = 4;	// Antialiasing
 	unsigned int maxBounce = 20;
 	//unsigned int maxBounce = 2;			// Maximum number of bounces
+	if (passes > 0) { passPerPixel = passes; }
+	if (crop[2] < 0) { crop[2] = width; crop[3] = height; }
+
+	if (localWorkers >= 0)
+	{
+		// 3 - Distributed rendering: the coordinator does not load the scene
+		// The options of the whole image passes are not sent to the workers, a different image must not be produced silently
+		std::vector<std::string> unsupported;
+		if (timeBudget > 0.0) { unsupported.push_back("--time"); }
+		if (noiseTarget > 0.0) { unsupported.push_back("--noise"); }
+		if (!checkpoint.empty()) { unsupported.push_back("--checkpoint"); }
+		if (!animationFile.empty()) { unsupported.push_back("--animation"); }
+		if (preview) { unsupported.push_back("--preview"); }
+		if (denoise) { unsupported.push_back("--denoise"); }
+		if (aovs) { unsupported.push_back("--aov"); }
+		if (heatmap.metric != Geometry::Heatmap::None) { unsupported.push_back("--heatmap"); }
+		if (irradianceAccuracy > 0.0) { unsupported.push_back("--irradiance-cache"); }
+		if (!bakeFile.empty()) { unsupported.push_back("--bake"); }
+		if (!lightmapFile.empty()) { unsupported.push_back("--lightmap"); }
+		if (photons > 0) { unsupported.push_back("--photons"); }
+		if (radiosity > 0.0) { unsupported.push_back("--radiosity"); }
+		if (guiding > 0.0) { unsupported.push_back("--guiding"); }
+		if (!unsupported.empty())
+		{
+			for (const std::string & option : unsupported) { std::cerr << option << " is not supported by the distributed rendering (--workers)" << std::endl; }
+			return 1;
+		}
+		Geometry::RenderJob job(sceneName, width, height, maxBounce, subPixelSampling, passPerPixel);
+		job.setCropWindow(crop[0], crop[1], crop[2], crop[3]);
+		job.setPathTracing(iterative, rouletteDepth, mis);
+		Geometry::RenderCoordinator coordinator(job, visu.get());
+		unsigned short listeningPort = coordinator.listen((unsigned short)port, remoteWorkers);
+		if (listeningPort == 0)
+		{
+			std::cerr << "Unable to listen on port " << port << std::endl;
+			return 1;
+		}
+		std::cout << "Coordinator listening on port " << listeningPort << std::endl;
+		std::vector<std::string> commands;
+		for (int i = 0; i < localWorkers; ++i)
+		{
+			commands.push_back(workerCommand(argv[0], listeningPort));
+		}
+		if (!coordinator.run(commands, workerTimeout)) { return 1; }
+		if (!output.empty()) { coordinator.getAccumulationBuffer().savePFM(output); }
+	}
+	else
+	{
+		// 3 - Initializes the scene
+		// The scene is built in place (it owns a mutex and atomics, so it cannot be moved)
+		std::unique_ptr<Geometry::Scene> scenePointer(visu ? new Geometry::Scene(visu.get()) : new Geometry::Scene(width, height));
+		Geometry::Scene & scene = *scenePointer;
+		initScene(sceneName, scene);
+		if (!checkpoint.empty())
+		{
+			scene.setCheckpoint(checkpoint, checkpointInterval, resume);
+		}
+		scene.setStoppingCriteria(timeBudget, noiseTarget);
+		scene.setCropWindow(crop[0], crop[1], crop[2], crop[3]);
+		scene.setPreview(preview);
+		scene.setDenoiser(denoise);
+		scene.setAuxiliaryBuffers(aovs);
+		scene.setHeatmap(heatmap);
+		scene.setIterativePathTracing(iterative, rouletteDepth);
+		scene.setMultipleImportanceSampling(mis);
+		scene.setIrradianceCache(irradianceAccuracy > 0.0, irradianceAccuracy, irradianceRays);
+		scene.setPhotonMapping(photons > 0, photons, causticPhotons, photonGather);
+		scene.setPathGuiding(guiding > 0.0, guiding);
+		scene.setRadiosity(radiosity > 0.0, (radiosity > 0.0) ? radiosity : 1e-4);
+		if (!bakeFile.empty())
+		{
+			scene.bakeLightmap(maxBounce, bakeSamples, bakeTexel);
+			if (!scene.saveLightmap(bakeFile)) { return 1; }
+		}
+		else if (!lightmapFile.empty() && !scene.loadLightmap(lightmapFile)) { return 1; }
+		// Shows stats
+		scene.printStats();
 
-	//scene.setDiffuseSamples(16);
-	//scene.setSpecularSamples(16);
-	scene.setDiffuseSamples(1);
-	scene.setSpecularSamples(1);
-	//scene.setDiffuseSamples(32);
-	//scene.setSpecularSamples(32);
-	//scene.setDiffuseSamples(16);
-	//scene.setSpecularSamples(16);
-	//scene.setDiffuseSamples(4);
-	//scene.setSpecularSamples(4);
+		// 4 - Computes the scene
+		if (!animationFile.empty())
+		{
+			// The scene is loaded once for all the frames
+			Geometry::Animation animation;
+			if (!animation.load(animationFile)) { return 1; }
+			animation.render(scene, frames, maxBounce, subPixelSampling, passPerPixel, output);
+		}
+		else
+		{
+			scene.compute(maxBounce, subPixelSampling, passPerPixel);
+			scene.printStats();
+			if (!output.empty())
+			{
+				scene.getImage().savePFM(output);
+				if (aovs) { scene.saveAuxiliaryBuffers(output); }
+			}
+		}
+	}
 
-	
-	scene.compute(maxBounce, subPixelSampling, passPerPixel) ;
+	System::Trace::instance().stop();
 
-	// 4 - waits until a key is pressed
-	waitKeyPressed() ;
+	// 5 - waits until a key is pressed
+	if (visu) { waitKeyPressed(); }
 
 	return 0 ;
-}
\ No newline at end of file
+}
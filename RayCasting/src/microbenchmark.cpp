@@ -0,0 +1,376 @@
+#include <Scenes.h>
+#include <Geometry/Scene.h>
+#include <Geometry/BVH.h>
+#include <Geometry/CastedRay.h>
+#include <Geometry/RayTriangleIntersection.h>
+#include <Geometry/Texture.h>
+#include <Math/SobolSampler.h>
+#include <Math/RandomDirection.h>
+#include <Math/sobol.h>
+#include <System/Clock.h>
+#include <omp.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+// Micro-benchmarks of the hot functions of the renderer: Triangle::intersection, BoundingBox::intersect,
+// the RayTriangleIntersection constructor, the Sobol samplers, RandomDirection::generate, Texture::pixel
+// and Vector3f arithmetic. Their inputs are captured from a render of a scene (the rays of the primary
+// and first diffuse bounce, the boxes and triangles tested by their BVH traversals, the sampler
+// dimensions, the normals and texture coordinates of the hits), so branches and caches behave as in
+// the renderer. Each function is timed on one thread (ns/op) and on all threads (throughput per core).
+// Usage: MicroBenchmark [options]
+//   --scene name    the scene the inputs are captured from (diffuse by default, see Scenes.h)
+//   --output file   the JSON report (microbenchmark.json by default)
+//   --width w       the width of the primary ray grid (64 by default)
+//   --height h      the height of the primary ray grid (64 by default)
+//   --samples n     the number of primary rays per pixel (2 by default)
+//   --seed s        the seed of the ray samplers (0 by default)
+//   --time s        the minimum duration of each single thread measure (0.25 by default)
+
+/// <summary>
+/// The inputs captured from a render.
+/// </summary>
+struct CapturedInputs
+{
+	/// <summary> A ray / triangle test of a traversal. </summary>
+	struct TriangleTest
+	{
+		unsigned int ray;
+		const Geometry::Triangle * triangle;
+	};
+
+	/// <summary> A ray / box test of a traversal. </summary>
+	struct BoxTest
+	{
+		unsigned int ray;
+		const Geometry::BoundingBox * box;
+		double t0, t1;
+	};
+
+	/// <summary> A dimension of a sample used by a path. </summary>
+	struct SamplerInput
+	{
+		unsigned int seed;
+		unsigned long long sample;
+		unsigned int dimension;
+	};
+
+	/// <summary> A cosine distributed direction drawn around the normal of a hit. </summary>
+	struct DirectionInput
+	{
+		Math::RandomDirection direction;
+		double xi1, xi2;
+	};
+
+	/// <summary> A texture fetch at a hit. </summary>
+	struct TextureInput
+	{
+		const Geometry::Texture * texture;
+		Math::Vector2f uv;
+	};
+
+	/// <summary> The geometry of a hit: incoming direction, shading normal and position. </summary>
+	struct VectorInput
+	{
+		Math::Vector3f direction, normal, position;
+	};
+
+	::std::vector<Geometry::Ray> rays;
+	::std::vector<TriangleTest> triangles;
+	::std::vector<BoxTest> boxes;
+	::std::vector<SamplerInput> samples;
+	::std::vector<DirectionInput> directions;
+	::std::vector<TextureInput> textures;
+	::std::vector<VectorInput> vectors;
+
+	void append(const CapturedInputs & other)
+	{
+		const unsigned int offset = (unsigned int)rays.size();
+		rays.insert(rays.end(), other.rays.begin(), other.rays.end());
+		for (TriangleTest test : other.triangles) { test.ray += offset; triangles.push_back(test); }
+		for (BoxTest test : other.boxes) { test.ray += offset; boxes.push_back(test); }
+		samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+		directions.insert(directions.end(), other.directions.begin(), other.directions.end());
+		textures.insert(textures.end(), other.textures.begin(), other.textures.end());
+		vectors.insert(vectors.end(), other.vectors.begin(), other.vectors.end());
+	}
+};
+
+#ifndef Use_TraversalLog
+#error The MicroBenchmark target needs the macro Use_TraversalLog (capture of the BVH traversals)
+#endif
+
+/// <summary>
+/// Traces a ray in the BVH of the scene and records its box and triangle tests.
+/// </summary>
+void traceAndRecord(Geometry::Scene & scene, Geometry::CastedRay & cray, CapturedInputs & inputs)
+{
+	Geometry::BVH::TraversalLog log;
+	Geometry::BVH::threadLog() = &log;
+	scene.optim(cray, "BVH");
+	Geometry::BVH::threadLog() = nullptr;
+	const unsigned int ray = (unsigned int)inputs.rays.size();
+	inputs.rays.push_back(Geometry::Ray(cray.source(), cray.direction()));
+	for (const Geometry::BVH::TraversalLog::BoxTest & test : log.boxes) { inputs.boxes.push_back({ ray, test.box, test.t0, test.t1 }); }
+	for (const Geometry::Triangle * triangle : log.triangles) { inputs.triangles.push_back({ ray, triangle }); }
+}
+
+/// <summary>
+/// Records the hit of a ray (sampler dimensions of the bounce, texture fetch, vectors) and returns true if the ray hits.
+/// </summary>
+bool recordHit(const Geometry::CastedRay & cray, const Math::SobolSampler & sampler, unsigned int seed, unsigned long long sample, unsigned int bounce, CapturedInputs & inputs)
+{
+	// The dimensions a path consumes at each bounce (light choice and position, BSDF direction, roulette)
+	const unsigned int first = Math::PixelSampler::CameraDimensions + bounce*Math::PixelSampler::DimensionsPerBounce;
+	for (unsigned int dimension = first; dimension < first + Math::PixelSampler::DimensionsPerBounce; ++dimension)
+	{
+		inputs.samples.push_back({ seed, sample, dimension });
+	}
+	if (!cray.validIntersectionFound()) { return false; }
+	const Geometry::RayTriangleIntersection & hit = cray.intersectionFound();
+	const Geometry::Triangle * triangle = hit.triangle();
+	Math::Vector3f normal = triangle->sampleNormal(hit.uTriangleValue(), hit.vTriangleValue(), cray.source());
+	inputs.vectors.push_back({ cray.direction(), normal, hit.intersection() });
+	::std::pair<double, double> xi = sampler.get2D(bounce, Math::PixelSampler::BsdfDirection);
+	inputs.directions.push_back({ Math::RandomDirection(normal), xi.first, xi.second });
+	if (triangle->material()->hasTexture() && triangle->hasTextureCoordinates())
+	{
+		inputs.textures.push_back({ &triangle->material()->getTexture(), triangle->interpolateTextureCoordinate(hit.uTriangleValue(), hit.vTriangleValue()) });
+	}
+	return true;
+}
+
+/// <summary>
+/// Renders the primary rays and the first diffuse bounce of a scene (its BVH must be built) and captures the inputs.
+/// </summary>
+void capture(Geometry::Scene & scene, int width, int height, int samples, unsigned int seed, CapturedInputs & inputs)
+{
+	std::vector<CapturedInputs> lines(height);
+#pragma omp parallel for schedule(dynamic)
+	for (int y = 0; y < height; ++y)
+	{
+		CapturedInputs & line = lines[y];
+		for (int x = 0; x < width; ++x)
+		{
+			const unsigned int pixelSeed = Math::SobolSampler::pixelSeed(x, y, seed);
+			for (int sample = 0; sample < samples; ++sample)
+			{
+				Math::SobolSampler sampler(pixelSeed, sample);
+				line.samples.push_back({ pixelSeed, (unsigned long long)sample, 0 });
+				line.samples.push_back({ pixelSeed, (unsigned long long)sample, 1 });
+				std::pair<double, double> lens = sampler.lens();
+				Geometry::CastedRay cray(scene.getCamera().getRay((x + lens.first) / width, (y + lens.second) / height));
+				traceAndRecord(scene, cray, line);
+				if (!recordHit(cray, sampler, pixelSeed, sample, 0, line)) { continue; }
+				const CapturedInputs::DirectionInput & bounce = line.directions.back();
+				Geometry::CastedRay diffuse(cray.intersectionFound().intersection(), bounce.direction.generate(bounce.xi1, bounce.xi2));
+				traceAndRecord(scene, diffuse, line);
+				recordHit(diffuse, sampler, pixelSeed, sample, 1, line);
+			}
+		}
+	}
+	for (const CapturedInputs & line : lines) { inputs.append(line); }
+}
+
+/// <summary>
+/// The measure of a function.
+/// </summary>
+struct Measure
+{
+	std::string name;
+	size_t inputs = 0;
+	/// <summary> The number of passes over the inputs of each measure. </summary>
+	unsigned long long passes = 0;
+	double nanosecondsPerOp = 0.0;
+	double opsPerSecond = 0.0;
+	double opsPerSecondPerCore = 0.0;
+	int threads = 1;
+	double checksum = 0.0;
+};
+
+/// <summary>
+/// Sums the results of the function over the inputs (the sum keeps the compiler from discarding the calls).
+/// </summary>
+template <class Input, class Function>
+double run(const std::vector<Input> & inputs, unsigned long long passes, Function function)
+{
+	double sum = 0.0;
+	for (unsigned long long pass = 0; pass < passes; ++pass)
+	{
+		for (const Input & input : inputs) { sum += function(input); }
+	}
+	return sum;
+}
+
+/// <summary>
+/// Times a function on one thread for at least minSeconds, then the same passes on every thread.
+/// </summary>
+template <class Input, class Function>
+Measure measure(const std::string & name, const std::vector<Input> & inputs, double minSeconds, Function function)
+{
+	Measure result;
+	result.name = name;
+	result.inputs = inputs.size();
+	if (inputs.empty()) { return result; }
+
+	// Single thread: doubles the passes until the measure is long enough (the first pass warms the caches)
+	run(inputs, 1, function);
+	unsigned long long passes = 1;
+	double seconds;
+	for (;;)
+	{
+		System::Clock clock;
+		result.checksum = run(inputs, passes, function);
+		seconds = clock.elapsed();
+		if (seconds >= minSeconds) { break; }
+		passes *= 2;
+	}
+	const double ops = (double)passes * inputs.size();
+	result.passes = passes;
+	result.nanosecondsPerOp = seconds * 1e9 / ops;
+	result.opsPerSecond = ops / seconds;
+
+	// All threads: each thread replays the same passes
+	int threads = 1;
+	double checksum = 0.0;
+	System::Clock clock;
+#pragma omp parallel reduction(+:checksum)
+	{
+#pragma omp single
+		threads = omp_get_num_threads();
+		checksum += run(inputs, passes, function);
+	}
+	seconds = clock.elapsed();
+	result.threads = threads;
+	result.opsPerSecondPerCore = ops / seconds;
+	result.checksum += checksum;
+	return result;
+}
+
+/// <summary>
+/// Measures the functions on the captured inputs.
+/// </summary>
+std::vector<Measure> measureFunctions(const CapturedInputs & inputs, double minSeconds)
+{
+	typedef CapturedInputs Inputs;
+	const std::vector<Geometry::Ray> & rays = inputs.rays;
+	std::vector<Measure> measures;
+	measures.push_back(measure("Triangle::intersection", inputs.triangles, minSeconds, [&rays](const Inputs::TriangleTest & test) {
+		double t, u, v;
+		return test.triangle->intersection(rays[test.ray], t, u, v) ? t : 0.0;
+	}));
+	measures.push_back(measure("BoundingBox::intersect", inputs.boxes, minSeconds, [&rays](const Inputs::BoxTest & test) {
+		double entry, exit;
+		return test.box->intersect(rays[test.ray], test.t0, test.t1, entry, exit) ? entry : 0.0;
+	}));
+	measures.push_back(measure("RayTriangleIntersection::RayTriangleIntersection", inputs.triangles, minSeconds, [&rays](const Inputs::TriangleTest & test) {
+		Geometry::RayTriangleIntersection intersection(test.triangle, rays[test.ray]);
+		return intersection.valid() ? intersection.tRayValue() : 0.0;
+	}));
+	measures.push_back(measure("Sobol::sample", inputs.samples, minSeconds, [](const Inputs::SamplerInput & input) {
+		return Math::Sobol::sample(input.sample, input.dimension % Math::Sobol::Matrices::num_dimensions, input.seed);
+	}));
+	measures.push_back(measure("SobolSampler::get", inputs.samples, minSeconds, [](const Inputs::SamplerInput & input) {
+		return Math::SobolSampler(input.seed, input.sample).get(input.dimension);
+	}));
+	measures.push_back(measure("RandomDirection::generate", inputs.directions, minSeconds, [](const Inputs::DirectionInput & input) {
+		return input.direction.generate(input.xi1, input.xi2)[2];
+	}));
+	measures.push_back(measure("Texture::pixel", inputs.textures, minSeconds, [](const Inputs::TextureInput & input) {
+		return input.texture->pixel(input.uv)[0];
+	}));
+	measures.push_back(measure("Vector3f::operator* (dot)", inputs.vectors, minSeconds, [](const Inputs::VectorInput & input) {
+		return input.direction*input.normal;
+	}));
+	measures.push_back(measure("Vector3f::operator^ (cross)", inputs.vectors, minSeconds, [](const Inputs::VectorInput & input) {
+		return (input.direction^input.normal)[0];
+	}));
+	measures.push_back(measure("Vector3f::normalized", inputs.vectors, minSeconds, [](const Inputs::VectorInput & input) {
+		return (input.position - input.direction).normalized()[0];
+	}));
+	measures.push_back(measure("Vector3f reflection", inputs.vectors, minSeconds, [](const Inputs::VectorInput & input) {
+		return (input.direction - input.normal*(2.0*(input.direction*input.normal)))[1];
+	}));
+	return measures;
+}
+
+void printMeasures(std::ostream & out, const std::vector<Measure> & measures)
+{
+	out << std::left << std::setw(50) << "function" << std::right << std::setw(10) << "inputs" << std::setw(10) << "ns/op"
+		<< std::setw(14) << "Mops/s" << std::setw(16) << "Mops/s/core" << std::endl;
+	for (const Measure & measure : measures)
+	{
+		out << std::left << std::setw(50) << measure.name << std::right << std::setw(10) << measure.inputs;
+		if (measure.inputs == 0) { out << "  (no input captured)" << std::endl; continue; }
+		out << std::fixed << std::setprecision(2) << std::setw(10) << measure.nanosecondsPerOp << std::setw(14) << measure.opsPerSecond*1e-6
+			<< std::setw(16) << measure.opsPerSecondPerCore*1e-6 << std::defaultfloat << std::endl;
+	}
+}
+
+void writeJSON(std::ostream & out, const std::string & scene, const CapturedInputs & inputs, const std::vector<Measure> & measures, int width, int height, int samples, unsigned int seed)
+{
+	out << "{\n  \"scene\": \"" << scene << "\", \"width\": " << width << ", \"height\": " << height << ", \"samples\": " << samples
+		<< ", \"seed\": " << seed << ", \"threads\": " << omp_get_max_threads() << ", \"rays\": " << inputs.rays.size() << ",\n  \"functions\": [";
+	for (size_t i = 0; i < measures.size(); ++i)
+	{
+		const Measure & measure = measures[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << measure.name << "\", \"inputs\": " << measure.inputs << ", \"passes\": " << measure.passes
+			<< ", \"nsPerOp\": " << measure.nanosecondsPerOp << ", \"opsPerSecond\": " << measure.opsPerSecond
+			<< ", \"threads\": " << measure.threads << ", \"opsPerSecondPerCore\": " << measure.opsPerSecondPerCore << ", \"checksum\": " << measure.checksum << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+int main(int argc, char ** argv)
+{
+	std::string name = "diffuse";
+	std::string output = "microbenchmark.json";
+	int width = 64, height = 64, samples = 2;
+	unsigned int seed = 0;
+	double minSeconds = 0.25;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (option == "--scene" && hasValue) { name = argv[++i]; }
+		else if (option == "--output" && hasValue) { output = argv[++i]; }
+		else if (option == "--width" && hasValue) { width = atoi(argv[++i]); }
+		else if (option == "--height" && hasValue) { height = atoi(argv[++i]); }
+		else if (option == "--samples" && hasValue) { samples = atoi(argv[++i]); }
+		else if (option == "--seed" && hasValue) { seed = (unsigned int)atoi(argv[++i]); }
+		else if (option == "--time" && hasValue) { minSeconds = atof(argv[++i]); }
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	Geometry::Scene scene(width, height);
+	if (!initScene(name, scene))
+	{
+		std::cerr << "Unknown scene " << name << std::endl;
+		return 1;
+	}
+	scene.buildBVH();
+	CapturedInputs inputs;
+	capture(scene, width, height, samples, seed, inputs);
+	std::cerr << "MicroBenchmark: " << inputs.rays.size() << " rays, " << inputs.boxes.size() << " box tests, " << inputs.triangles.size()
+		<< " triangle tests captured on " << name << std::endl;
+
+	std::vector<Measure> measures = measureFunctions(inputs, minSeconds);
+	printMeasures(std::cout, measures);
+	std::ofstream out(output.c_str());
+	writeJSON(out, name, inputs, measures, width, height, samples, seed);
+	if (!out)
+	{
+		std::cerr << "Unable to write " << output << std::endl;
+		return 1;
+	}
+	std::cerr << "MicroBenchmark: report written in " << output << std::endl;
+	return 0;
+}